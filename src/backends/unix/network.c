@@ -24,6 +24,10 @@
  * =======================================================================
  */
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE /* recvmmsg() and sendmmsg() */
+#endif
+
 #include "../../common/header/common.h"
 
 #include <unistd.h>
@@ -43,6 +47,10 @@
 #include <errno.h>
 #include <arpa/inet.h>
 #include <net/if.h>
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#endif
 
 netadr_t net_local_adr;
 
@@ -68,6 +76,51 @@ int ip6_sockets[2];
 int ipx_sockets[2];
 char *multicast_interface = NULL;
 
+/*
+ * On Linux packets are received and sent in batches, one
+ * recvmmsg() or sendmmsg() call moves up to NET_BATCH packets.
+ * Received packets are queued per socket and handed out by
+ * NET_GetPacket() one after the other. Packets send between
+ * NET_BeginSendBatch() and NET_EndSendBatch() are queued and
+ * send together. Everywhere else, or if the kernel lacks the
+ * calls, the plain recvfrom() and sendto() path is used.
+ */
+#if defined(__linux__)
+#define NET_HAVE_MMSG
+#endif
+
+#define NET_BATCH 32
+
+#ifdef NET_HAVE_MMSG
+typedef struct
+{
+	int socket;
+	int count, next;
+	struct mmsghdr hdrs[NET_BATCH];
+	struct iovec iovs[NET_BATCH];
+	struct sockaddr_storage from[NET_BATCH];
+	byte data[NET_BATCH][MAX_MSGLEN];
+} recvbatch_t;
+
+typedef struct
+{
+	int count;
+	int sockets[NET_BATCH];
+	netadr_t to[NET_BATCH];
+	struct mmsghdr hdrs[NET_BATCH];
+	struct iovec iovs[NET_BATCH];
+	struct sockaddr_storage addr[NET_BATCH];
+	byte data[NET_BATCH][MAX_MSGLEN];
+} sendbatch_t;
+
+static recvbatch_t *recvbatches[2][3];
+static sendbatch_t *sendbatch;
+static qboolean sendbatch_active;
+static qboolean mmsg_broken;
+#endif
+
+static cvar_t *net_batch;
+
 int NET_Socket(char *net_interface, int port, netsrc_t type, int family);
 char *NET_ErrorString(void);
 
@@ -184,9 +237,204 @@ SockadrToNetadr(struct sockaddr_storage *s, netadr_t *a)
 	}
 }
 
+#ifdef NET_HAVE_MMSG
+static int
+NET_BenchSocket(struct sockaddr_in *addr)
+{
+	socklen_t len;
+	qboolean _true = true;
+	int s, size;
+
+	if ((s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)) == -1)
+	{
+		return -1;
+	}
+
+	memset(addr, 0, sizeof(*addr));
+	addr->sin_family = AF_INET;
+	addr->sin_addr.s_addr = htonl(LOOPBACK);
+	addr->sin_port = 0;
+
+	len = sizeof(*addr);
+	size = 4 * 1024 * 1024;
+	setsockopt(s, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+	if ((ioctl(s, FIONBIO, (char *)&_true) == -1) ||
+		(bind(s, (struct sockaddr *)addr, sizeof(*addr)) == -1) ||
+		(getsockname(s, (struct sockaddr *)addr, &len) == -1))
+	{
+		close(s);
+		return -1;
+	}
+
+	return s;
+}
+
+/*
+ * Sends packets from one loopback UDP socket to another,
+ * NET_BATCH at a time and reads them back. Once with one
+ * syscall per packet and once with one per batch.
+ */
+static void
+NET_UDPBench_f(void)
+{
+	static byte data[NET_BATCH][1024];
+	struct mmsghdr hdrs[NET_BATCH];
+	struct iovec iovs[NET_BATCH];
+	struct sockaddr_in from, to;
+	long long start, time;
+	int packets, pass, sent, received, calls;
+	int src, dst, i, n, ret;
+	socklen_t fromlen;
+
+	packets = 100000;
+
+	if (Cmd_Argc() > 1)
+	{
+		packets = (int)strtol(Cmd_Argv(1), (char **)NULL, 10);
+	}
+
+	if (packets < NET_BATCH)
+	{
+		packets = NET_BATCH;
+	}
+
+	if (((src = NET_BenchSocket(&from)) == -1) ||
+		((dst = NET_BenchSocket(&to)) == -1))
+	{
+		Com_Printf("net_udpbench: couldn't open sockets: %s\n", NET_ErrorString());
+
+		if (src != -1)
+		{
+			close(src);
+		}
+
+		return;
+	}
+
+	for (i = 0; i < NET_BATCH; i++)
+	{
+		memset(data[i], i, sizeof(data[i]));
+	}
+
+	Com_Printf("Sending %i packets of %i bytes over 127.0.0.1:\n",
+			packets, (int)sizeof(data[0]));
+
+	for (pass = 0; pass < 2; pass++)
+	{
+		sent = received = calls = 0;
+		start = Sys_Microseconds();
+
+		while (sent < packets)
+		{
+			n = min(NET_BATCH, packets - sent);
+
+			/* send */
+			if (pass == 0)
+			{
+				for (i = 0; i < n; i++)
+				{
+					sendto(src, data[i], sizeof(data[i]), 0,
+							(struct sockaddr *)&to, sizeof(to));
+					calls++;
+				}
+			}
+			else
+			{
+				for (i = 0; i < n; i++)
+				{
+					iovs[i].iov_base = data[i];
+					iovs[i].iov_len = sizeof(data[i]);
+
+					memset(&hdrs[i], 0, sizeof(hdrs[i]));
+					hdrs[i].msg_hdr.msg_name = &to;
+					hdrs[i].msg_hdr.msg_namelen = sizeof(to);
+					hdrs[i].msg_hdr.msg_iov = &iovs[i];
+					hdrs[i].msg_hdr.msg_iovlen = 1;
+				}
+
+				for (i = 0; i < n; i += ret)
+				{
+					ret = sendmmsg(src, &hdrs[i], n - i, 0);
+					calls++;
+
+					if (ret <= 0)
+					{
+						break;
+					}
+				}
+			}
+
+			sent += n;
+
+			/* receive, until the socket runs dry */
+			while (1)
+			{
+				if (pass == 0)
+				{
+					fromlen = sizeof(from);
+					ret = recvfrom(dst, data[0], sizeof(data[0]), 0,
+							(struct sockaddr *)&from, &fromlen);
+					calls++;
+
+					if (ret == -1)
+					{
+						break;
+					}
+
+					received++;
+				}
+				else
+				{
+					for (i = 0; i < NET_BATCH; i++)
+					{
+						iovs[i].iov_base = data[i];
+						iovs[i].iov_len = sizeof(data[i]);
+
+						memset(&hdrs[i], 0, sizeof(hdrs[i]));
+						hdrs[i].msg_hdr.msg_iov = &iovs[i];
+						hdrs[i].msg_hdr.msg_iovlen = 1;
+					}
+
+					ret = recvmmsg(dst, hdrs, NET_BATCH, MSG_DONTWAIT, NULL);
+					calls++;
+
+					if (ret <= 0)
+					{
+						break;
+					}
+
+					received += ret;
+				}
+			}
+		}
+
+		time = Sys_Microseconds() - start;
+
+		if (time < 1)
+		{
+			time = 1;
+		}
+
+		Com_Printf("  %-19s %7.1f ms, %9.0f packets/s, %i syscalls, %i lost\n",
+				(pass == 0) ? "sendto/recvfrom:" : "sendmmsg/recvmmsg:",
+				time / 1000.0f, (double)received * 1000000.0 / time,
+				calls, packets - received);
+	}
+
+	close(src);
+	close(dst);
+}
+#endif
+
 void
 NET_Init()
 {
+	net_batch = Cvar_Get("net_batch", "1", CVAR_ARCHIVE);
+
+#ifdef NET_HAVE_MMSG
+	Cmd_AddCommand("net_udpbench", NET_UDPBench_f);
+#endif
 }
 
 qboolean
@@ -511,6 +759,309 @@ NET_SendLoopPacket(netsrc_t sock, int length, void *data, netadr_t to)
 	loop->msgs[i].datalen = length;
 }
 
+/* =================================================================== */
+
+/*
+ * Reports a failed send in errno. Would block is
+ * silent and some PPP links don't allow broadcasts.
+ */
+static void
+NET_SendError(netadr_t to)
+{
+	if (errno == EWOULDBLOCK)
+	{
+		return;
+	}
+
+	if ((errno == EADDRNOTAVAIL) &&
+		((to.type == NA_BROADCAST) || (to.type == NA_BROADCAST_IPX)))
+	{
+		return;
+	}
+
+	Com_Printf("NET_SendPacket ERROR: %s to %s\n", NET_ErrorString(),
+			NET_AdrToString(to));
+}
+
+#ifdef NET_HAVE_MMSG
+static qboolean
+NET_UseBatches(void)
+{
+	return !mmsg_broken && net_batch && net_batch->value;
+}
+
+static void
+NET_ClearBatches(void)
+{
+	int i, j;
+
+	for (i = 0; i < 2; i++)
+	{
+		for (j = 0; j < 3; j++)
+		{
+			if (recvbatches[i][j])
+			{
+				recvbatches[i][j]->count = 0;
+				recvbatches[i][j]->next = 0;
+			}
+		}
+	}
+
+	if (sendbatch)
+	{
+		sendbatch->count = 0;
+	}
+}
+
+/*
+ * Returns the next packet already read into the
+ * queue of the given socket. Also used after
+ * net_batch was switched off, so no packets
+ * are lost.
+ */
+static qboolean
+NET_GetQueuedPacket(netsrc_t sock, int protocol, int net_socket,
+		netadr_t *net_from, sizebuf_t *net_message)
+{
+	recvbatch_t *b;
+	int i;
+
+	b = recvbatches[sock][protocol];
+
+	/* the socket was reopened, drop old packets */
+	if (!b || (b->socket != net_socket))
+	{
+		return false;
+	}
+
+	while (b->next < b->count)
+	{
+		i = b->next++;
+
+		SockadrToNetadr(&b->from[i], net_from);
+
+		if ((b->hdrs[i].msg_len >= net_message->maxsize) ||
+			(b->hdrs[i].msg_hdr.msg_flags & MSG_TRUNC))
+		{
+			Com_Printf("Oversize packet from %s\n", NET_AdrToString(*net_from));
+			continue;
+		}
+
+		memcpy(net_message->data, b->data[i], b->hdrs[i].msg_len);
+		net_message->cursize = b->hdrs[i].msg_len;
+		return true;
+	}
+
+	return false;
+}
+
+/*
+ * Returns the next queued packet of the given
+ * socket, reading a new batch if the queue is
+ * empty. -1 means nothing there, -2 that the
+ * batched path failed and recvfrom() is used.
+ */
+static int
+NET_GetBatchedPacket(netsrc_t sock, int protocol, int net_socket,
+		netadr_t *net_from, sizebuf_t *net_message)
+{
+	recvbatch_t *b;
+	int i, ret;
+
+	if (!recvbatches[sock][protocol])
+	{
+		recvbatches[sock][protocol] = Z_Malloc(sizeof(recvbatch_t));
+	}
+
+	b = recvbatches[sock][protocol];
+
+	/* the socket was reopened, drop old packets */
+	if (b->socket != net_socket)
+	{
+		b->socket = net_socket;
+		b->count = 0;
+		b->next = 0;
+	}
+
+	while (1)
+	{
+		if (NET_GetQueuedPacket(sock, protocol, net_socket,
+					net_from, net_message))
+		{
+			return 0;
+		}
+
+		for (i = 0; i < NET_BATCH; i++)
+		{
+			b->iovs[i].iov_base = b->data[i];
+			b->iovs[i].iov_len = MAX_MSGLEN;
+
+			memset(&b->hdrs[i], 0, sizeof(b->hdrs[i]));
+			b->hdrs[i].msg_hdr.msg_name = &b->from[i];
+			b->hdrs[i].msg_hdr.msg_namelen = sizeof(b->from[i]);
+			b->hdrs[i].msg_hdr.msg_iov = &b->iovs[i];
+			b->hdrs[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		b->count = 0;
+		b->next = 0;
+
+		ret = recvmmsg(net_socket, b->hdrs, NET_BATCH, MSG_DONTWAIT, NULL);
+
+		if (ret == -1)
+		{
+			if ((errno == EWOULDBLOCK) || (errno == ECONNREFUSED))
+			{
+				return -1;
+			}
+
+			if (errno == ENOSYS)
+			{
+				Com_Printf("NET_GetPacket: recvmmsg not supported, using recvfrom\n");
+				mmsg_broken = true;
+				return -2;
+			}
+
+			Com_Printf("NET_GetPacket: %s\n", NET_ErrorString());
+			return -1;
+		}
+
+		if (ret == 0)
+		{
+			return -1;
+		}
+
+		b->count = ret;
+	}
+}
+
+static void
+NET_FlushSendBatch(void)
+{
+	sendbatch_t *b;
+	int i, first, last, ret;
+
+	b = sendbatch;
+
+	if (!b || !b->count)
+	{
+		return;
+	}
+
+	/* one sendmmsg() for each run of packets to the same socket */
+	for (first = 0; first < b->count; first = last)
+	{
+		for (last = first + 1; last < b->count; last++)
+		{
+			if (b->sockets[last] != b->sockets[first])
+			{
+				break;
+			}
+		}
+
+		while (first < last)
+		{
+			ret = sendmmsg(b->sockets[first], &b->hdrs[first], last - first, 0);
+
+			if (ret > 0)
+			{
+				first += ret;
+				continue;
+			}
+
+			if ((ret == -1) && (errno == ENOSYS))
+			{
+				Com_Printf("NET_SendPacket: sendmmsg not supported, using sendto\n");
+				mmsg_broken = true;
+
+				for (i = first; i < last; i++)
+				{
+					if (sendto(b->sockets[i], b->data[i], b->iovs[i].iov_len, 0,
+							(struct sockaddr *)&b->addr[i], b->hdrs[i].msg_hdr.msg_namelen) == -1)
+					{
+						NET_SendError(b->to[i]);
+					}
+				}
+
+				break;
+			}
+
+			/* the first packet failed, skip it */
+			NET_SendError(b->to[first]);
+			first++;
+		}
+	}
+
+	b->count = 0;
+}
+
+static void
+NET_QueuePacket(int net_socket, int length, void *data,
+		struct sockaddr_storage *addr, int addr_size, netadr_t to)
+{
+	sendbatch_t *b;
+	int i;
+
+	if (sendbatch->count == NET_BATCH)
+	{
+		NET_FlushSendBatch();
+	}
+
+	b = sendbatch;
+	i = b->count++;
+
+	memcpy(b->data[i], data, length);
+	memcpy(&b->addr[i], addr, addr_size);
+	b->sockets[i] = net_socket;
+	b->to[i] = to;
+
+	b->iovs[i].iov_base = b->data[i];
+	b->iovs[i].iov_len = length;
+
+	memset(&b->hdrs[i], 0, sizeof(b->hdrs[i]));
+	b->hdrs[i].msg_hdr.msg_name = &b->addr[i];
+	b->hdrs[i].msg_hdr.msg_namelen = addr_size;
+	b->hdrs[i].msg_hdr.msg_iov = &b->iovs[i];
+	b->hdrs[i].msg_hdr.msg_iovlen = 1;
+}
+#endif
+
+/*
+ * Packets send between NET_BeginSendBatch() and
+ * NET_EndSendBatch() are queued and send together
+ * at the end. Loopback packets are delivered at
+ * once.
+ */
+void
+NET_BeginSendBatch(void)
+{
+#ifdef NET_HAVE_MMSG
+	/* a previous batch may have been interrupted by an error */
+	NET_FlushSendBatch();
+
+	if (!NET_UseBatches())
+	{
+		return;
+	}
+
+	if (!sendbatch)
+	{
+		sendbatch = Z_Malloc(sizeof(sendbatch_t));
+	}
+
+	sendbatch_active = true;
+#endif
+}
+
+void
+NET_EndSendBatch(void)
+{
+#ifdef NET_HAVE_MMSG
+	sendbatch_active = false;
+	NET_FlushSendBatch();
+#endif
+}
+
 qboolean
 NET_GetPacket(netsrc_t sock, netadr_t *net_from, sizebuf_t *net_message)
 {
@@ -546,6 +1097,28 @@ NET_GetPacket(netsrc_t sock, netadr_t *net_from, sizebuf_t *net_message)
 			continue;
 		}
 
+#ifdef NET_HAVE_MMSG
+		if (NET_UseBatches())
+		{
+			ret = NET_GetBatchedPacket(sock, protocol, net_socket,
+					net_from, net_message);
+
+			if (ret == 0)
+			{
+				return true;
+			}
+			else if (ret == -1)
+			{
+				continue;
+			}
+		}
+		else if (NET_GetQueuedPacket(sock, protocol, net_socket,
+					net_from, net_message))
+		{
+			return true;
+		}
+#endif
+
 		fromlen = sizeof(from);
 		ret = recvfrom(net_socket, net_message->data, net_message->maxsize,
 				0, (struct sockaddr *)&from, &fromlen);
@@ -720,6 +1293,14 @@ NET_SendPacket(netsrc_t sock, int length, void *data, netadr_t to)
 		}
 	}
 
+#ifdef NET_HAVE_MMSG
+	if (sendbatch_active && NET_UseBatches() && (length <= MAX_MSGLEN))
+	{
+		NET_QueuePacket(net_socket, length, data, &addr, addr_size, to);
+		return;
+	}
+#endif
+
 	ret = sendto(net_socket,
 			data,
 			length,
@@ -729,8 +1310,7 @@ NET_SendPacket(netsrc_t sock, int length, void *data, netadr_t to)
 
 	if (ret == -1)
 	{
-		Com_Printf("NET_SendPacket ERROR: %s to %s\n", NET_ErrorString(),
-				NET_AdrToString(to));
+		NET_SendError(to);
 	}
 }
 
@@ -773,10 +1353,18 @@ NET_OpenIP(void)
 void
 NET_Config(qboolean multiplayer)
 {
+	/* Com_Error() may have left a send batch open */
+	NET_EndSendBatch();
+
 	if (!multiplayer)
 	{
 		int i;
 
+#ifdef NET_HAVE_MMSG
+		/* queued packets belong to the old sockets */
+		NET_ClearBatches();
+#endif
+
 		/* shut down any existing sockets */
 		for (i = 0; i < 2; i++)
 		{
@@ -1015,3 +1603,181 @@ NET_Sleep(int msec)
 					ip6_sockets[NS_SERVER]) + 1, &fdset, NULL, NULL, &timeout);
 }
 
+
+/* =================================================================== */
+
+#if defined(__linux__)
+/*
+ * The dedicated servers event loop. One epoll set watches
+ * stdin, the server sockets and a timerfd armed to the
+ * deadline, so we wake up at the microsecond and not after
+ * select()s rounded milliseconds.
+ */
+static int epoll_fd = -1;
+static int timer_fd = -1;
+static int epoll_watched[3]; /* stdin, IPv4 and IPv6 socket */
+static qboolean epoll_broken;
+
+static void
+NET_WatchFd(int fd)
+{
+	struct epoll_event ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = fd;
+
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1)
+	{
+		Com_Printf("NET_SleepUntil: epoll_ctl: %s\n", NET_ErrorString());
+	}
+}
+
+static qboolean
+NET_SetupEventLoop(void)
+{
+	extern qboolean stdin_active;
+	int watched[3];
+
+	if (epoll_broken)
+	{
+		return false;
+	}
+
+	watched[0] = stdin_active ? 1 : 0;
+	watched[1] = ip_sockets[NS_SERVER];
+	watched[2] = ip6_sockets[NS_SERVER];
+
+	if ((epoll_fd != -1) && !memcmp(watched, epoll_watched, sizeof(watched)))
+	{
+		return true;
+	}
+
+	/* sockets were reopened or stdin closed, start over */
+	if (epoll_fd != -1)
+	{
+		close(epoll_fd);
+	}
+
+	if (timer_fd == -1)
+	{
+		timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	}
+
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+
+	if ((epoll_fd == -1) || (timer_fd == -1))
+	{
+		Com_Printf("NET_SleepUntil: no epoll or timerfd (%s), using select\n",
+				NET_ErrorString());
+		epoll_broken = true;
+		return false;
+	}
+
+	NET_WatchFd(timer_fd);
+
+	if (watched[0])
+	{
+		NET_WatchFd(0);
+	}
+
+	if (watched[1])
+	{
+		NET_WatchFd(watched[1]);
+	}
+
+	if (watched[2])
+	{
+		NET_WatchFd(watched[2]);
+	}
+
+	memcpy(epoll_watched, watched, sizeof(watched));
+
+	return true;
+}
+#endif
+
+/*
+ * Sleeps until Sys_Microseconds() reaches deadline, a packet
+ * arrives at the server sockets or there's console input.
+ * Only dedicated servers sleep, unlike NET_Sleep() also
+ * without open sockets.
+ */
+void
+NET_SleepUntil(long long deadline)
+{
+	struct timeval timeout;
+	fd_set fdset;
+	long long usec;
+	int maxfd;
+	extern cvar_t *dedicated;
+	extern qboolean stdin_active;
+
+	if (!dedicated || !dedicated->value)
+	{
+		return; /* we're not a server, just run full speed */
+	}
+
+	usec = deadline - Sys_Microseconds();
+
+	if (usec <= 0)
+	{
+		return;
+	}
+
+#if defined(__linux__)
+	if (NET_SetupEventLoop())
+	{
+		struct epoll_event events[4];
+		struct itimerspec its;
+		uint64_t expirations;
+
+		memset(&its, 0, sizeof(its));
+		its.it_value.tv_sec = usec / 1000000;
+		its.it_value.tv_nsec = (usec % 1000000) * 1000;
+
+		/* drop an old expiration, the timer may have
+		   fired while we were woken by a packet */
+		while (read(timer_fd, &expirations, sizeof(expirations)) > 0)
+		{
+		}
+
+		if (timerfd_settime(timer_fd, 0, &its, NULL) == 0)
+		{
+			while (epoll_wait(epoll_fd, events, 4, -1) == -1)
+			{
+				if (errno != EINTR)
+				{
+					break;
+				}
+			}
+
+			return;
+		}
+	}
+#endif
+
+	FD_ZERO(&fdset);
+	maxfd = 0;
+
+	if (stdin_active)
+	{
+		FD_SET(0, &fdset); /* stdin is processed too */
+	}
+
+	if (ip_sockets[NS_SERVER])
+	{
+		FD_SET(ip_sockets[NS_SERVER], &fdset); /* IPv4 network socket */
+		maxfd = MAX(maxfd, ip_sockets[NS_SERVER]);
+	}
+
+	if (ip6_sockets[NS_SERVER])
+	{
+		FD_SET(ip6_sockets[NS_SERVER], &fdset); /* IPv6 network socket */
+		maxfd = MAX(maxfd, ip6_sockets[NS_SERVER]);
+	}
+
+	timeout.tv_sec = usec / 1000000;
+	timeout.tv_usec = usec % 1000000;
+	select(maxfd + 1, &fdset, NULL, NULL, &timeout);
+}
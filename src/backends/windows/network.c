@@ -1260,6 +1260,74 @@ NET_Sleep(int msec)
 	select(i + 1, &fdset, NULL, NULL, &timeout);
 }
 
+/*
+ * Sleeps until Sys_Microseconds() reaches deadline or
+ * a packet arrives at the server sockets.
+ */
+void
+NET_SleepUntil(long long deadline)
+{
+	struct timeval timeout;
+	fd_set fdset;
+	long long usec;
+	extern cvar_t *dedicated;
+
+	if (!dedicated || !dedicated->value)
+	{
+		return; /* we're not a server, just run full speed */
+	}
+
+	usec = deadline - Sys_Microseconds();
+
+	if (usec <= 0)
+	{
+		return;
+	}
+
+	/* select() fails without sockets */
+	if (!ip_sockets[NS_SERVER] && !ip6_sockets[NS_SERVER] &&
+		!ipx_sockets[NS_SERVER])
+	{
+		Sleep((DWORD)(usec / 1000));
+		return;
+	}
+
+	FD_ZERO(&fdset);
+
+	if (ip6_sockets[NS_SERVER])
+	{
+		FD_SET(ip6_sockets[NS_SERVER], &fdset); /* network socket */
+	}
+
+	if (ip_sockets[NS_SERVER])
+	{
+		FD_SET(ip_sockets[NS_SERVER], &fdset); /* network socket */
+	}
+
+	if (ipx_sockets[NS_SERVER])
+	{
+		FD_SET(ipx_sockets[NS_SERVER], &fdset); /* network socket */
+	}
+
+	/* the first argument is ignored by winsock */
+	timeout.tv_sec = (long)(usec / 1000000);
+	timeout.tv_usec = (long)(usec % 1000000);
+	select(0, &fdset, NULL, NULL, &timeout);
+}
+
+/*
+ * Packets are always send one by one on Windows.
+ */
+void
+NET_BeginSendBatch(void)
+{
+}
+
+void
+NET_EndSendBatch(void)
+{
+}
+
 /* =================================================================== */
 
 void
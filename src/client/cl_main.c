@@ -585,6 +585,8 @@ CL_InitLocal(void)
 
 	Cmd_AddCommand("currentmap", CL_CurrentMap_f);
 
+	Cmd_AddCommand("cl_particlebench", CL_ParticleBench_f);
+
 	/* forward to server commands
 	 * the only thing this does is allow command completion
 	 * to work -- all unknown commands are automatically
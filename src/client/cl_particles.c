@@ -26,24 +26,77 @@
 
 #include "header/client.h"
 
-cparticle_t *active_particles, *free_particles;
-cparticle_t particles[MAX_PARTICLES];
-int cl_numparticles = MAX_PARTICLES;
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 1))
+#define CL_PARTICLES_SSE
+#include <xmmintrin.h>
+#endif
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#define CL_PARTICLES_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(CL_PARTICLES_SSE)
+#define CL_PARTICLES_SIMD "SSE"
+#elif defined(CL_PARTICLES_NEON)
+#define CL_PARTICLES_SIMD "NEON"
+#else
+#define CL_PARTICLES_SIMD "C"
+#endif
+
+/* The live particles as structure of arrays, so CL_AddParticles()
+   can move four of them at once. Faded out particles are replaced
+   by the last one, the particles don't keep their order. */
+typedef struct
+{
+	int num;
+
+	float time[MAX_PARTICLES];
+	float org[3][MAX_PARTICLES];
+	float vel[3][MAX_PARTICLES];
+	float accel[3][MAX_PARTICLES];
+	float alpha[MAX_PARTICLES];
+	float alphavel[MAX_PARTICLES];
+	int color[MAX_PARTICLES];
+} clparticles_t;
+
+/* the positions and alphas of the live particles at the current time */
+typedef struct
+{
+	float org[3][MAX_PARTICLES];
+	float alpha[MAX_PARTICLES];
+} clparticlepos_t;
+
+static clparticles_t particles;
+static clparticlepos_t particlepos;
+
+/* particles spawned since the last CL_AddParticles(), filled in by the
+   effects. They're moved into the pool or handed to the renderer there. */
+static cparticle_t newparticles[MAX_PARTICLES];
+static int numnewparticles;
 
 void
 CL_ClearParticles(void)
 {
-	int i;
+	particles.num = 0;
+	numnewparticles = 0;
 
-	free_particles = &particles[0];
-	active_particles = NULL;
+	V_ClearKeptParticles();
+}
 
-	for (i = 0; i < cl_numparticles; i++)
+/*
+ * Returns a new particle for the effect to fill
+ * in or NULL if there are too many particles.
+ */
+cparticle_t *
+CL_AllocParticle(void)
+{
+	if (particles.num + numnewparticles >= MAX_PARTICLES)
 	{
-		particles[i].next = &particles[i + 1];
+		return NULL;
 	}
 
-	particles[cl_numparticles - 1].next = NULL;
+	return &newparticles[numnewparticles++];
 }
 
 void
@@ -55,16 +108,13 @@ CL_ParticleEffect(vec3_t org, vec3_t dir, int color, int count)
 
 	for (i = 0; i < count; i++)
 	{
-		if (!free_particles)
+		p = CL_AllocParticle();
+
+		if (!p)
 		{
 			return;
 		}
 
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
-
 		p->time = cl.time;
 		p->color = color + (randk() & 7);
 		d = randk() & 31;
@@ -95,16 +145,13 @@ CL_ParticleEffect2(vec3_t org, vec3_t dir, int color, int count)
 
 	for (i = 0; i < count; i++)
 	{
-		if (!free_particles)
+		p = CL_AllocParticle();
+
+		if (!p)
 		{
 			return;
 		}
 
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
-
 		p->time = time;
 		p->color = color + (randk() & 7);
 
@@ -136,16 +183,13 @@ CL_ParticleEffect3(vec3_t org, vec3_t dir, int color, int count)
 
 	for (i = 0; i < count; i++)
 	{
-		if (!free_particles)
+		p = CL_AllocParticle();
+
+		if (!p)
 		{
 			return;
 		}
 
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
-
 		p->time = time;
 		p->color = color;
 
@@ -165,77 +209,258 @@ CL_ParticleEffect3(vec3_t org, vec3_t dir, int color, int count)
 	}
 }
 
-void
-CL_AddParticles(void)
+static void
+CL_MovePositionsC(int start, int end, float time)
 {
-	cparticle_t *p, *next;
-	float alpha;
-	float time, time2;
-	vec3_t org;
-	int color;
-	cparticle_t *active, *tail;
+	int i, j;
+	float t;
 
-	active = NULL;
-	tail = NULL;
+	for (i = start; i < end; i++)
+	{
+		t = (time - particles.time[i]) * 0.001f;
 
-	for (p = active_particles; p; p = next)
+		for (j = 0; j < 3; j++)
+		{
+			particlepos.org[j][i] = particles.org[j][i] +
+				particles.vel[j][i] * t + particles.accel[j][i] * t * t;
+		}
+
+		particlepos.alpha[i] = particles.alpha[i] + particles.alphavel[i] * t;
+	}
+}
+
+#if defined(CL_PARTICLES_SSE)
+static void
+CL_MovePositionsSIMD(int num, float time)
+{
+	__m128 now, msec, t, t2, o;
+	int i, j;
+
+	now = _mm_set1_ps(time);
+	msec = _mm_set1_ps(0.001f);
+
+	for (i = 0; i + 4 <= num; i += 4)
 	{
-		next = p->next;
+		t = _mm_mul_ps(_mm_sub_ps(now, _mm_loadu_ps(&particles.time[i])), msec);
+		t2 = _mm_mul_ps(t, t);
 
-		if (p->alphavel != INSTANT_PARTICLE)
+		for (j = 0; j < 3; j++)
 		{
-			time = (cl.time - p->time) * 0.001;
-			alpha = p->alpha + time * p->alphavel;
-
-			if (alpha <= 0)
-			{
-				/* faded out */
-				p->next = free_particles;
-				free_particles = p;
-				continue;
-			}
+			o = _mm_add_ps(_mm_loadu_ps(&particles.org[j][i]),
+					_mm_mul_ps(_mm_loadu_ps(&particles.vel[j][i]), t));
+			o = _mm_add_ps(o, _mm_mul_ps(_mm_loadu_ps(&particles.accel[j][i]), t2));
+			_mm_storeu_ps(&particlepos.org[j][i], o);
 		}
-		else
+
+		_mm_storeu_ps(&particlepos.alpha[i], _mm_add_ps(_mm_loadu_ps(&particles.alpha[i]),
+					_mm_mul_ps(_mm_loadu_ps(&particles.alphavel[i]), t)));
+	}
+
+	CL_MovePositionsC(i, num, time);
+}
+#elif defined(CL_PARTICLES_NEON)
+static void
+CL_MovePositionsSIMD(int num, float time)
+{
+	float32x4_t now, t, t2, o;
+	int i, j;
+
+	now = vdupq_n_f32(time);
+
+	for (i = 0; i + 4 <= num; i += 4)
+	{
+		t = vmulq_n_f32(vsubq_f32(now, vld1q_f32(&particles.time[i])), 0.001f);
+		t2 = vmulq_f32(t, t);
+
+		for (j = 0; j < 3; j++)
 		{
-			time = 0.0f;
-			alpha = p->alpha;
+			o = vmlaq_f32(vld1q_f32(&particles.org[j][i]), vld1q_f32(&particles.vel[j][i]), t);
+			o = vmlaq_f32(o, vld1q_f32(&particles.accel[j][i]), t2);
+			vst1q_f32(&particlepos.org[j][i], o);
 		}
 
-		p->next = NULL;
+		vst1q_f32(&particlepos.alpha[i],
+				vmlaq_f32(vld1q_f32(&particles.alpha[i]), vld1q_f32(&particles.alphavel[i]), t));
+	}
+
+	CL_MovePositionsC(i, num, time);
+}
+#else
+static void
+CL_MovePositionsSIMD(int num, float time)
+{
+	CL_MovePositionsC(0, num, time);
+}
+#endif
+
+/*
+ * Moves the particles spawned since the last frame into the pool.
+ * Instant particles are only shown this frame and never stored.
+ */
+static void
+CL_StoreNewParticles(void)
+{
+	cparticle_t *p;
+	int i, j, n;
 
-		if (!tail)
+	for (i = 0, p = newparticles; i < numnewparticles; i++, p++)
+	{
+		if (p->alphavel == INSTANT_PARTICLE)
 		{
-			active = tail = p;
+			V_AddParticle(p->org, (int)p->color, p->alpha > 1.0f ? 1.0f : p->alpha);
+			continue;
 		}
 
-		else
+		n = particles.num++;
+
+		particles.time[n] = p->time;
+
+		for (j = 0; j < 3; j++)
+		{
+			particles.org[j][n] = p->org[j];
+			particles.vel[j][n] = p->vel[j];
+			particles.accel[j][n] = p->accel[j];
+		}
+
+		particles.alpha[n] = p->alpha;
+		particles.alphavel[n] = p->alphavel;
+		particles.color[n] = (int)p->color;
+	}
+
+	numnewparticles = 0;
+}
+
+/*
+ * Replaces particle i with the last one
+ */
+static void
+CL_RemoveParticle(int i)
+{
+	int j, last;
+
+	last = --particles.num;
+
+	particles.time[i] = particles.time[last];
+
+	for (j = 0; j < 3; j++)
+	{
+		particles.org[j][i] = particles.org[j][last];
+		particles.vel[j][i] = particles.vel[j][last];
+		particles.accel[j][i] = particles.accel[j][last];
+		particlepos.org[j][i] = particlepos.org[j][last];
+	}
+
+	particles.alpha[i] = particles.alpha[last];
+	particles.alphavel[i] = particles.alphavel[last];
+	particles.color[i] = particles.color[last];
+	particlepos.alpha[i] = particlepos.alpha[last];
+}
+
+/*
+ * Moves all particles to the given time, removes the faded
+ * out ones and adds the others to the view if add is true.
+ */
+static void
+CL_UpdateParticles(float time, qboolean simd, qboolean add)
+{
+	vec3_t org;
+	float alpha;
+	int i;
+
+	if (simd)
+	{
+		CL_MovePositionsSIMD(particles.num, time);
+	}
+	else
+	{
+		CL_MovePositionsC(0, particles.num, time);
+	}
+
+	i = 0;
+
+	while (i < particles.num)
+	{
+		alpha = particlepos.alpha[i];
+
+		if (alpha <= 0)
 		{
-			tail->next = p;
-			tail = p;
+			/* faded out, the last particle takes
+			   its place and is looked at next */
+			CL_RemoveParticle(i);
+			continue;
 		}
 
-		if (alpha > 1.0f)
+		if (add)
 		{
-			alpha = 1;
+			org[0] = particlepos.org[0][i];
+			org[1] = particlepos.org[1][i];
+			org[2] = particlepos.org[2][i];
+
+			V_AddParticle(org, particles.color[i], alpha > 1.0f ? 1.0f : alpha);
 		}
 
-		color = p->color;
-		time2 = time * time;
+		i++;
+	}
+}
 
-		org[0] = p->org[0] + p->vel[0] * time + p->accel[0] * time2;
-		org[1] = p->org[1] + p->vel[1] * time + p->accel[1] * time2;
-		org[2] = p->org[2] + p->vel[2] * time + p->accel[2] * time2;
+/*
+ * The renderer keeps the particles and moves them
+ * itself, so they're handed over once and dropped.
+ */
+static void
+CL_HandOverParticles(void)
+{
+	cparticle_t *p, cp;
+	int i, j;
 
-		V_AddParticle(org, color, alpha);
+	/* left over from a renderer that didn't keep particles */
+	for (i = 0; i < particles.num; i++)
+	{
+		cp.time = particles.time[i];
 
+		for (j = 0; j < 3; j++)
+		{
+			cp.org[j] = particles.org[j][i];
+			cp.vel[j] = particles.vel[j][i];
+			cp.accel[j] = particles.accel[j][i];
+		}
+
+		cp.color = particles.color[i];
+		cp.alpha = particles.alpha[i];
+		cp.alphavel = particles.alphavel[i];
+
+		V_KeepParticle(&cp);
+	}
+
+	particles.num = 0;
+
+	for (i = 0, p = newparticles; i < numnewparticles; i++, p++)
+	{
 		if (p->alphavel == INSTANT_PARTICLE)
 		{
-			p->alphavel = 0.0;
-			p->alpha = 0.0;
+			/* shown for this frame only */
+			V_AddParticle(p->org, (int)p->color, p->alpha > 1.0f ? 1.0f : p->alpha);
+		}
+		else
+		{
+			V_KeepParticle(p);
 		}
 	}
 
-	active_particles = active;
+	numnewparticles = 0;
+}
+
+void
+CL_AddParticles(void)
+{
+	if (R_KeepParticles())
+	{
+		CL_HandOverParticles();
+		return;
+	}
+
+	CL_StoreNewParticles();
+	CL_UpdateParticles((float)cl.time, true, true);
 }
 
 void
@@ -251,16 +476,13 @@ CL_GenericParticleEffect(vec3_t org, vec3_t dir, int color,
 
 	for (i = 0; i < count; i++)
 	{
-		if (!free_particles)
+		p = CL_AllocParticle();
+
+		if (!p)
 		{
 			return;
 		}
 
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
-
 		p->time = time;
 
 		if (numcolors > 1)
@@ -289,3 +511,99 @@ CL_GenericParticleEffect(vec3_t org, vec3_t dir, int color,
 	}
 }
 
+/*
+ * Spawns particles through some effects and times how long
+ * CL_AddParticles() needs to move them, once with the plain C
+ * code and once with SIMD. The particles in view are dropped.
+ */
+void
+CL_ParticleBench_f(void)
+{
+	clparticles_t *spawned;
+	long long start, usec;
+	int count, frames, numspawned;
+	int run, f, i, n;
+	vec3_t org, dir;
+
+	count = MAX_PARTICLES / 2;
+	frames = 100;
+
+	if (Cmd_Argc() > 1)
+	{
+		count = (int)strtol(Cmd_Argv(1), (char **)NULL, 10);
+	}
+
+	if (Cmd_Argc() > 2)
+	{
+		frames = (int)strtol(Cmd_Argv(2), (char **)NULL, 10);
+	}
+
+	count = count < 1 ? 1 : (count > MAX_PARTICLES ? MAX_PARTICLES : count);
+	frames = frames < 1 ? 1 : frames;
+
+	CL_ClearParticles();
+
+	VectorCopy(cl.refdef.vieworg, org);
+	VectorSet(dir, 0, 0, 1);
+
+	/* a mix of the common effects, all of them fade out */
+	for (i = 0; numnewparticles < count; i++)
+	{
+		numspawned = numnewparticles;
+		n = count - numnewparticles < 64 ? count - numnewparticles : 64;
+
+		switch (i & 3)
+		{
+			case 0:
+				CL_ParticleEffect(org, dir, 0xe0, n);
+				break;
+			case 1:
+				CL_ParticleEffect2(org, dir, 0xdc, n);
+				break;
+			case 2:
+				CL_ParticleEffect3(org, dir, 0xd0, n);
+				break;
+			default:
+				CL_GenericParticleEffect(org, dir, 0xe8, n, 8, 31, 0.8f);
+				break;
+		}
+
+		if (numnewparticles == numspawned)
+		{
+			break;
+		}
+	}
+
+	CL_StoreNewParticles();
+	numspawned = particles.num;
+
+	spawned = Z_Malloc(sizeof(clparticles_t));
+	memcpy(spawned, &particles, sizeof(clparticles_t));
+
+	Com_Printf("%i particles, %i frames:\n", numspawned, frames);
+
+	for (run = 0; run < 2; run++)
+	{
+		memcpy(&particles, spawned, sizeof(clparticles_t));
+
+		/* the clock advances 1ms per frame, so most particles stay alive */
+		start = Sys_Microseconds();
+
+		for (f = 0; f < frames; f++)
+		{
+			V_ClearScene();
+			CL_UpdateParticles((float)(cl.time + f), run == 1, true);
+		}
+
+		usec = Sys_Microseconds() - start;
+
+		Com_Printf("%-5s %8.1f us per frame, %i particles left\n",
+				run ? CL_PARTICLES_SIMD : "C", (double)usec / frames, particles.num);
+	}
+
+	Z_Free(spawned);
+
+	CL_ClearParticles();
+	V_ClearScene();
+	cl.force_refdef = true;
+}
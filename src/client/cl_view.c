@@ -55,6 +55,10 @@ entity_t r_entities[MAX_ENTITIES];
 int r_numparticles;
 particle_t r_particles[MAX_PARTICLES];
 
+int r_numnewparticles;
+particlestate_t r_newparticles[MAX_PARTICLES];
+qboolean r_clearparticles;
+
 lightstyle_t r_lightstyles[MAX_LIGHTSTYLES];
 
 char cl_weaponmodels[MAX_CLIENTWEAPONMODELS][MAX_QPATH];
@@ -71,6 +75,7 @@ V_ClearScene(void)
 	r_numdlights = 0;
 	r_numentities = 0;
 	r_numparticles = 0;
+	r_numnewparticles = 0;
 }
 
 void
@@ -100,6 +105,40 @@ V_AddParticle(vec3_t org, unsigned int color, float alpha)
 	p->alpha = alpha;
 }
 
+/*
+ * Hands a particle over to renderers that keep
+ * particles, see R_KeepParticles()
+ */
+void
+V_KeepParticle(const cparticle_t *cp)
+{
+	particlestate_t *p;
+
+	if (r_numnewparticles >= MAX_PARTICLES)
+	{
+		return;
+	}
+
+	p = &r_newparticles[r_numnewparticles++];
+	VectorCopy(cp->org, p->origin);
+	VectorCopy(cp->vel, p->vel);
+	VectorCopy(cp->accel, p->accel);
+	p->color = (int)cp->color;
+	p->alpha = cp->alpha;
+	p->alphavel = cp->alphavel;
+	p->time = cp->time;
+}
+
+/*
+ * Drops the particles kept by the renderer
+ */
+void
+V_ClearKeptParticles(void)
+{
+	r_numnewparticles = 0;
+	r_clearparticles = true;
+}
+
 void
 V_AddLight(vec3_t org, float intensity, float r, float g, float b)
 {
@@ -137,7 +176,7 @@ V_AddLightStyle(int style, float r, float g, float b)
 }
 
 /*
- *If cl_testparticles is set, create 4096 particles in the view
+ *If cl_testparticles is set, create MAX_PARTICLES particles in the view
  */
 void
 V_TestParticles(void)
@@ -532,6 +571,7 @@ V_RenderView(float stereo_separation)
 		if (!cl_add_particles->value)
 		{
 			r_numparticles = 0;
+			V_ClearKeptParticles();
 		}
 
 		if (!cl_add_lights->value)
@@ -548,6 +588,10 @@ V_RenderView(float stereo_separation)
 		cl.refdef.entities = r_entities;
 		cl.refdef.num_particles = r_numparticles;
 		cl.refdef.particles = r_particles;
+		cl.refdef.num_newparticles = r_numnewparticles;
+		cl.refdef.newparticles = r_newparticles;
+		cl.refdef.particletime = cl.time;
+		cl.refdef.clearparticles = r_clearparticles;
 		cl.refdef.num_dlights = r_numdlights;
 		cl.refdef.dlights = r_dlights;
 		cl.refdef.lightstyles = r_lightstyles;
@@ -581,6 +625,12 @@ V_RenderView(float stereo_separation)
 
 	R_RenderFrame(&cl.refdef);
 
+	/* the renderer took the new particles, don't
+	   add them again if the refdef is reused */
+	cl.refdef.num_newparticles = 0;
+	cl.refdef.clearparticles = false;
+	r_clearparticles = false;
+
 	if (cl_stats->value)
 	{
 		Com_Printf("ent:%i  lt:%i  part:%i\n", r_numentities,
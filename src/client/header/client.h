@@ -370,9 +370,6 @@ void CL_ParticleEffect3 (vec3_t org, vec3_t dir, int color, int count);
 
 typedef struct particle_s
 {
-
-	struct particle_s	*next;
-
 	float		time;
 
 	vec3_t		org;
@@ -384,6 +381,9 @@ typedef struct particle_s
 	float		alphavel;
 } cparticle_t;
 
+cparticle_t *CL_AllocParticle (void);
+void CL_ParticleBench_f (void);
+
 void CL_ClearEffects (void);
 void CL_ClearTEnts (void);
 void CL_BlasterTrail (vec3_t start, vec3_t end);
@@ -509,7 +509,10 @@ extern	struct model_s	*gun_model;
 void V_Init (void);
 void V_RenderView( float stereo_separation );
 void V_AddEntity (entity_t *ent);
+void V_ClearScene (void);
 void V_AddParticle (vec3_t org, unsigned int color, float alpha);
+void V_KeepParticle (const cparticle_t *p);
+void V_ClearKeptParticles (void);
 void V_AddLight (vec3_t org, float intensity, float r, float g, float b);
 void V_AddLightStyle (int style, float r, float g, float b);
 
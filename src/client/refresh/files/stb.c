@@ -28,6 +28,12 @@
 
 #include <stdlib.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 #include "../ref_shared.h"
 
 // don't need HDR stuff
@@ -108,6 +114,50 @@ ResizeSTB(byte *input_pixels, int input_width, int input_height,
 // We have 16 color palette, 256 / 16 should be enough
 #define COLOR_DISTANCE 16
 
+/*
+ * Returns the first pixel in dst ... end that's not color,
+ * or end. Both SSE2 and NEON are part of the base instruction
+ * set on the platforms where they're used.
+ */
+static unsigned *
+SmoothColorSkip(unsigned *dst, const unsigned *end, unsigned color)
+{
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+	__m128i colors = _mm_set1_epi32(color);
+
+	while (end - dst >= 4)
+	{
+		__m128i eq = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)dst), colors);
+
+		if (_mm_movemask_epi8(eq) != 0xFFFF)
+		{
+			break;
+		}
+
+		dst += 4;
+	}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	uint32x4_t colors = vdupq_n_u32(color);
+
+	while (end - dst >= 4)
+	{
+		if (vminvq_u32(vceqq_u32(vld1q_u32(dst), colors)) != 0xFFFFFFFF)
+		{
+			break;
+		}
+
+		dst += 4;
+	}
+#endif
+
+	while (dst < end && *dst == color)
+	{
+		dst++;
+	}
+
+	return dst;
+}
+
 void
 SmoothColorImage(unsigned *dst, size_t size, size_t rstep)
 {
@@ -131,6 +181,14 @@ SmoothColorImage(unsigned *dst, size_t size, size_t rstep)
 
 	while (dst < full_size)
 	{
+		// most pixels have the same color as the one before
+		dst = SmoothColorSkip(dst, full_size, last_color);
+
+		if (dst >= full_size)
+		{
+			break;
+		}
+
 		if (last_color != *dst)
 		{
 			int step = dst - last_diff;
@@ -157,6 +157,41 @@ BuildWorldVertex(const vec3_t vec, const vec3_t normal, const msurface_t* fa, gl
 	}
 }
 
+/*
+ * The triangle fan of a poly never changes, so the indices
+ * are generated once at load time and the surface batches
+ * only have to reference ranges of the world EBO.
+ */
+static void
+AddPolyToWorldEBO(glpoly_t* poly, size_t lnumverts)
+{
+	size_t numindices = 3 * (lnumverts - 2);
+	unsigned int* dest;
+
+	if (gl3state.num_world_indices + numindices > gl3state.cap_world_indices)
+	{
+		if (gl3state.cap_world_indices == 0) {
+			gl3state.cap_world_indices = max(numindices, 384);
+		}
+		else {
+			gl3state.cap_world_indices = max(gl3state.num_world_indices+numindices, gl3state.cap_world_indices*2);
+		}
+
+		gl3state.world_indices = realloc(gl3state.world_indices, gl3state.cap_world_indices * sizeof(unsigned int));
+	}
+
+	dest = gl3state.world_indices + gl3state.num_world_indices;
+
+	for (size_t i = 2; i < lnumverts; i++)
+	{
+		*dest++ = poly->vbo_first_vert;
+		*dest++ = poly->vbo_first_vert + i - 1;
+		*dest++ = poly->vbo_first_vert + i;
+	}
+
+	gl3state.num_world_indices += numindices;
+}
+
 static void
 AddPolyToWorldVBO(glpoly_t* poly, size_t lnumverts)
 {
@@ -180,6 +215,8 @@ AddPolyToWorldVBO(glpoly_t* poly, size_t lnumverts)
 		lnumverts*sizeof(gl3_3D_vtx_t)
 	);
 	gl3state.num_world_vertices += lnumverts;
+
+	AddPolyToWorldEBO(poly, lnumverts);
 }
 
 void
@@ -232,16 +269,22 @@ GL3_LM_BuildPolygonFromSurface(gl3model_t *currentmodel, msurface_t *fa, int ste
 		BuildWorldVertex(vec, normal, fa, vert, step);
 	}
 
+	fa->ebo_first_index = gl3state.num_world_indices;
 	AddPolyToWorldVBO(poly, lnumverts);
+	fa->ebo_num_indices = gl3state.num_world_indices - fa->ebo_first_index;
 }
 
 void
 GL3_LM_BuildPolygonFromWarpSurface(gl3model_t *currentmodel, msurface_t *fa)
 {
+	fa->ebo_first_index = gl3state.num_world_indices;
+
 	for (glpoly_t* bp = fa->polys; bp != NULL; bp = bp->next)
 	{
 		AddPolyToWorldVBO(bp, bp->numverts);
 	}
+
+	fa->ebo_num_indices = gl3state.num_world_indices - fa->ebo_first_index;
 }
 
 void
@@ -298,6 +341,10 @@ GL3_LM_BeginBuildingLightmaps(gl3model_t *m)
 	gl3_lms.current_lightmap_texture = 0;
 	gl3_lms.internal_format = GL_LIGHTMAP_FORMAT;
 
+	/* the world VBO and EBO only hold the current map */
+	gl3state.num_world_vertices = 0;
+	gl3state.num_world_indices = 0;
+
 	// Note: the dynamic lightmap used to be initialized here, we don't use that anymore.
 }
 
@@ -309,5 +356,11 @@ GL3_LM_EndBuildingLightmaps(void)
 	GL3_BindVBO(gl3state.vboWorld);
 	glBufferData(GL_ARRAY_BUFFER, gl3state.num_world_vertices*sizeof(gl3_3D_vtx_t),
 				(const void*)gl3state.world_vertices, GL_STATIC_DRAW);
+
+	/* the element buffer binding is part of the VAO state */
+	GL3_BindVAO(gl3state.vaoWorld);
+	GL3_BindEBO(gl3state.eboWorld);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, gl3state.num_world_indices*sizeof(unsigned int),
+				(const void*)gl3state.world_indices, GL_STATIC_DRAW);
 }
 
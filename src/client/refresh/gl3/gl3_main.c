@@ -61,6 +61,7 @@ int gl3_visframecount; /* bumped when going to a new PVS */
 int gl3_framecount; /* used for dlight push checking */
 
 int c_brush_polys, c_alias_polys;
+double c_world_walktime; /* microseconds */
 
 static float v_blend[4]; /* final blending color */
 
@@ -89,6 +90,10 @@ cvar_t *r_clear;
 cvar_t *gl3_particle_size;
 cvar_t *gl3_particle_fade_factor;
 cvar_t *gl3_particle_square;
+cvar_t *gl3_multidraw;
+cvar_t *gl3_viscache;
+cvar_t *gl3_gpulerp;
+cvar_t *gl3_gpuparticles;
 
 cvar_t *gl_lefthand;
 cvar_t *r_gunfov;
@@ -183,6 +188,19 @@ GL3_Register(void)
 	// -1: auto (let yq2 choose to enable/disable this based on detected driver)
 	gl3_usebigvbo = ri.Cvar_Get("gl3_usebigvbo", "-1", CVAR_ARCHIVE);
 
+	// 1: draw the world surfaces of a texture and lightmap with one glMultiDrawElements()
+	// 0: one glDrawElements() per surface range, for benchmarking
+	gl3_multidraw = ri.Cvar_Get("gl3_multidraw", "1", 0);
+
+	// 1: cache the visible world surfaces per view cluster instead of walking the BSP tree
+	gl3_viscache = ri.Cvar_Get("gl3_viscache", "1", 0);
+
+	// 1: interpolate the frames of models in the vertex shader
+	gl3_gpulerp = ri.Cvar_Get("gl3_gpulerp", "1", 0);
+
+	// 1: keep the particles in a ring buffer and move them in the vertex shader
+	gl3_gpuparticles = ri.Cvar_Get("gl3_gpuparticles", "1", 0);
+
 	r_norefresh = ri.Cvar_Get("r_norefresh", "0", 0);
 	r_drawentities = ri.Cvar_Get("r_drawentities", "1", 0);
 	r_drawworld = ri.Cvar_Get("r_drawworld", "1", 0);
@@ -586,6 +604,8 @@ GL3_Init(void)
 
 	GL3_SurfInit();
 
+	GL3_InitMeshes();
+
 	GL3_InitLights();
 
 	GL3_Shadow_Init();
@@ -615,6 +635,7 @@ GL3_Shutdown(void)
 		GL3_Shadow_Shutdown();
 		GL3_PostFx_Shutdown();
 		GL3_DestroyAllFramebuffers();
+		GL3_VisCache_Invalidate();
 		GL3_Mod_FreeAll();
 		GL3_ShutdownMeshes();
 		GL3_ShutdownImages();
@@ -915,6 +936,171 @@ GL3_DrawNullModel(entity_t *currententity)
 	GL3_UpdateUBO3D();
 }
 
+// The particles kept on the GPU live in gl3state.vboParticleRing, the
+// client hands every particle over once when it's spawned. head and tail
+// count the particles ever added, the slot in the ring is the count
+// modulo MAX_PARTICLES. The tail only moves past faded out particles, all
+// particles between tail and head are drawn and the vertex shader drops
+// the faded out ones. If the ring is full the oldest are overwritten.
+// Particles that never fade out live KEPT_PARTICLE_MAXLIFE milliseconds,
+// otherwise they'd stop the tail and keep everything after them alive.
+#define KEPT_PARTICLE_MAXLIFE 10000.0f
+
+static struct
+{
+	unsigned int head;
+	unsigned int tail;
+	int baseTime; // refdef_t.particletime the particle times are relative to
+	int time; // refdef_t.particletime of the last world view
+	float dieTime[MAX_PARTICLES]; // milliseconds, relative to baseTime
+} keptParticles;
+
+void
+GL3_ClearKeptParticles(void)
+{
+	keptParticles.head = 0;
+	keptParticles.tail = 0;
+}
+
+static qboolean
+GL3_KeepParticles(void)
+{
+	return gl3_gpuparticles->value && gl3state.siParticleKept.shaderProgram != 0;
+}
+
+static void
+AddKeptParticles(void)
+{
+	int i, j, numParticles, slot, numFirst;
+	const particlestate_t *p;
+	gl3_particle_vtx_t *buf, *cur;
+	YQ2_ALIGNAS_TYPE(unsigned) byte color[4];
+	float time;
+
+	if (gl3_newrefdef.rdflags & RDF_NOWORLDMODEL)
+	{
+		return;
+	}
+
+	if (gl3_newrefdef.clearparticles)
+	{
+		GL3_ClearKeptParticles();
+	}
+
+	keptParticles.time = gl3_newrefdef.particletime;
+	time = (float)(keptParticles.time - keptParticles.baseTime);
+
+	while (keptParticles.tail != keptParticles.head &&
+	       keptParticles.dieTime[keptParticles.tail % MAX_PARTICLES] <= time)
+	{
+		keptParticles.tail++;
+	}
+
+	if (keptParticles.tail == keptParticles.head)
+	{
+		// empty, restart so the times stay small
+		keptParticles.head = keptParticles.tail = 0;
+		keptParticles.baseTime = keptParticles.time;
+	}
+
+	numParticles = gl3_newrefdef.num_newparticles;
+	p = gl3_newrefdef.newparticles;
+
+	if (numParticles <= 0 || !GL3_KeepParticles())
+	{
+		return;
+	}
+
+	if (numParticles > MAX_PARTICLES)
+	{
+		p += numParticles - MAX_PARTICLES;
+		numParticles = MAX_PARTICLES;
+	}
+
+	buf = malloc(numParticles*sizeof(gl3_particle_vtx_t));
+	slot = keptParticles.head % MAX_PARTICLES;
+
+	for (i = 0, cur = buf; i < numParticles; i++, p++, cur++)
+	{
+		*(int *) color = d_8to24table [ p->color & 0xFF ];
+
+		VectorCopy(p->origin, cur->origin);
+		VectorCopy(p->vel, cur->vel);
+		VectorCopy(p->accel, cur->accel);
+
+		for(j=0; j<3; ++j)  cur->color[j] = color[j]/255.0f;
+
+		if (p->color & PARTICLE_EMISSIVE_FLAG)
+		{
+			for(j=0; j<3; ++j)  cur->color[j] *= 3.0f;
+		}
+
+		cur->color[3] = p->alpha;
+		cur->alphavel = p->alphavel;
+
+		time = p->time - keptParticles.baseTime;
+		cur->time = time*0.001f;
+
+		keptParticles.dieTime[(slot + i) % MAX_PARTICLES] = (p->alphavel < 0.0f)
+			? time + 1000.0f*p->alpha/(-p->alphavel) : time + KEPT_PARTICLE_MAXLIFE;
+	}
+
+	GL3_BindVBO(gl3state.vboParticleRing);
+
+	numFirst = min(numParticles, MAX_PARTICLES - slot);
+	glBufferSubData(GL_ARRAY_BUFFER, slot*sizeof(gl3_particle_vtx_t),
+			numFirst*sizeof(gl3_particle_vtx_t), buf);
+
+	if (numFirst < numParticles)
+	{
+		glBufferSubData(GL_ARRAY_BUFFER, 0,
+				(numParticles - numFirst)*sizeof(gl3_particle_vtx_t), buf + numFirst);
+	}
+
+	free(buf);
+
+	keptParticles.head += numParticles;
+
+	if (keptParticles.head - keptParticles.tail > MAX_PARTICLES)
+	{
+		keptParticles.tail = keptParticles.head - MAX_PARTICLES;
+	}
+}
+
+static void
+GL3_DrawKeptParticles(float pointSize)
+{
+	unsigned int numParticles = keptParticles.head - keptParticles.tail;
+	int first = keptParticles.tail % MAX_PARTICLES;
+	GLfloat params[8];
+
+	if (numParticles == 0 || (gl3_newrefdef.rdflags & RDF_NOWORLDMODEL))
+	{
+		return;
+	}
+
+	VectorCopy(gl3_newrefdef.vieworg, params);
+	params[3] = (keptParticles.time - keptParticles.baseTime)*0.001f;
+	params[4] = pointSize;
+	params[5] = KEPT_PARTICLE_MAXLIFE*0.001f;
+	params[6] = params[7] = 0.0f;
+
+	GL3_UseProgram(gl3state.siParticleKept.shaderProgram);
+	glUniform4fv(gl3state.siParticleKept.uniParticleParams, 2, params);
+
+	GL3_BindVAO(gl3state.vaoParticleRing);
+
+	if (first + numParticles <= MAX_PARTICLES)
+	{
+		glDrawArrays(GL_POINTS, first, numParticles);
+	}
+	else
+	{
+		glDrawArrays(GL_POINTS, first, MAX_PARTICLES - first);
+		glDrawArrays(GL_POINTS, 0, numParticles - (MAX_PARTICLES - first));
+	}
+}
+
 static void
 GL3_DrawParticles(void)
 {
@@ -977,6 +1163,8 @@ GL3_DrawParticles(void)
 		glBufferData(GL_ARRAY_BUFFER, sizeof(part_vtx)*numParticles, buf, GL_STREAM_DRAW);
 		glDrawArrays(GL_POINTS, 0, numParticles);
 
+		GL3_DrawKeptParticles(pointSize);
+
 		glDisable(GL_BLEND);
 		glDepthMask(GL_TRUE);
 		glDisable(GL_PROGRAM_POINT_SIZE);
@@ -1313,6 +1501,8 @@ GL3_RenderView(refdef_t *fd)
 
 	gl3_newrefdef = *fd;
 
+	AddKeptParticles();
+
 	int renderScale = ((int)r_renderscale->value) + 1;
 	renderScale = min(renderScale, 8);
 	renderScale = max(renderScale, 1);
@@ -1328,6 +1518,9 @@ GL3_RenderView(refdef_t *fd)
 	{
 		c_brush_polys = 0;
 		c_alias_polys = 0;
+		c_world_drawcalls = 0;
+		c_world_walktime = 0;
+		c_viscache_rebuilds = 0;
 	}
 
 	GL3_SetViewParams(
@@ -1387,9 +1580,12 @@ GL3_RenderView(refdef_t *fd)
 
 	if (r_speeds->value)
 	{
-		R_Printf(PRINT_ALL, "%4i wpoly %4i epoly %i tex %i lmaps\n",
+		R_Printf(PRINT_ALL, "%4i wpoly %4i epoly %i tex %i lmaps %i wdraws\n",
 				c_brush_polys, c_alias_polys, c_visible_textures,
-				c_visible_lightmaps);
+				c_visible_lightmaps, c_world_drawcalls);
+		R_Printf(PRINT_ALL, "%6.1f us world walk (%s) %i vis rebuilds\n",
+				c_world_walktime, gl3_viscache->value ? "cached" : "bsp",
+				c_viscache_rebuilds);
 	}
 }
 
@@ -1707,6 +1903,7 @@ GetRefAPI(refimport_t imp)
 
 	re.BeginFrame = GL3_BeginFrame;
 	re.EndWorldRenderpass = GL3_EndWorldRenderpass;
+	re.KeepParticles = GL3_KeepParticles;
 	re.EndFrame = GL3_EndFrame;
 
     // Tell the client that we're unsing the
@@ -26,6 +26,189 @@
 
 #include "header/local.h"
 
+/* a glcmd vertex, the positions come from the frames buffer */
+typedef struct
+{
+	GLfloat texCoord[2];
+	GLuint index_xyz;
+} gl3_md2_vtx_t;
+
+/*
+ * Puts the vertices of all frames into a texture buffer and the
+ * glcmds, converted to triangles, into a static VBO and EBO, so
+ * DrawAliasFrameLerp() can interpolate the frames in the vertex
+ * shader. Models too big for the texture buffer keep doing that
+ * on the CPU.
+ */
+static void
+UploadMD2(gl3model_t *mod, dmdl_t *pheader)
+{
+	int *order, *end, *p;
+	int numverts, numindices, count, i;
+	GLint maxtexels;
+	gl3_md2_vtx_t *verts, *v;
+	GLuint *indices, *idx;
+	byte *frames;
+
+	glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxtexels);
+
+	if (pheader->num_frames * pheader->num_xyz > maxtexels)
+	{
+		R_Printf(PRINT_DEVELOPER, "%s: %s has too many frames for the GPU\n",
+				__func__, mod->name);
+		return;
+	}
+
+	order = (int *)((byte *)pheader + pheader->ofs_glcmds);
+	end = order + pheader->num_glcmds;
+
+	numverts = 0;
+	numindices = 0;
+
+	for (p = order; (p < end) && *p; p += 3 * count)
+	{
+		count = abs(*p++);
+
+		if ((count < 3) || (p + 3 * count > end))
+		{
+			return;
+		}
+
+		numverts += count;
+		numindices += 3 * (count - 2);
+	}
+
+	verts = malloc(numverts * sizeof(gl3_md2_vtx_t));
+	indices = malloc(numindices * sizeof(GLuint));
+
+	if (!verts || !indices)
+	{
+		free(verts);
+		free(indices);
+		return;
+	}
+
+	v = verts;
+	idx = indices;
+
+	for (p = order; (p < end) && *p; )
+	{
+		GLuint first = v - verts;
+		qboolean fan = (*p < 0);
+
+		count = abs(*p++);
+
+		for (i = 0; i < count; i++, v++, p += 3)
+		{
+			v->texCoord[0] = ((float *)p)[0];
+			v->texCoord[1] = ((float *)p)[1];
+			v->index_xyz = p[2];
+		}
+
+		/* the same triangles DrawAliasFrameLerp() builds */
+		for (i = 1; i < count - 1; i++)
+		{
+			if (fan)
+			{
+				*idx++ = first;
+				*idx++ = first + i;
+				*idx++ = first + i + 1;
+			}
+			else if (i & 1)
+			{
+				*idx++ = first + i - 1;
+				*idx++ = first + i;
+				*idx++ = first + i + 1;
+			}
+			else
+			{
+				*idx++ = first + i - 1;
+				*idx++ = first + i + 1;
+				*idx++ = first + i;
+			}
+		}
+	}
+
+	glGenVertexArrays(1, &mod->aliasVAO);
+	GL3_BindVAO(mod->aliasVAO);
+
+	glGenBuffers(1, &mod->aliasVBO);
+	GL3_BindVBO(mod->aliasVBO);
+	glBufferData(GL_ARRAY_BUFFER, numverts * sizeof(gl3_md2_vtx_t), verts, GL_STATIC_DRAW);
+
+	glEnableVertexAttribArray(GL3_ATTRIB_TEXCOORD);
+	qglVertexAttribPointer(GL3_ATTRIB_TEXCOORD, 2, GL_FLOAT, GL_FALSE, sizeof(gl3_md2_vtx_t), offsetof(gl3_md2_vtx_t, texCoord));
+
+	// the shaders read the vertex index from lightFlags
+	glEnableVertexAttribArray(GL3_ATTRIB_LIGHTFLAGS);
+	qglVertexAttribIPointer(GL3_ATTRIB_LIGHTFLAGS, 1, GL_UNSIGNED_INT, sizeof(gl3_md2_vtx_t), offsetof(gl3_md2_vtx_t, index_xyz));
+
+	glGenBuffers(1, &mod->aliasEBO);
+	GL3_BindEBO(mod->aliasEBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, numindices * sizeof(GLuint), indices, GL_STATIC_DRAW);
+
+	mod->aliasNumIndices = numindices;
+
+	free(verts);
+	free(indices);
+
+	/* x, y, z and normal index of every vertex in every frame,
+	   dtrivertx_t already has that layout */
+	frames = malloc(pheader->num_frames * pheader->num_xyz * sizeof(dtrivertx_t));
+
+	if (frames)
+	{
+		for (i = 0; i < pheader->num_frames; i++)
+		{
+			daliasframe_t *frame = (daliasframe_t *)((byte *)pheader
+					+ pheader->ofs_frames + i * pheader->framesize);
+
+			memcpy(frames + i * pheader->num_xyz * sizeof(dtrivertx_t), frame->verts,
+					pheader->num_xyz * sizeof(dtrivertx_t));
+		}
+
+		glGenBuffers(1, &mod->aliasFramesBuf);
+		glBindBuffer(GL_TEXTURE_BUFFER, mod->aliasFramesBuf);
+		glBufferData(GL_TEXTURE_BUFFER, pheader->num_frames * pheader->num_xyz * sizeof(dtrivertx_t),
+				frames, GL_STATIC_DRAW);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+		glGenTextures(1, &mod->aliasFramesTex);
+		GL3_SelectTMU(GL3_ALIAS_FRAMES_TU);
+		glBindTexture(GL_TEXTURE_BUFFER, mod->aliasFramesTex);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA8UI, mod->aliasFramesBuf);
+		GL3_SelectTMU(GL_TEXTURE0);
+
+		free(frames);
+	}
+	else
+	{
+		GL3_FreeMD2(mod);
+	}
+}
+
+void
+GL3_FreeMD2(gl3model_t *mod)
+{
+	if (mod->aliasVAO)
+	{
+		GL3_BindVAO(0);
+		glDeleteVertexArrays(1, &mod->aliasVAO);
+		glDeleteBuffers(1, &mod->aliasVBO);
+		glDeleteBuffers(1, &mod->aliasEBO);
+	}
+
+	if (mod->aliasFramesTex)
+	{
+		glDeleteTextures(1, &mod->aliasFramesTex);
+		glDeleteBuffers(1, &mod->aliasFramesBuf);
+	}
+
+	mod->aliasVAO = mod->aliasVBO = mod->aliasEBO = 0;
+	mod->aliasFramesBuf = mod->aliasFramesTex = 0;
+	mod->aliasNumIndices = 0;
+}
+
 void
 GL3_LoadMD2(gl3model_t *mod, void *buffer, int modfilelen)
 {
@@ -168,6 +351,8 @@ GL3_LoadMD2(gl3model_t *mod, void *buffer, int modfilelen)
 				it_skin);
 	}
 
+	UploadMD2(mod, pheader);
+
 	mod->mins[0] = -32;
 	mod->mins[1] = -32;
 	mod->mins[2] = -32;
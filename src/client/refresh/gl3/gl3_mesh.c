@@ -63,6 +63,45 @@ DA_TYPEDEF(GLushort, UShortArray_t);
 static AliasVtxArray_t vtxBuf = {0};
 static UShortArray_t idxBuf = {0};
 
+/*
+ * Uploads the normals and the shadedots for the
+ * frame interpolation in the vertex shaders.
+ */
+void
+GL3_InitMeshes(void)
+{
+	float normals[NUMVERTEXNORMALS][4];
+
+	for (int i = 0; i < NUMVERTEXNORMALS; i++)
+	{
+		VectorCopy(r_avertexnormals[i], normals[i]);
+		normals[i][3] = 0;
+	}
+
+	glGenBuffers(1, &gl3state.aliasNormalsBuf);
+	glBindBuffer(GL_TEXTURE_BUFFER, gl3state.aliasNormalsBuf);
+	glBufferData(GL_TEXTURE_BUFFER, sizeof(normals), normals, GL_STATIC_DRAW);
+
+	glGenBuffers(1, &gl3state.aliasShadedotsBuf);
+	glBindBuffer(GL_TEXTURE_BUFFER, gl3state.aliasShadedotsBuf);
+	glBufferData(GL_TEXTURE_BUFFER, sizeof(r_avertexnormal_dots), r_avertexnormal_dots, GL_STATIC_DRAW);
+
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	// these stay bound, nothing else uses the texture units
+	glGenTextures(1, &gl3state.aliasNormalsTex);
+	GL3_SelectTMU(GL3_ALIAS_NORMALS_TU);
+	glBindTexture(GL_TEXTURE_BUFFER, gl3state.aliasNormalsTex);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, gl3state.aliasNormalsBuf);
+
+	glGenTextures(1, &gl3state.aliasShadedotsTex);
+	GL3_SelectTMU(GL3_ALIAS_SHADEDOTS_TU);
+	glBindTexture(GL_TEXTURE_BUFFER, gl3state.aliasShadedotsTex);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, gl3state.aliasShadedotsBuf);
+
+	GL3_SelectTMU(GL_TEXTURE0);
+}
+
 void
 GL3_ShutdownMeshes(void)
 {
@@ -70,6 +109,14 @@ GL3_ShutdownMeshes(void)
 	da_free(idxBuf);
 
 	da_free(shadowModels);
+
+	glDeleteTextures(1, &gl3state.aliasNormalsTex);
+	glDeleteBuffers(1, &gl3state.aliasNormalsBuf);
+	glDeleteTextures(1, &gl3state.aliasShadedotsTex);
+	glDeleteBuffers(1, &gl3state.aliasShadedotsBuf);
+
+	gl3state.aliasNormalsTex = gl3state.aliasNormalsBuf = 0;
+	gl3state.aliasShadedotsTex = gl3state.aliasShadedotsBuf = 0;
 }
 
 static void
@@ -104,6 +151,111 @@ LerpVerts(qboolean powerUpEffect, int nverts, dtrivertx_t *v, dtrivertx_t *ov,
 	}
 }
 
+static void
+SetupLerp(dmdl_t *paliashdr, entity_t* entity, float move[3], float frontv[3], float backv[3])
+{
+	daliasframe_t *frame, *oldframe;
+	vec3_t delta, vectors[3];
+	float backlerp = entity->backlerp;
+	float frontlerp = 1.0 - backlerp;
+	int i;
+
+	frame = (daliasframe_t *)((byte *)paliashdr + paliashdr->ofs_frames
+							  + entity->frame * paliashdr->framesize);
+
+	oldframe = (daliasframe_t *)((byte *)paliashdr + paliashdr->ofs_frames
+				+ entity->oldframe * paliashdr->framesize);
+
+	/* move should be the delta back to the previous frame * backlerp */
+	VectorSubtract(entity->oldorigin, entity->origin, delta);
+	AngleVectors(entity->angles, vectors[0], vectors[1], vectors[2]);
+
+	move[0] = DotProduct(delta, vectors[0]); /* forward */
+	move[1] = -DotProduct(delta, vectors[1]); /* left */
+	move[2] = DotProduct(delta, vectors[2]); /* up */
+
+	VectorAdd(move, oldframe->translate, move);
+
+	for (i = 0; i < 3; i++)
+	{
+		move[i] = backlerp * move[i] + frontlerp * frame->translate[i];
+
+		frontv[i] = frontlerp * frame->scale[i];
+		backv[i] = backlerp * oldframe->scale[i];
+	}
+}
+
+/*
+ * The same as DrawAliasFrameLerp(), but with the frames in a texture
+ * buffer (see GL3_LoadMD2()), the vertex shader does the lerp. Returns
+ * false if the model or the current pass can't be drawn like that.
+ */
+static qboolean
+DrawAliasFrameLerpGPU(dmdl_t *paliashdr, entity_t* entity, vec3_t shadelight,
+		qboolean colorOnly, float alpha)
+{
+	gl3model_t *model = entity->model;
+	GLuint oldProgram = gl3state.currentShaderProgram;
+	gl3ShaderInfo_t *si;
+	vec4_t params[5];
+	int shadedots;
+
+	if (!gl3_gpulerp->value || !model->aliasVAO || !model->aliasFramesTex)
+	{
+		return false;
+	}
+
+	if (gl3state.renderPass == RENDER_PASS_SCENE)
+	{
+		si = colorOnly ? &gl3state.si3DaliasLerpColor : &gl3state.si3DaliasLerp;
+	}
+	else if (oldProgram == gl3state.siShadowMap.shaderProgram)
+	{
+		si = &gl3state.siShadowMapAlias;
+	}
+	else if (oldProgram == gl3state.si3DSSAO.shaderProgram)
+	{
+		si = &gl3state.si3DSSAOAlias;
+	}
+	else
+	{
+		return false;
+	}
+
+	if (!si->shaderProgram)
+	{
+		return false;
+	}
+
+	SetupLerp(paliashdr, entity, params[0], params[1], params[2]);
+
+	shadedots = ((int)(entity->angles[1] * (SHADEDOT_QUANT / 360.0))) & (SHADEDOT_QUANT - 1);
+
+	params[0][3] = colorOnly ? POWERSUIT_SCALE : 0;
+	params[1][3] = entity->frame * paliashdr->num_xyz;
+	params[2][3] = entity->oldframe * paliashdr->num_xyz;
+	VectorCopy(shadelight, params[3]);
+	params[3][3] = alpha;
+	params[4][0] = shadedots * 256;
+	params[4][1] = colorOnly ? 1 : 0;
+	params[4][2] = params[4][3] = 0;
+
+	GL3_UseProgram(si->shaderProgram);
+	glUniform4fv(si->uniAliasParams, 5, params[0]);
+
+	GL3_SelectTMU(GL3_ALIAS_FRAMES_TU);
+	glBindTexture(GL_TEXTURE_BUFFER, model->aliasFramesTex);
+	GL3_SelectTMU(GL_TEXTURE0);
+
+	GL3_BindVAO(model->aliasVAO);
+	glDrawElements(GL_TRIANGLES, model->aliasNumIndices, GL_UNSIGNED_INT, NULL);
+
+	// the shadow map and SSAO passes draw the world with it afterwards
+	GL3_UseProgram(oldProgram);
+
+	return true;
+}
+
 /*
  * Interpolates between two frames and origins
  */
@@ -117,12 +269,9 @@ DrawAliasFrameLerp(dmdl_t *paliashdr, entity_t* entity, vec3_t shadelight)
 	int *order;
 	int count;
 	float alpha;
-	vec3_t move, delta, vectors[3];
+	vec3_t move;
 	vec3_t frontv, backv;
-	int i;
 	int index_xyz;
-	float backlerp = entity->backlerp;
-	float frontlerp = 1.0 - backlerp;
 	float *lerp;
 	// draw without texture? used for quad damage effect etc, I think
 	qboolean colorOnly = 0 != (entity->flags &
@@ -152,6 +301,11 @@ DrawAliasFrameLerp(dmdl_t *paliashdr, entity_t* entity, vec3_t shadelight)
 		alpha = 1.0;
 	}
 
+	if (DrawAliasFrameLerpGPU(paliashdr, entity, shadelight, colorOnly, alpha))
+	{
+		return;
+	}
+
 	if (gl3state.renderPass == RENDER_PASS_SCENE)
 	{
 		if (colorOnly)
@@ -164,23 +318,7 @@ DrawAliasFrameLerp(dmdl_t *paliashdr, entity_t* entity, vec3_t shadelight)
 		}
 	}
 
-	/* move should be the delta back to the previous frame * backlerp */
-	VectorSubtract(entity->oldorigin, entity->origin, delta);
-	AngleVectors(entity->angles, vectors[0], vectors[1], vectors[2]);
-
-	move[0] = DotProduct(delta, vectors[0]); /* forward */
-	move[1] = -DotProduct(delta, vectors[1]); /* left */
-	move[2] = DotProduct(delta, vectors[2]); /* up */
-
-	VectorAdd(move, oldframe->translate, move);
-
-	for (i = 0; i < 3; i++)
-	{
-		move[i] = backlerp * move[i] + frontlerp * frame->translate[i];
-
-		frontv[i] = frontlerp * frame->scale[i];
-		backv[i] = backlerp * oldframe->scale[i];
-	}
+	SetupLerp(paliashdr, entity, move, frontv, backv);
 
 	lerp = s_lerped[0];
 
@@ -1409,6 +1409,11 @@ Mod_LoadBrushModel(gl3model_t *mod, void *buffer, int modfilelen)
 static void
 Mod_Free(gl3model_t *mod)
 {
+	if (mod->type == mod_alias)
+	{
+		GL3_FreeMD2(mod);
+	}
+
 	Hunk_Free(mod->extradata);
 	memset(mod, 0, sizeof(*mod));
 }
@@ -1762,6 +1767,7 @@ GL3_BeginRegistration(char *model)
 	gl3_worldmodel = Mod_ForName(fullname, NULL, true);
 
 	gl3_viewcluster = -1;
+	GL3_VisCache_Invalidate();
 
 	GL3_InitLights();
 	GL3_Shadow_Shutdown();
@@ -213,7 +213,7 @@ void GL3_PostFx_BeforeScene()
 		// render the opaque world geometry
 		entity_t ent = {0};
 		ent.frame = (int)(gl3_newrefdef.time * 2);
-		GL3_RecursiveWorldNode(&ent, gl3_worldmodel->nodes, gl3_newrefdef.vieworg);
+		GL3_AddWorldSurfaces(&ent, gl3_newrefdef.vieworg);
 		GL3_DrawTextureChains(&ent);
 		GL3_DrawEntitiesOnList();
 
@@ -135,6 +135,7 @@ CreateShaderProgram(int numShaders, const GLuint* shaders)
 	glBindAttribLocation(shaderProgram, GL3_ATTRIB_STYLE1, "style1");
 	glBindAttribLocation(shaderProgram, GL3_ATTRIB_STYLE2, "style2");
 	glBindAttribLocation(shaderProgram, GL3_ATTRIB_STYLE3, "style3");
+	glBindAttribLocation(shaderProgram, GL3_ATTRIB_ACCEL, "accel");
 
 	// the following line is not necessary/implicit (as there's only one output)
 	// glBindFragDataLocation(shaderProgram, 0, "outColor"); XXX would this even be here?
@@ -409,6 +410,8 @@ initShader3D(gl3ShaderInfo_t* shaderInfo, const char* vertSrc, const char* fragS
 
 	shaderInfo->shaderProgram = 0;
 	shaderInfo->uniLmScales = -1;
+	shaderInfo->uniAliasParams = -1;
+	shaderInfo->uniParticleParams = -1;
 
 	shaders3D[0] = CompileShader(GL_VERTEX_SHADER, vertexCommon3D, vertSrc);
 	if(shaders3D[0] == 0)  return false;
@@ -531,6 +534,12 @@ initShader3D(gl3ShaderInfo_t* shaderInfo, const char* vertSrc, const char* fragS
 	glUniform1i(glGetUniformLocation(prog, "faceSelectionTex1"), GL3_FACE_SELECTION1_TU - GL_TEXTURE0);
 	glUniform1i(glGetUniformLocation(prog, "faceSelectionTex2"), GL3_FACE_SELECTION2_TU - GL_TEXTURE0);
 	glUniform1i(glGetUniformLocation(prog, "ssao_sampler"), GL3_SSAO_MAP_TU - GL_TEXTURE0);
+	glUniform1i(glGetUniformLocation(prog, "aliasFrames"), GL3_ALIAS_FRAMES_TU - GL_TEXTURE0);
+	glUniform1i(glGetUniformLocation(prog, "aliasNormals"), GL3_ALIAS_NORMALS_TU - GL_TEXTURE0);
+	glUniform1i(glGetUniformLocation(prog, "aliasShadedots"), GL3_ALIAS_SHADEDOTS_TU - GL_TEXTURE0);
+
+	shaderInfo->uniAliasParams = glGetUniformLocation(prog, "aliasParams");
+	shaderInfo->uniParticleParams = glGetUniformLocation(prog, "particleParams");
 
 	GLint lmScalesLoc = glGetUniformLocation(prog, "lmScales");
 	shaderInfo->uniLmScales = lmScalesLoc;
@@ -713,6 +722,14 @@ static qboolean createShaders(void)
 		R_Printf(PRINT_ALL, "WARNING: Failed to create shader program for rendering world shadow map!\n");
 		return false;
 	}
+	// the models fall back to interpolating on the CPU if these are missing
+	if(!initShader3D(&gl3state.si3DaliasLerp, vertexSrcAliasLerp, fragmentSrcAlias) ||
+	   !initShader3D(&gl3state.si3DaliasLerpColor, vertexSrcAliasLerp, fragmentSrcAliasColor) ||
+	   !initShader3D(&gl3state.siShadowMapAlias, vertexSrcShadowMapAlias, fragmentSrcShadowMap) ||
+	   !initShader3D(&gl3state.si3DSSAOAlias, vertexSrc3DSSAOAlias, fragmentSrc3DSSAO))
+	{
+		R_Printf(PRINT_ALL, "WARNING: Failed to create shader programs for interpolating models on the GPU!\n");
+	}
 	//eprintf("si3DDebug\n");
 	if(!initShader3D(&gl3state.si3Ddebug, vertexSrc3Ddebug, fragmentSrc3Ddebug))
 	{
@@ -731,6 +748,11 @@ static qboolean createShaders(void)
 		R_Printf(PRINT_ALL, "WARNING: Failed to create shader program for rendering particles!\n");
 		return false;
 	}
+	// the client animates the particles if this is missing
+	if(!initShader3D(&gl3state.siParticleKept, vertexSrcParticlesKept, particleFrag))
+	{
+		R_Printf(PRINT_ALL, "WARNING: Failed to create shader program for moving particles on the GPU!\n");
+	}
 
 
 	if (!initShaderPostfx(&gl3state.siPostfxResolveMultisample, vertexSrcPostfxCommon, fragmentSrcPostfxResolveMultisample))
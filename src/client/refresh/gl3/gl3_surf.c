@@ -29,6 +29,8 @@
 
 #include "header/local.h"
 
+#include <SDL.h>
+
 int c_visible_lightmaps;
 int c_visible_textures;
 msurface_t *gl3_alpha_surfaces;
@@ -95,6 +97,9 @@ void GL3_SurfInit(void)
 
 	Setup3DAttributes();
 
+	glGenBuffers(1, &gl3state.eboWorld);
+	GL3_BindEBO(gl3state.eboWorld);
+
 
 	// init VAO and VBO for model vertexdata: 9 floats
 	// (X,Y,Z), (S,T), (R,G,B,A)
@@ -137,6 +142,34 @@ void GL3_SurfInit(void)
 
 	glEnableVertexAttribArray(GL3_ATTRIB_COLOR);
 	qglVertexAttribPointer(GL3_ATTRIB_COLOR, 4, GL_FLOAT, GL_FALSE, 9*sizeof(GLfloat), 5*sizeof(GLfloat));
+
+	// init VAO and VBO for the particles kept on the GPU, the VBO is a
+	// ring buffer of MAX_PARTICLES gl3_particle_vtx_t that is only ever
+	// updated with glBufferSubData()
+
+	glGenVertexArrays(1, &gl3state.vaoParticleRing);
+	GL3_BindVAO(gl3state.vaoParticleRing);
+
+	glGenBuffers(1, &gl3state.vboParticleRing);
+	GL3_BindVBO(gl3state.vboParticleRing);
+	glBufferData(GL_ARRAY_BUFFER, MAX_PARTICLES*sizeof(gl3_particle_vtx_t), NULL, GL_DYNAMIC_DRAW);
+
+	glEnableVertexAttribArray(GL3_ATTRIB_POSITION);
+	qglVertexAttribPointer(GL3_ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(gl3_particle_vtx_t), offsetof(gl3_particle_vtx_t, origin));
+
+	glEnableVertexAttribArray(GL3_ATTRIB_NORMAL); // velocity
+	qglVertexAttribPointer(GL3_ATTRIB_NORMAL, 3, GL_FLOAT, GL_FALSE, sizeof(gl3_particle_vtx_t), offsetof(gl3_particle_vtx_t, vel));
+
+	glEnableVertexAttribArray(GL3_ATTRIB_ACCEL);
+	qglVertexAttribPointer(GL3_ATTRIB_ACCEL, 3, GL_FLOAT, GL_FALSE, sizeof(gl3_particle_vtx_t), offsetof(gl3_particle_vtx_t, accel));
+
+	glEnableVertexAttribArray(GL3_ATTRIB_COLOR);
+	qglVertexAttribPointer(GL3_ATTRIB_COLOR, 4, GL_FLOAT, GL_FALSE, sizeof(gl3_particle_vtx_t), offsetof(gl3_particle_vtx_t, color));
+
+	glEnableVertexAttribArray(GL3_ATTRIB_TEXCOORD); // (alphavel, time)
+	qglVertexAttribPointer(GL3_ATTRIB_TEXCOORD, 2, GL_FLOAT, GL_FALSE, sizeof(gl3_particle_vtx_t), offsetof(gl3_particle_vtx_t, alphavel));
+
+	GL3_ClearKeptParticles();
 }
 
 void GL3_SurfShutdown(void)
@@ -146,6 +179,8 @@ void GL3_SurfShutdown(void)
 	glDeleteVertexArrays(1, &gl3state.vao3D);
 	gl3state.vao3D = 0;
 
+	glDeleteBuffers(1, &gl3state.eboWorld);
+	gl3state.eboWorld = 0;
 	glDeleteBuffers(1, &gl3state.vboWorld);
 	gl3state.vboWorld = 0;
 	glDeleteVertexArrays(1, &gl3state.vaoWorld);
@@ -157,6 +192,11 @@ void GL3_SurfShutdown(void)
 	gl3state.vboAlias = 0;
 	glDeleteVertexArrays(1, &gl3state.vaoAlias);
 	gl3state.vaoAlias = 0;
+
+	glDeleteBuffers(1, &gl3state.vboParticleRing);
+	gl3state.vboParticleRing = 0;
+	glDeleteVertexArrays(1, &gl3state.vaoParticleRing);
+	gl3state.vaoParticleRing = 0;
 }
 
 /*
@@ -393,6 +433,8 @@ GL3_DrawTextureChains(entity_t *currententity)
 		{
 			if ((s->texinfo->flags & SURF_LIGHT) != is_emissive)
 			{
+				/* the queued surfaces still need the old emission */
+				GL3_SurfBatch_Flush();
 				is_emissive = (s->texinfo->flags & SURF_LIGHT);
 				gl3state.uni3DData.emission = is_emissive ? 1.0f : 0.0f;
 				GL3_UpdateUBO3D();
@@ -618,6 +660,41 @@ GL3_DrawBrushModel(entity_t *e, gl3model_t *currentmodel)
 	}
 }
 
+static void
+AddWorldSurface(entity_t* currententity, msurface_t* surf)
+{
+	gl3image_t *image;
+
+	if (gl3state.renderPass == RENDER_PASS_SSAO)
+	{
+		surf->texturechain = g_ssao_surfaces;
+		g_ssao_surfaces = surf;
+	}
+	else
+	{
+		surf->texturechain = NULL;
+		if (surf->texinfo->flags & SURF_SKY)
+		{
+			/* just adds to visible sky bounds */
+			GL3_AddSkySurface(surf);
+		}
+		else if (surf->texinfo->flags & (SURF_TRANS33 | SURF_TRANS66))
+		{
+			/* add to the translucent chain */
+			surf->texturechain = gl3_alpha_surfaces;
+			gl3_alpha_surfaces = surf;
+			gl3_alpha_surfaces->texinfo->image = TextureAnimation(currententity, surf->texinfo);
+		}
+		else
+		{
+			/* the polygon is visible, so add it to the texture sorted chain */
+			image = TextureAnimation(currententity, surf->texinfo);
+			surf->texturechain = image->texturechain;
+			image->texturechain = surf;
+		}
+	}
+}
+
 void
 GL3_RecursiveWorldNode(entity_t* currententity, mnode_t* node, const vec3_t modelorg)
 {
@@ -626,7 +703,6 @@ GL3_RecursiveWorldNode(entity_t* currententity, mnode_t* node, const vec3_t mode
 	msurface_t *surf, **mark;
 	mleaf_t *pleaf;
 	float dot;
-	gl3image_t *image;
 
 	if (node->contents == CONTENTS_SOLID)
 	{
@@ -722,38 +798,139 @@ GL3_RecursiveWorldNode(entity_t* currententity, mnode_t* node, const vec3_t mode
 			continue; /* wrong side */
 		}
 
-		if (gl3state.renderPass == RENDER_PASS_SSAO)
+		AddWorldSurface(currententity, surf);
+	}
+
+	/* recurse down the back side */
+	GL3_RecursiveWorldNode(currententity, node->children[!side], modelorg);
+}
+
+typedef struct
+{
+	msurface_t *surf;
+	float dist;
+} alphasurf_t;
+
+#define MAX_SORTED_ALPHA_SURFACES 1024
+
+static float
+SurfaceDistanceSquared(const msurface_t *surf, const vec3_t modelorg)
+{
+	const glpoly_t *p = surf->polys;
+	vec3_t center, delta;
+
+	VectorClear(center);
+
+	for (int i = 0; i < p->numverts; i++)
+	{
+		VectorAdd(center, p->vertices[i].pos, center);
+	}
+
+	VectorScale(center, 1.0f / p->numverts, center);
+	VectorSubtract(center, modelorg, delta);
+
+	return DotProduct(delta, delta);
+}
+
+/*
+ * The same as GL3_RecursiveWorldNode(), but with the visible surface
+ * cache. Without the walk there's no front to back order, so the
+ * translucent surfaces are sorted by distance instead.
+ */
+static void
+AddCachedWorldSurfaces(entity_t* currententity, const vec3_t modelorg)
+{
+	static alphasurf_t alphasurfs[MAX_SORTED_ALPHA_SURFACES];
+	msurface_t **surfaces;
+	int numsurfaces, numalpha, i, j;
+	cplane_t *plane;
+	float dot;
+
+	surfaces = GL3_VisCache_MarkSurfaces(&numsurfaces);
+	numalpha = 0;
+
+	for (i = 0; i < numsurfaces; i++)
+	{
+		msurface_t *surf = surfaces[i];
+
+		if (surf->visframe != gl3_framecount)
 		{
-			surf->texturechain = g_ssao_surfaces;
-			g_ssao_surfaces = surf;
+			continue;
 		}
-		else
+
+		/* a surface lies on the plane of its node */
+		plane = surf->plane;
+
+		switch (plane->type)
 		{
-			surf->texturechain = NULL;
-			if (surf->texinfo->flags & SURF_SKY)
-			{
-				/* just adds to visible sky bounds */
-				GL3_AddSkySurface(surf);
-			}
-			else if (surf->texinfo->flags & (SURF_TRANS33 | SURF_TRANS66))
-			{
-				/* add to the translucent chain */
-				surf->texturechain = gl3_alpha_surfaces;
-				gl3_alpha_surfaces = surf;
-				gl3_alpha_surfaces->texinfo->image = TextureAnimation(currententity, surf->texinfo);
-			}
-			else
+			case PLANE_X:
+				dot = modelorg[0] - plane->dist;
+				break;
+			case PLANE_Y:
+				dot = modelorg[1] - plane->dist;
+				break;
+			case PLANE_Z:
+				dot = modelorg[2] - plane->dist;
+				break;
+			default:
+				dot = DotProduct(modelorg, plane->normal) - plane->dist;
+				break;
+		}
+
+		if ((surf->flags & SURF_PLANEBACK) != ((dot >= 0) ? 0 : SURF_PLANEBACK))
+		{
+			continue; /* wrong side */
+		}
+
+		if ((gl3state.renderPass != RENDER_PASS_SSAO) &&
+			(surf->texinfo->flags & (SURF_TRANS33 | SURF_TRANS66)) &&
+			(numalpha < MAX_SORTED_ALPHA_SURFACES))
+		{
+			alphasurf_t a;
+
+			a.surf = surf;
+			a.dist = SurfaceDistanceSquared(surf, modelorg);
+
+			/* insertion sort, near to far */
+			for (j = numalpha++; j > 0 && alphasurfs[j - 1].dist > a.dist; j--)
 			{
-				/* the polygon is visible, so add it to the texture sorted chain */
-				image = TextureAnimation(currententity, surf->texinfo);
-				surf->texturechain = image->texturechain;
-				image->texturechain = surf;
+				alphasurfs[j] = alphasurfs[j - 1];
 			}
+
+			alphasurfs[j] = a;
+			continue;
 		}
+
+		AddWorldSurface(currententity, surf);
 	}
 
-	/* recurse down the back side */
-	GL3_RecursiveWorldNode(currententity, node->children[!side], modelorg);
+	/* the chain is built front to back, it's drawn back to front */
+	for (i = 0; i < numalpha; i++)
+	{
+		AddWorldSurface(currententity, alphasurfs[i].surf);
+	}
+}
+
+/*
+ * Puts the visible world surfaces on the texture chains
+ * (or the SSAO chain) and the translucent chain.
+ */
+void
+GL3_AddWorldSurfaces(entity_t* currententity, const vec3_t modelorg)
+{
+	Uint64 start = SDL_GetPerformanceCounter();
+
+	if (gl3_viscache->value)
+	{
+		AddCachedWorldSurfaces(currententity, modelorg);
+	}
+	else
+	{
+		GL3_RecursiveWorldNode(currententity, gl3_worldmodel->nodes, modelorg);
+	}
+
+	c_world_walktime += (double)(SDL_GetPerformanceCounter() - start) * 1000000.0 /
+		(double)SDL_GetPerformanceFrequency();
 }
 
 void
@@ -781,7 +958,7 @@ GL3_DrawWorld(void)
 	ent.frame = (int)(gl3_newrefdef.time * 2);
 
 	GL3_ClearSkyBox();
-	GL3_RecursiveWorldNode(&ent, gl3_worldmodel->nodes, modelorg);
+	GL3_AddWorldSurfaces(&ent, modelorg);
 	GL3_DrawTextureChains(&ent);
 	GL3_DrawSkyBox();
 	DrawTriangleOutlines();
@@ -1,82 +1,141 @@
 #include "header/local.h"
 
-#define MAX_BATCH_INDICES (4096*2)
+// The indices of all world surfaces live in gl3state.eboWorld (built
+// once per map, see AddPolyToWorldEBO()), so a batch is only a list of
+// index ranges. The ranges are bucketed by lightmap and each bucket is
+// drawn with a single glMultiDrawElements() call on flush.
 
-static unsigned int 	batch_indices[MAX_BATCH_INDICES];
-static size_t 		batch_numindices;
-static int 		batch_lmtexnum;
+#define MAX_BATCH_RANGES 4096
 
-static size_t NumberOfIndicesForSurface(msurface_t* fa)
+// bucket 0 draws with whatever lightmap is bound, bucket n+1 binds lightmap n
+#define NUM_BATCH_BUCKETS (MAX_LIGHTMAPS + 1)
+
+typedef struct
 {
-	if (fa->flags & SURF_DRAWTURB)
-	{
-		size_t count = 0;
-		for (glpoly_t* bp = fa->polys; bp != NULL; bp = bp->next)
-		{
-			count += bp->numverts * 3 - 6;
-		}
-		return count;
-	}
-	else
-	{
-		return 3 * (fa->numedges - 2);
-	}
-}
+	GLuint first; // first index in the world EBO
+	GLsizei count;
+	int next; // next range in the same bucket, -1 ends the list
+} batchrange_t;
+
+static batchrange_t	batch_ranges[MAX_BATCH_RANGES];
+static int		batch_numranges;
+
+// range index + 1, 0 for empty buckets
+static int		batch_heads[NUM_BATCH_BUCKETS];
+static int		batch_tails[NUM_BATCH_BUCKETS];
+
+// used buckets, in the order they were first used
+static int		batch_buckets[NUM_BATCH_BUCKETS];
+static int		batch_numbuckets;
+
+static GLsizei		draw_counts[MAX_BATCH_RANGES];
+static const GLvoid*	draw_offsets[MAX_BATCH_RANGES];
+
+int c_world_drawcalls;
 
 void GL3_SurfBatch_Clear()
 {
-	batch_lmtexnum = -1;
-	batch_numindices = 0;
+	for (int i = 0; i < batch_numbuckets; i++)
+	{
+		batch_heads[batch_buckets[i]] = 0;
+	}
+
+	batch_numbuckets = 0;
+	batch_numranges = 0;
 }
 
 void GL3_SurfBatch_Begin()
 {
 	GL3_BindVAO(gl3state.vaoWorld);
-	GL3_BindEBO(0);
+	GL3_BindEBO(gl3state.eboWorld);
 	GL3_SurfBatch_Clear();
 }
 
-void GL3_SurfBatch_Flush()
+static void DrawBucket(int bucket)
 {
-	if (batch_numindices == 0) { return; }
+	int numdraws = 0;
+
+	for (int r = batch_heads[bucket] - 1; r >= 0; r = batch_ranges[r].next)
+	{
+		draw_counts[numdraws] = batch_ranges[r].count;
+		draw_offsets[numdraws] = (const GLvoid*)(batch_ranges[r].first * sizeof(GLuint));
+		numdraws++;
+	}
 
-	glDrawElements(GL_TRIANGLES, batch_numindices, GL_UNSIGNED_INT, batch_indices);
+	if (bucket > 0)
+	{
+		GL3_BindLightmap(bucket - 1);
+	}
 
-	batch_numindices = 0;
+	if (gl3_multidraw->value)
+	{
+		glMultiDrawElements(GL_TRIANGLES, draw_counts, GL_UNSIGNED_INT, draw_offsets, numdraws);
+		c_world_drawcalls++;
+	}
+	else
+	{
+		for (int i = 0; i < numdraws; i++)
+		{
+			glDrawElements(GL_TRIANGLES, draw_counts[i], GL_UNSIGNED_INT, draw_offsets[i]);
+		}
+		c_world_drawcalls += numdraws;
+	}
 }
 
-void GL3_SurfBatch_Add(msurface_t* fa)
+void GL3_SurfBatch_Flush()
 {
-	size_t numindices = NumberOfIndicesForSurface(fa);
-	if (batch_numindices + numindices > MAX_BATCH_INDICES)
+	for (int i = 0; i < batch_numbuckets; i++)
 	{
-		GL3_SurfBatch_Flush();
+		DrawBucket(batch_buckets[i]);
 	}
 
-	unsigned int* dest = batch_indices + batch_numindices;
-	if (fa->flags & SURF_DRAWTURB)
+	GL3_SurfBatch_Clear();
+}
+
+static void AddToBucket(msurface_t* fa, int bucket)
+{
+	batchrange_t* range;
+
+	if (fa->ebo_num_indices == 0) { return; }
+
+	if (batch_heads[bucket])
 	{
-		for (glpoly_t* bp = fa->polys; bp != NULL; bp = bp->next)
+		// surfaces are often neighbours in the EBO, so grow the last range
+		range = &batch_ranges[batch_tails[bucket] - 1];
+
+		if (range->first + range->count == fa->ebo_first_index)
 		{
-			for (int i=2; i<bp->numverts; i++)
-			{
-				*dest++ = bp->vbo_first_vert;
-				*dest++ = bp->vbo_first_vert + i - 1;
-				*dest++ = bp->vbo_first_vert + i;
-			}
+			range->count += fa->ebo_num_indices;
+			return;
 		}
 	}
+
+	if (batch_numranges == MAX_BATCH_RANGES)
+	{
+		GL3_SurfBatch_Flush();
+	}
+
+	range = &batch_ranges[batch_numranges++];
+	range->first = fa->ebo_first_index;
+	range->count = fa->ebo_num_indices;
+	range->next = -1;
+
+	if (batch_heads[bucket])
+	{
+		batch_ranges[batch_tails[bucket] - 1].next = batch_numranges - 1;
+	}
 	else
 	{
-		for (int i=2; i<fa->numedges; i++)
-		{
-			*dest++ = fa->polys->vbo_first_vert;
-			*dest++ = fa->polys->vbo_first_vert + i - 1;
-			*dest++ = fa->polys->vbo_first_vert + i;
-		}
+		batch_heads[bucket] = batch_numranges;
+		batch_buckets[batch_numbuckets++] = bucket;
 	}
 
-	batch_numindices += numindices;
+	batch_tails[bucket] = batch_numranges;
+}
+
+void GL3_SurfBatch_Add(msurface_t* fa)
+{
+	AddToBucket(fa, 0);
 }
 
 void GL3_SurfBatch_DrawSingle(msurface_t* fa)
@@ -89,12 +148,12 @@ void GL3_SurfBatch_RenderWorldPoly(entity_t *currententity, gl3image_t* image, m
 {
 	c_brush_polys++;
 
-	if ((gl3state.renderPass == RENDER_PASS_SCENE) && !(fa->flags & SURF_DRAWTURB) && fa->lightmaptexturenum != batch_lmtexnum)
+	if ((gl3state.renderPass == RENDER_PASS_SCENE) && !(fa->flags & SURF_DRAWTURB))
 	{
-		GL3_SurfBatch_Flush();
-		batch_lmtexnum = fa->lightmaptexturenum;
-		GL3_BindLightmap(fa->lightmaptexturenum);
+		AddToBucket(fa, fa->lightmaptexturenum + 1);
+	}
+	else
+	{
+		GL3_SurfBatch_Add(fa);
 	}
-
-	GL3_SurfBatch_Add(fa);
 }
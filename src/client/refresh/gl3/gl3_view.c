@@ -347,3 +347,312 @@ hmm_mat4 GL3_Perspective2(GLdouble fovy, GLdouble aspect, GLdouble zoom, GLdoubl
 	}};
 	return ret;
 }
+
+/*
+ * The visible surface cache. The surfaces that can be seen from the
+ * view clusters only change with the clusters and the areabits, so
+ * they're collected once, together with the bounds of the visible
+ * leafs. A frame then only frustum culls the flat leaf bounds and
+ * doesn't have to walk the BSP tree.
+ */
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 1))
+#define GL3_VISCACHE_SSE
+#include <xmmintrin.h>
+#endif
+
+typedef struct
+{
+	gl3model_t *model;
+	int cluster, cluster2;
+	qboolean novis;
+	qboolean allareas;
+	byte areabits[MAX_MAP_AREAS / 8];
+
+	int numleafs; // padded to a multiple of 4 in the bounds
+	mleaf_t **leafs;
+	float *bounds[6]; // mins x, y, z, maxs x, y, z of each leaf
+	byte *leafvisible;
+
+	int numsurfaces;
+	msurface_t **surfaces;
+	byte *surfadded;
+} gl3viscache_t;
+
+static gl3viscache_t viscache;
+
+int c_viscache_rebuilds;
+
+void GL3_VisCache_Invalidate(void)
+{
+	free(viscache.leafs);
+	free(viscache.bounds[0]);
+	free(viscache.leafvisible);
+	free(viscache.surfaces);
+	free(viscache.surfadded);
+
+	memset(&viscache, 0, sizeof(viscache));
+}
+
+static qboolean VisCache_IsCurrent(void)
+{
+	if (viscache.model != gl3_worldmodel)
+	{
+		return false;
+	}
+
+	// like GL3_MarkLeaves(), keep the old set
+	if (r_lockpvs->value)
+	{
+		return true;
+	}
+
+	if ((viscache.cluster != gl3_viewcluster) ||
+		(viscache.cluster2 != gl3_viewcluster2) ||
+		(viscache.novis != (r_novis->value != 0)))
+	{
+		return false;
+	}
+
+	if (!gl3_newrefdef.areabits)
+	{
+		return viscache.allareas;
+	}
+
+	return !viscache.allareas &&
+		!memcmp(viscache.areabits, gl3_newrefdef.areabits, sizeof(viscache.areabits));
+}
+
+static void VisCache_Alloc(void)
+{
+	int numleafs = (gl3_worldmodel->numleafs + 3) & ~3;
+
+	GL3_VisCache_Invalidate();
+
+	viscache.model = gl3_worldmodel;
+	viscache.leafs = malloc(numleafs * sizeof(mleaf_t *));
+	viscache.bounds[0] = malloc(6 * numleafs * sizeof(float));
+	viscache.leafvisible = malloc(numleafs);
+	viscache.surfaces = malloc(gl3_worldmodel->numsurfaces * sizeof(msurface_t *));
+	viscache.surfadded = malloc(gl3_worldmodel->numsurfaces);
+
+	if (!viscache.leafs || !viscache.bounds[0] || !viscache.leafvisible ||
+		!viscache.surfaces || !viscache.surfadded)
+	{
+		ri.Sys_Error(ERR_FATAL, "%s: can't allocate the visible surface cache", __func__);
+	}
+
+	for (int i = 1; i < 6; i++)
+	{
+		viscache.bounds[i] = viscache.bounds[0] + i * numleafs;
+	}
+}
+
+static void VisCache_Build(void)
+{
+	const byte *vis;
+	YQ2_ALIGNAS_TYPE(int) byte fatvis[MAX_MAP_LEAFS / 8];
+	qboolean allclusters;
+	mleaf_t *leaf;
+	int i, j, c;
+
+	if (viscache.model != gl3_worldmodel)
+	{
+		VisCache_Alloc();
+	}
+
+	c_viscache_rebuilds++;
+
+	viscache.cluster = gl3_viewcluster;
+	viscache.cluster2 = gl3_viewcluster2;
+	viscache.novis = (r_novis->value != 0);
+	viscache.allareas = (gl3_newrefdef.areabits == NULL);
+
+	if (!viscache.allareas)
+	{
+		memcpy(viscache.areabits, gl3_newrefdef.areabits, sizeof(viscache.areabits));
+	}
+
+	allclusters = r_novis->value || (gl3_viewcluster == -1) || !gl3_worldmodel->vis;
+	vis = NULL;
+
+	if (!allclusters)
+	{
+		vis = GL3_Mod_ClusterPVS(gl3_viewcluster, gl3_worldmodel);
+
+		/* may have to combine two clusters because of solid water boundaries */
+		if (gl3_viewcluster2 != gl3_viewcluster)
+		{
+			memcpy(fatvis, vis, (gl3_worldmodel->numleafs + 7) / 8);
+			vis = GL3_Mod_ClusterPVS(gl3_viewcluster2, gl3_worldmodel);
+			c = (gl3_worldmodel->numleafs + 31) / 32;
+
+			for (i = 0; i < c; i++)
+			{
+				((int *)fatvis)[i] |= ((int *)vis)[i];
+			}
+
+			vis = fatvis;
+		}
+	}
+
+	memset(viscache.surfadded, 0, gl3_worldmodel->numsurfaces);
+	viscache.numleafs = 0;
+	viscache.numsurfaces = 0;
+
+	for (i = 0, leaf = gl3_worldmodel->leafs; i < gl3_worldmodel->numleafs; i++, leaf++)
+	{
+		if ((leaf->contents == CONTENTS_SOLID) || !leaf->nummarksurfaces)
+		{
+			continue;
+		}
+
+		if (!allclusters)
+		{
+			if ((leaf->cluster == -1) || !(vis[leaf->cluster >> 3] & (1 << (leaf->cluster & 7))))
+			{
+				continue;
+			}
+		}
+
+		/* check for door connected areas */
+		if (gl3_newrefdef.areabits)
+		{
+			if (!(gl3_newrefdef.areabits[leaf->area >> 3] & (1 << (leaf->area & 7))))
+			{
+				continue;
+			}
+		}
+
+		for (j = 0; j < 6; j++)
+		{
+			viscache.bounds[j][viscache.numleafs] = leaf->minmaxs[j];
+		}
+
+		viscache.leafs[viscache.numleafs++] = leaf;
+
+		for (j = 0; j < leaf->nummarksurfaces; j++)
+		{
+			msurface_t *surf = leaf->firstmarksurface[j];
+			int surfnum = surf - gl3_worldmodel->surfaces;
+
+			if (!viscache.surfadded[surfnum])
+			{
+				viscache.surfadded[surfnum] = 1;
+				viscache.surfaces[viscache.numsurfaces++] = surf;
+			}
+		}
+	}
+
+	/* the padding is culled with the rest, but never looked at */
+	for (i = viscache.numleafs; i & 3; i++)
+	{
+		for (j = 0; j < 6; j++)
+		{
+			viscache.bounds[j][i] = 0;
+		}
+	}
+}
+
+/*
+ * The same test as GL3_CullBox(), a box is visible if the corner
+ * furthest along the normal is in front of all four planes.
+ */
+static void VisCache_CullLeafs(void)
+{
+	const float *corner[4][3];
+	float normal[4][3], dist[4];
+	int numleafs = (viscache.numleafs + 3) & ~3;
+	int i, p;
+
+	if (!gl_cull->value)
+	{
+		memset(viscache.leafvisible, 1, numleafs);
+		return;
+	}
+
+	for (p = 0; p < 4; p++)
+	{
+		const cplane_t *plane = &gl3state.viewParams.frustum[p];
+
+		for (i = 0; i < 3; i++)
+		{
+			normal[p][i] = plane->normal[i];
+			corner[p][i] = viscache.bounds[(plane->normal[i] < 0) ? i : i + 3];
+		}
+
+		dist[p] = plane->dist;
+	}
+
+#ifdef GL3_VISCACHE_SSE
+	for (i = 0; i < numleafs; i += 4)
+	{
+		__m128 inside = _mm_cmpeq_ps(_mm_setzero_ps(), _mm_setzero_ps());
+		int mask;
+
+		for (p = 0; p < 4; p++)
+		{
+			__m128 d = _mm_mul_ps(_mm_set1_ps(normal[p][0]), _mm_loadu_ps(corner[p][0] + i));
+			d = _mm_add_ps(d, _mm_mul_ps(_mm_set1_ps(normal[p][1]), _mm_loadu_ps(corner[p][1] + i)));
+			d = _mm_add_ps(d, _mm_mul_ps(_mm_set1_ps(normal[p][2]), _mm_loadu_ps(corner[p][2] + i)));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(d, _mm_set1_ps(dist[p])));
+		}
+
+		mask = _mm_movemask_ps(inside);
+
+		viscache.leafvisible[i] = mask & 1;
+		viscache.leafvisible[i + 1] = (mask >> 1) & 1;
+		viscache.leafvisible[i + 2] = (mask >> 2) & 1;
+		viscache.leafvisible[i + 3] = (mask >> 3) & 1;
+	}
+#else
+	for (i = 0; i < numleafs; i++)
+	{
+		byte inside = 1;
+
+		for (p = 0; p < 4; p++)
+		{
+			float d = normal[p][0] * corner[p][0][i] +
+				normal[p][1] * corner[p][1][i] +
+				normal[p][2] * corner[p][2][i];
+
+			inside &= (d >= dist[p]);
+		}
+
+		viscache.leafvisible[i] = inside;
+	}
+#endif
+}
+
+/*
+ * Marks the surfaces of all leafs in the view with gl3_framecount,
+ * like GL3_RecursiveWorldNode() does, and returns the surfaces that
+ * can be marked. The caller still has to check visframe and the side.
+ */
+msurface_t **GL3_VisCache_MarkSurfaces(int *numsurfaces)
+{
+	if (!VisCache_IsCurrent())
+	{
+		VisCache_Build();
+	}
+
+	VisCache_CullLeafs();
+
+	for (int i = 0; i < viscache.numleafs; i++)
+	{
+		if (viscache.leafvisible[i])
+		{
+			mleaf_t *leaf = viscache.leafs[i];
+			msurface_t **mark = leaf->firstmarksurface;
+
+			for (int c = leaf->nummarksurfaces; c; c--, mark++)
+			{
+				(*mark)->visframe = gl3_framecount;
+			}
+		}
+	}
+
+	*numsurfaces = viscache.numsurfaces;
+
+	return viscache.surfaces;
+}
@@ -83,6 +83,7 @@ enum {
 	GL3_ATTRIB_STYLE1     = 7,
 	GL3_ATTRIB_STYLE2     = 8,
 	GL3_ATTRIB_STYLE3     = 9,
+	GL3_ATTRIB_ACCEL      = 10, // particle acceleration
 };
 
 enum {
@@ -134,6 +135,8 @@ typedef struct
 	GLuint shaderProgram;
 	GLint uniLmScales;
 	hmm_vec4 lmScales[4];
+	GLint uniAliasParams; // for the shaders interpolating MD2 frames
+	GLint uniParticleParams; // for the particles moved on the GPU
 } gl3ShaderInfo_t;
 
 typedef struct
@@ -216,6 +219,9 @@ enum {
 	GL3_SHADOW_DEBUG_COLOR_TU = GL_TEXTURE6,
 	GL3_FACE_SELECTION1_TU = GL_TEXTURE7,
 	GL3_FACE_SELECTION2_TU = GL_TEXTURE8,
+	GL3_ALIAS_FRAMES_TU = GL_TEXTURE9,
+	GL3_ALIAS_NORMALS_TU = GL_TEXTURE10,
+	GL3_ALIAS_SHADEDOTS_TU = GL_TEXTURE11,
 	GL3_SSAO_MAP_TU = GL_TEXTURE15,
 };
 
@@ -312,9 +318,16 @@ typedef struct
 	gl3ShaderInfo_t si3Dalias;      // for models
 	gl3ShaderInfo_t si3DaliasColor; // for models w/ flat colors
 
+	// the same, but interpolating the frames on the GPU
+	gl3ShaderInfo_t si3DaliasLerp;
+	gl3ShaderInfo_t si3DaliasLerpColor;
+	gl3ShaderInfo_t siShadowMapAlias;
+	gl3ShaderInfo_t si3DSSAOAlias;
+
 	gl3ShaderInfo_t si3DSSAO;
 
 	gl3ShaderInfo_t siParticle; // for particles. surprising, right?
+	gl3ShaderInfo_t siParticleKept; // for particles moved in the vertex shader
 
 	gl3ShaderInfo_t siPostfxResolveMultisample;
 	gl3ShaderInfo_t siPostfxResolveHDR;
@@ -334,12 +347,17 @@ typedef struct
 	gl3ShaderInfo_t siSentinel;
 
 	GLuint vao3D, vbo3D; // for brushes etc, using 10 floats and one uint as vertex input (x,y,z, s,t, lms,lmt, normX,normY,normZ ; lightFlags)
-	GLuint vaoWorld, vboWorld; // for static world geometry
+	GLuint vaoWorld, vboWorld, eboWorld; // for static world geometry
 
 	struct gl3_3D_vtx_s* world_vertices;
 	unsigned int num_world_vertices;
 	unsigned int cap_world_vertices;
 
+	// triangle fans of all world polys, built once per map
+	unsigned int* world_indices;
+	unsigned int num_world_indices;
+	unsigned int cap_world_indices;
+
 	int lightmap_step;
 
 	qboolean postfx_initialized;
@@ -349,7 +367,10 @@ typedef struct
 	int vbo3DcurOffset;
 
 	GLuint vaoAlias, vboAlias, eboAlias; // for models, using 9 floats as (x,y,z, s,t, r,g,b,a)
+	GLuint aliasNormalsBuf, aliasNormalsTex; // lookup tables for the GPU frame interpolation
+	GLuint aliasShadedotsBuf, aliasShadedotsTex;
 	GLuint vaoParticle, vboParticle; // for particles, using 9 floats (x,y,z, size,distance, r,g,b,a)
+	GLuint vaoParticleRing, vboParticleRing; // ring buffer of gl3_particle_vtx_t, see GL3_DrawKeptParticles()
 
 	// UBOs and their data
 	gl3UniCommon_t uniCommonData;
@@ -383,6 +404,9 @@ extern int gl3_framecount; /* used for dlight push checking */
 extern int gl3_viewcluster, gl3_viewcluster2, gl3_oldviewcluster, gl3_oldviewcluster2;
 
 extern int c_brush_polys, c_alias_polys;
+extern int c_world_drawcalls;
+extern int c_viscache_rebuilds;
+extern double c_world_walktime;
 
 /* NOTE: struct image_s* is what re.RegisterSkin() etc return so no gl3image_s!
  *       (I think the client only passes the pointer around and doesn't know the
@@ -529,6 +553,8 @@ extern void GL3_BufferAndDraw3D(const gl3_3D_vtx_t* verts, int numVerts, GLenum
 
 // Returns true if the box is completely outside the view frustum
 extern qboolean GL3_CullBox(const vec3_t mins, const vec3_t maxs);
+extern void GL3_VisCache_Invalidate(void);
+extern msurface_t **GL3_VisCache_MarkSurfaces(int *numsurfaces);
 
 // Returns true if the sphere is completely outside the view frustum
 extern qboolean GL3_CullSphere(const vec3_t pos, float radius);
@@ -662,6 +688,7 @@ extern void GL3_AddSkySurface(msurface_t *fa);
 
 // gl3_surf.c
 extern void GL3_SurfInit(void);
+extern void GL3_ClearKeptParticles(void);
 extern void GL3_SurfShutdown(void);
 extern void GL3_DrawGLPoly(msurface_t *fa);
 extern void GL3_DrawGLFlowingPoly(msurface_t *fa);
@@ -673,6 +700,7 @@ extern void GL3_DrawWorld(void);
 extern void GL3_MarkLeaves(void);
 extern void GL3_SetupViewCluster(void);
 extern void GL3_RecursiveWorldNode(entity_t* ent, mnode_t* node, const vec3_t modelorg);
+extern void GL3_AddWorldSurfaces(entity_t* currententity, const vec3_t modelorg);
 extern void GL3_DrawTextureChains(entity_t* ent);
 extern void GL3_DrawTextureChainsShadowPass(entity_t *currententity);
 
@@ -688,8 +716,12 @@ extern void GL3_SurfBatch_RenderWorldPoly(entity_t *currententity, gl3image_t* i
 extern void GL3_DrawAliasModel(entity_t *e);
 extern void GL3_ResetShadowAliasModels(void);
 extern void GL3_DrawAliasShadows(void);
+extern void GL3_InitMeshes(void);
 extern void GL3_ShutdownMeshes(void);
 
+// gl3_md2.c
+extern void GL3_FreeMD2(gl3model_t *mod);
+
 // gl3_shaders.c
 
 extern qboolean GL3_RecreateShaders(void);
@@ -761,6 +793,10 @@ extern cvar_t *r_lightlevel;
 extern cvar_t *gl3_overbrightbits;
 extern cvar_t *gl3_particle_fade_factor;
 extern cvar_t *gl3_particle_square;
+extern cvar_t *gl3_multidraw;
+extern cvar_t *gl3_viscache;
+extern cvar_t *gl3_gpulerp;
+extern cvar_t *gl3_gpuparticles;
 
 extern cvar_t *r_modulate;
 extern cvar_t *gl_lightmap;
@@ -64,6 +64,16 @@ typedef struct gl3_alias_vtx_s {
 	GLfloat normal[3];
 } gl3_alias_vtx_t;
 
+// used for the particles kept on the GPU, see GL3_DrawKeptParticles()
+typedef struct gl3_particle_vtx_s {
+	GLfloat origin[3];
+	GLfloat vel[3];
+	GLfloat accel[3];
+	GLfloat color[4]; // alpha is the alpha at spawn time
+	GLfloat alphavel;
+	GLfloat time; // spawn time in seconds, relative to the ring's base time
+} gl3_particle_vtx_t;
+
 /* in memory representation */
 typedef struct
 {
@@ -122,6 +132,8 @@ typedef struct msurface_s
 	int dlight_s, dlight_t;         /* gl lightmap coordinates for dynamic lightmaps */
 
 	glpoly_t *polys;                /* multiple if warped */
+	unsigned int ebo_first_index;   /* triangles of all polys in the world EBO */
+	unsigned int ebo_num_indices;
 	struct msurface_s *texturechain;
 
 	mtexinfo_t *texinfo;
@@ -241,6 +253,11 @@ typedef struct model_s
 	int extradatasize;
 	void *extradata;
 
+	/* alias models: all frames on the GPU, see GL3_LoadMD2() */
+	GLuint aliasVAO, aliasVBO, aliasEBO;
+	GLuint aliasFramesBuf, aliasFramesTex;
+	int aliasNumIndices;
+
 	// submodules
 	vec3_t		origin;	// for sounds or lights
 
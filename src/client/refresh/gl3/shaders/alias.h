@@ -77,4 +77,103 @@ static const char* fragmentSrcAliasColor = MULTILINE_STRING(
 			//outColor.rgb = pow(outColor.rgb, vec3(gamma));
 			outColor.a = texel.a; // I think alpha shouldn't be modified by gamma and intensity
 		}
-);
\ No newline at end of file
+);
+// MD2 frame interpolation in the vertex shader, see DrawAliasFrameLerpGPU().
+// lightFlags holds the index of the vertex in the frames.
+#define ALIAS_LERP_COMMON MULTILINE_STRING( \
+		uniform usamplerBuffer aliasFrames; /* x, y, z, normal index of each vertex of each frame */ \
+		uniform samplerBuffer aliasNormals; \
+		uniform samplerBuffer aliasShadedots; \
+		\
+		/* [0] move, shell scale; [1] frontv, frame offset; [2] backv, oldframe offset; \
+		   [3] shadelight, alpha; [4] shadedots offset, 1 for flat colors */ \
+		uniform vec4 aliasParams[5]; \
+		\
+		vec3 aliasNormal; \
+		float aliasShade; \
+		\
+		vec3 AliasLerpPosition() \
+		{ \
+			int index = int(lightFlags); \
+			uvec4 v = texelFetch(aliasFrames, int(aliasParams[1].w) + index); \
+			uvec4 ov = texelFetch(aliasFrames, int(aliasParams[2].w) + index); \
+			\
+			aliasNormal = texelFetch(aliasNormals, int(v.w)).xyz; \
+			aliasShade = texelFetch(aliasShadedots, int(aliasParams[4].x) + int(v.w)).r; \
+			\
+			return aliasParams[0].xyz + vec3(ov.xyz) * aliasParams[2].xyz + \
+				vec3(v.xyz) * aliasParams[1].xyz + aliasNormal * aliasParams[0].w; \
+		} \
+		\
+		vec4 AliasColor() \
+		{ \
+			float l = mix(aliasShade, 1.0, aliasParams[4].y); \
+			return vec4(aliasParams[3].rgb * l, aliasParams[3].a); \
+		} \
+)
+
+static const char* vertexSrcAliasLerp = ALIAS_LERP_COMMON MULTILINE_STRING(
+
+		// it gets attributes and uniforms from vertexCommon3D
+
+		out vec3 passWorldCoord;
+		out vec3 passNormal;
+
+		out vec4 passColor;
+
+		void main()
+		{
+			vec3 pos = AliasLerpPosition();
+			vec4 worldCoord = transModel * vec4(pos, 1.0);
+			vec4 worldNormal = transModel * vec4(aliasNormal, 0.0f);
+
+			passColor = AliasColor()*overbrightbits;
+			passTexCoord = texCoord;
+			passWorldCoord = worldCoord.xyz;
+			passNormal = normalize(worldNormal.xyz);
+
+			gl_Position = transProj * transView * worldCoord;
+
+			passFogCoord = gl_Position.w;
+		}
+);
+
+static const char* vertexSrcShadowMapAlias = ALIAS_LERP_COMMON MULTILINE_STRING(
+
+		out vec3 passWorldCoord;
+		out vec3 passNormal;
+
+		void main()
+		{
+			passTexCoord = texCoord;
+			vec4 worldCoord = transModel * vec4(AliasLerpPosition(), 1.0);
+			passWorldCoord = worldCoord.xyz;
+			vec4 worldNormal = transModel * vec4(aliasNormal, 0.0f);
+			passNormal = normalize(worldNormal.xyz);
+
+			gl_Position = transProj * transView * worldCoord;
+
+			passFogCoord = gl_Position.w;
+		}
+);
+
+static const char* vertexSrc3DSSAOAlias = ALIAS_LERP_COMMON MULTILINE_STRING(
+
+		out vec3 passViewCoord;
+		out vec3 passNormal;
+
+		void main()
+		{
+			passTexCoord = texCoord;
+
+			vec4 worldCoord = transModel * vec4(AliasLerpPosition(), 1.0);
+			passViewCoord = (transView * worldCoord).xyz;
+
+			vec4 viewNormal = transView * transModel * vec4(aliasNormal, 0.0f);
+			passNormal = normalize(viewNormal.xyz);
+
+			gl_Position = transProj * transView * worldCoord;
+
+			passFogCoord = gl_Position.w;
+		}
+);
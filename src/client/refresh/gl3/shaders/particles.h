@@ -17,6 +17,42 @@ static const char* vertexSrcParticles = MULTILINE_STRING(
 		}
 );
 
+static const char* vertexSrcParticlesKept = MULTILINE_STRING(
+
+		// it gets attributes and uniforms from vertexCommon3D
+
+		// position, normal and accel are the origin, velocity and acceleration,
+		// texCoord is (alphavel, spawn time), vertColor.a the alpha at spawn time
+		in vec3 accel; // GL3_ATTRIB_ACCEL
+
+		// [0] is (view origin, particle time), [1].x the point size,
+		// [1].y the lifetime of particles that don't fade out
+		uniform vec4 particleParams[2];
+
+		out vec4 passColor;
+
+		void main()
+		{
+			float t = particleParams[0].w - texCoord.y;
+			vec3 org = position + normal*t + accel*(t*t);
+			float a = vertColor.a + texCoord.x*t;
+
+			passColor = vec4(vertColor.rgb, min(a, 1.0));
+			gl_Position = transProj * transView * transModel * vec4(org, 1.0);
+			passFogCoord = gl_Position.w;
+
+			float pointDist = distance(particleParams[0].xyz, org)*0.1; // like in vertexSrcParticles
+
+			gl_PointSize = particleParams[1].x/pointDist;
+
+			if(a <= 0.0 || (texCoord.x >= 0.0 && t > particleParams[1].y))
+			{
+				// faded out, move it out of the clip volume
+				gl_Position = vec4(0.0, 0.0, -2.0, 1.0);
+			}
+		}
+);
+
 static const char* fragmentSrcParticles = MULTILINE_STRING(
 
 		// it gets attributes and uniforms from fragmentCommon3D
@@ -262,6 +262,8 @@ typedef struct surfcache_s
 	unsigned		height; // DEBUG only needed for debug
 	float			mipscale;
 	image_t			*image;
+	int			pinframe; // still read by the threaded span drawing
+	int			lastframe; // r_framecount of the last use
 	byte			data[4]; // width*height elements
 } surfcache_t;
 
@@ -354,9 +356,17 @@ extern pixel_t		*r_warpbuffer;
 
 extern float		scale_for_mip;
 
-extern float	d_sdivzstepu, d_tdivzstepu;
-extern float	d_sdivzstepv, d_tdivzstepv;
-extern float	d_sdivzorigin, d_tdivzorigin;
+// the span drawing state is per thread, the world can be
+// drawn in several screen bands at once (see sw_threads)
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+extern THREAD_LOCAL float	d_sdivzstepu, d_tdivzstepu;
+extern THREAD_LOCAL float	d_sdivzstepv, d_tdivzstepv;
+extern THREAD_LOCAL float	d_sdivzorigin, d_tdivzorigin;
 
 void D_DrawSpansPow2(espan_t *pspan, float d_ziorigin, float d_zistepu, float d_zistepv);
 void D_DrawZSpans(espan_t *pspan, float d_ziorigin, float d_zistepu, float d_zistepv);
@@ -364,6 +374,13 @@ void TurbulentPow2(espan_t *pspan, float d_ziorigin, float d_zistepu, float d_zi
 void NonTurbulentPow2(espan_t *pspan, float d_ziorigin, float d_zistepu, float d_zistepv);
 
 surfcache_t *D_CacheSurface(const entity_t *currententity, msurface_t *surface, int miplevel);
+surfcache_t *D_CacheSurfaceDeferred(const entity_t *currententity, msurface_t *surface, int miplevel);
+void D_BuildSurfaces(void);
+void D_ShutdownBuildSurfaces(void);
+
+extern int	d_spanpinframe;
+void D_FlushSpanSurfaces(void);
+void D_ShutdownSpanSurfaces(void);
 
 extern int	d_vrectx, d_vrecty, d_vrectright_particle, d_vrectbottom_particle;
 
@@ -381,8 +398,8 @@ extern int vid_buffer_width;
 
 //===================================================================
 
-extern int	cachewidth;
-extern pixel_t	*cacheblock;
+extern THREAD_LOCAL int	cachewidth;
+extern THREAD_LOCAL pixel_t	*cacheblock;
 
 extern int	r_drawnpolycount;
 
@@ -396,7 +413,10 @@ extern vec3_t	vright, base_vright;
 
 extern surf_t	*surfaces, *surface_p, *surf_max;
 // allow some very large lightmaps
-extern light_t	*blocklights, *blocklight_max;
+extern THREAD_LOCAL light_t	*blocklights, *blocklight_max;
+void R_AllocThreadBlockLights(int numthreads);
+void R_FreeThreadBlockLights(void);
+void R_BindBlockLights(int thread);
 
 // surfaces are generated in back to front order by the bsp, so if a surf
 // pointer is greater than another one, it should be drawn in front
@@ -424,6 +444,8 @@ extern cvar_t	*sw_stipplealpha;
 extern cvar_t	*sw_surfcacheoverride;
 extern cvar_t	*sw_waterwarp;
 extern cvar_t	*sw_gunzposition;
+extern cvar_t	*sw_threads;
+extern cvar_t	*sw_surfcachegrow;
 extern cvar_t	*r_retexturing;
 extern cvar_t	*r_scale8bittextures;
 
@@ -484,8 +506,8 @@ void R_RotateBmodel(const entity_t *currententity);
 extern int	c_faceclip;
 extern int	r_polycount;
 
-extern int	sadjust, tadjust;
-extern int	bbextents, bbextentt;
+extern THREAD_LOCAL int	sadjust, tadjust;
+extern THREAD_LOCAL int	bbextents, bbextentt;
 
 extern int	r_currentkey;
 
@@ -564,6 +586,10 @@ void R_NewMap (void);
 void Draw_InitLocal(void);
 void R_InitCaches(void);
 void D_FlushCaches(void);
+void R_CheckCacheSize(void);
+void R_SurfCacheInfo_f(void);
+
+extern int	c_surfhits, c_surfevictions;
 
 void	RE_BeginRegistration (char *model);
 struct model_s	*RE_RegisterModel (char *name);
@@ -595,9 +621,17 @@ void R_IMFlatShadedQuad( vec3_t a, vec3_t b, vec3_t c, vec3_t d, int color, floa
 // VID Buffer damage
 void VID_DamageBuffer(int u, int v);
 
+// sw_simd.c
+void R_InitSIMD(void);
+void R_ExpandPalette(unsigned *dst, const pixel_t *src, int count, const unsigned *palette);
+int R_BufferDiffStart(const pixel_t *back, const pixel_t *front, int vmin, int vmax);
+int R_BufferDiffEnd(const pixel_t *back, const pixel_t *front, int vmin, int vmax);
+void R_SIMDBench_f(void);
+
 // VID zBuffer damage
 extern qboolean	fastmoving;
 void VID_DamageZBuffer(int u, int v);
+void VID_WholeDamageZBuffer(void);
 qboolean VID_CheckDamageZBuffer(int u, int v, int ucount, int vcount);
 
 /*
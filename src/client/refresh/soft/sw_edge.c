@@ -758,11 +758,9 @@ Simple single color fill with no texture mapping
 ==============
 */
 static void
-D_FlatFillSurface (surf_t *surf, pixel_t color)
+D_FlatFillSurface (espan_t *span, pixel_t color)
 {
-	espan_t	*span;
-
-	for (span=surf->spans ; span ; span=span->pnext)
+	for ( ; span ; span=span->pnext)
 	{
 		pixel_t   *pdest;
 
@@ -830,6 +828,249 @@ D_CalcGradients (msurface_t *pface, float d_ziorigin, float d_zistepu, float d_z
 }
 
 
+/*
+===============================================================================
+
+SPAN SURFACES
+
+Everything the span drawers need from a surface is kept in a
+spansurf_t. Without sw_threads it's drawn right away. With it
+the surfaces are collected, the missing lit textures are built
+in parallel by D_BuildSurfaces, and then the screen is split
+into horizontal bands that are drawn in parallel on the
+engine's job threads. The surfaces don't overlap on screen,
+so the bands can't overlap either.
+
+===============================================================================
+*/
+
+typedef enum
+{
+	SPANS_SOLID,
+	SPANS_SKY,
+	SPANS_TURBULENT,
+	SPANS_FLOWING,
+	SPANS_BACKGROUND
+} spantype_t;
+
+typedef struct
+{
+	espan_t		*spans;
+	spantype_t	type;
+	float		d_ziorigin, d_zistepu, d_zistepv;
+
+	float		sdivzstepu, tdivzstepu;
+	float		sdivzstepv, tdivzstepv;
+	float		sdivzorigin, tdivzorigin;
+	int		sadjust, tadjust, bbextents, bbextentt;
+	pixel_t		*cacheblock;
+	int		cachewidth;
+	pixel_t		color;
+} spansurf_t;
+
+#define MAX_SPAN_BANDS		64
+#define BAND_SPANS_CHUNK	64
+
+static spansurf_t	*d_spansurfs;
+static int		d_numspansurfs;
+static int		d_maxspansurfs;
+static int		d_spanbands;
+
+// cache blocks stamped with this are in use by d_spansurfs
+int	d_spanpinframe;
+
+static void
+D_DrawSpanSurface (const spansurf_t *ss, espan_t *spans)
+{
+	d_sdivzstepu = ss->sdivzstepu;
+	d_tdivzstepu = ss->tdivzstepu;
+	d_sdivzstepv = ss->sdivzstepv;
+	d_tdivzstepv = ss->tdivzstepv;
+	d_sdivzorigin = ss->sdivzorigin;
+	d_tdivzorigin = ss->tdivzorigin;
+	sadjust = ss->sadjust;
+	tadjust = ss->tadjust;
+	bbextents = ss->bbextents;
+	bbextentt = ss->bbextentt;
+	cacheblock = ss->cacheblock;
+	cachewidth = ss->cachewidth;
+
+	switch (ss->type)
+	{
+		case SPANS_SOLID:
+		case SPANS_SKY:
+			D_DrawSpansPow2 (spans, ss->d_ziorigin, ss->d_zistepu, ss->d_zistepv);
+			break;
+		case SPANS_TURBULENT:
+			TurbulentPow2 (spans, ss->d_ziorigin, ss->d_zistepu, ss->d_zistepv);
+			break;
+		case SPANS_FLOWING:
+			NonTurbulentPow2 (spans, ss->d_ziorigin, ss->d_zistepu, ss->d_zistepv);
+			break;
+		case SPANS_BACKGROUND:
+			D_FlatFillSurface (spans, ss->color);
+			break;
+	}
+
+	if (ss->type == SPANS_SKY || ss->type == SPANS_BACKGROUND)
+	{
+		// set up a gradient for the background surface that places it
+		// effectively at infinity distance from the viewpoint
+		D_DrawZSpans (spans, -0.9, 0, 0);
+	}
+	else
+	{
+		D_DrawZSpans (spans, ss->d_ziorigin, ss->d_zistepu, ss->d_zistepv);
+	}
+}
+
+/*
+==============
+D_EmitSpanSurface
+
+Takes the current span drawing state for s, draws it
+directly or queues it for D_FlushSpanSurfaces
+==============
+*/
+static void
+D_EmitSpanSurface (surf_t *s, spantype_t type, pixel_t color)
+{
+	spansurf_t	direct;
+	spansurf_t	*ss;
+
+	if (d_spanbands)
+	{
+		if (d_numspansurfs == d_maxspansurfs)
+		{
+			spansurf_t	*newsurfs;
+			int		newmax;
+
+			newmax = d_maxspansurfs ? d_maxspansurfs * 2 : 1024;
+			newsurfs = realloc (d_spansurfs, newmax * sizeof(spansurf_t));
+			if (!newsurfs)
+			{
+				ri.Sys_Error(ERR_FATAL, "%s: Couldn't allocate %d span surfaces",
+					__func__, newmax);
+				// code never returns after ERR_FATAL
+				return;
+			}
+
+			d_spansurfs = newsurfs;
+			d_maxspansurfs = newmax;
+		}
+
+		ss = &d_spansurfs[d_numspansurfs++];
+	}
+	else
+	{
+		ss = &direct;
+	}
+
+	ss->spans = s->spans;
+	ss->type = type;
+	ss->d_ziorigin = s->d_ziorigin;
+	ss->d_zistepu = s->d_zistepu;
+	ss->d_zistepv = s->d_zistepv;
+	ss->sdivzstepu = d_sdivzstepu;
+	ss->tdivzstepu = d_tdivzstepu;
+	ss->sdivzstepv = d_sdivzstepv;
+	ss->tdivzstepv = d_tdivzstepv;
+	ss->sdivzorigin = d_sdivzorigin;
+	ss->tdivzorigin = d_tdivzorigin;
+	ss->sadjust = sadjust;
+	ss->tadjust = tadjust;
+	ss->bbextents = bbextents;
+	ss->bbextentt = bbextentt;
+	ss->cacheblock = cacheblock;
+	ss->cachewidth = cachewidth;
+	ss->color = color;
+
+	if (!d_spanbands)
+	{
+		D_DrawSpanSurface (ss, ss->spans);
+	}
+}
+
+static void
+D_DrawSpanBand (void *data, int band, int thread)
+{
+	espan_t	bandspans[BAND_SPANS_CHUNK];
+	int	vmin, vmax;
+	int	i;
+
+	vmin = vid_buffer_height * band / d_spanbands;
+	vmax = vid_buffer_height * (band + 1) / d_spanbands;
+
+	for (i = 0; i < d_numspansurfs; i++)
+	{
+		const spansurf_t	*ss;
+		espan_t			*span;
+		int			count;
+
+		ss = &d_spansurfs[i];
+		count = 0;
+
+		for (span = ss->spans; span; span = span->pnext)
+		{
+			if (span->v < vmin || span->v >= vmax)
+				continue;
+
+			bandspans[count] = *span;
+			bandspans[count].pnext = NULL;
+			if (count)
+				bandspans[count - 1].pnext = &bandspans[count];
+
+			if (++count == BAND_SPANS_CHUNK)
+			{
+				D_DrawSpanSurface (ss, bandspans);
+				count = 0;
+			}
+		}
+
+		if (count)
+			D_DrawSpanSurface (ss, bandspans);
+	}
+}
+
+/*
+==============
+D_FlushSpanSurfaces
+
+Builds the lit textures of all queued surfaces in parallel,
+then draws them in parallel bands
+==============
+*/
+void
+D_FlushSpanSurfaces (void)
+{
+	// the lit textures of the queued surfaces
+	D_BuildSurfaces ();
+
+	if (!d_numspansurfs)
+		return;
+
+	// the z damage tracking isn't thread safe. with the
+	// whole screen damaged it's only read, not written.
+	VID_WholeDamageZBuffer ();
+
+	ri.Jobs_Run (D_DrawSpanBand, NULL, d_spanbands);
+
+	d_numspansurfs = 0;
+
+	// the queued cache blocks may be reused now
+	if (++d_spanpinframe <= 0)
+		d_spanpinframe = 1;
+}
+
+void
+D_ShutdownSpanSurfaces (void)
+{
+	free (d_spansurfs);
+	d_spansurfs = NULL;
+	d_numspansurfs = 0;
+	d_maxspansurfs = 0;
+}
+
 /*
 ==============
 D_BackgroundSurf
@@ -840,10 +1081,7 @@ The grey background filler seen when there is a hole in the map
 static void
 D_BackgroundSurf (surf_t *s)
 {
-	D_FlatFillSurface (s, (int)sw_clearcolor->value & 0xFF);
-	// set up a gradient for the background surface that places it
-	// effectively at infinity distance from the viewpoint
-	D_DrawZSpans (s->spans, -0.9, 0, 0);
+	D_EmitSpanSurface (s, SPANS_BACKGROUND, (int)sw_clearcolor->value & 0xFF);
 }
 
 /*
@@ -880,13 +1118,11 @@ D_TurbulentSurf(surf_t *s)
 	//============
 	// textures that aren't warping are just flowing. Use NonTurbulentPow2 instead
 	if(!(pface->texinfo->flags & SURF_WARP))
-		NonTurbulentPow2 (s->spans, s->d_ziorigin, s->d_zistepu, s->d_zistepv);
+		D_EmitSpanSurface (s, SPANS_FLOWING, 0);
 	else
-		TurbulentPow2 (s->spans, s->d_ziorigin, s->d_zistepu, s->d_zistepv);
+		D_EmitSpanSurface (s, SPANS_TURBULENT, 0);
 	//============
 
-	D_DrawZSpans (s->spans, s->d_ziorigin, s->d_zistepu, s->d_zistepv);
-
 	if (s->insubmodel)
 	{
 		//
@@ -920,11 +1156,7 @@ D_SkySurf (surf_t *s)
 
 	D_CalcGradients (pface, s->d_ziorigin, s->d_zistepu, s->d_zistepv);
 
-	D_DrawSpansPow2 (s->spans, s->d_ziorigin, s->d_zistepu, s->d_zistepv);
-
-	// set up a gradient for the background surface that places it
-	// effectively at infinity distance from the viewpoint
-	D_DrawZSpans (s->spans, -0.9, 0, 0);
+	D_EmitSpanSurface (s, SPANS_SKY, 0);
 }
 
 /*
@@ -955,16 +1187,20 @@ D_SolidSurf (entity_t *currententity, surf_t *s)
 	miplevel = D_MipLevelForScale(s->nearzi * scale_for_mip * pface->texinfo->mipadjust);
 
 	// FIXME: make this passed in to D_CacheSurface
-	pcurrentcache = D_CacheSurface (currententity, pface, miplevel);
+	if (d_spanbands)
+		pcurrentcache = D_CacheSurfaceDeferred (currententity, pface, miplevel);
+	else
+		pcurrentcache = D_CacheSurface (currententity, pface, miplevel);
 
 	cacheblock = (pixel_t *)pcurrentcache->data;
 	cachewidth = pcurrentcache->width;
 
 	D_CalcGradients (pface, s->d_ziorigin, s->d_zistepu, s->d_zistepv);
 
-	D_DrawSpansPow2 (s->spans, s->d_ziorigin, s->d_zistepu, s->d_zistepv);
+	// keep the cache block until the queued spans are drawn
+	pcurrentcache->pinframe = d_spanpinframe;
 
-	D_DrawZSpans (s->spans, s->d_ziorigin, s->d_zistepu, s->d_zistepv);
+	D_EmitSpanSurface (s, SPANS_SOLID, 0);
 
 	if (s->insubmodel)
 	{
@@ -1002,7 +1238,7 @@ D_DrawflatSurfaces (surf_t *surface)
 
 		// make a stable color for each surface by taking the low
 		// bits of the msurface pointer
-		D_FlatFillSurface (s, color & 0xFF);
+		D_FlatFillSurface (s->spans, color & 0xFF);
 		D_DrawZSpans (s->spans, s->d_ziorigin, s->d_zistepu, s->d_zistepv);
 
 		color ++;
@@ -1028,6 +1264,20 @@ D_DrawSurfaces (entity_t *currententity, surf_t *surface)
 	{
 		surf_t *s;
 
+		// the world is drawn in sw_threads bands
+		d_spanbands = (int)sw_threads->value;
+		if (d_spanbands > MAX_SPAN_BANDS)
+			d_spanbands = MAX_SPAN_BANDS;
+		if (d_spanbands > vid_buffer_height)
+			d_spanbands = vid_buffer_height;
+		if ((d_spanbands < 2) || (ri.Jobs_NumThreads() < 2))
+			d_spanbands = 0;
+
+		if (d_spanbands && !d_spanpinframe)
+			d_spanpinframe = 1;
+		else if (!d_spanbands)
+			d_spanpinframe = 0;
+
 		for (s = &surfaces[1] ; s<surface ; s++)
 		{
 			if (!s->spans)
@@ -1044,6 +1294,8 @@ D_DrawSurfaces (entity_t *currententity, surf_t *surface)
 			else if (s->flags & SURF_DRAWTURB)
 				D_TurbulentSurf (s);
 		}
+
+		D_FlushSpanSurfaces ();
 	}
 	else
 		D_DrawflatSurfaces (surface);
@@ -262,7 +262,69 @@ R_LightPoint (const entity_t *currententity, vec3_t p, vec3_t color)
 //===================================================================
 
 
-light_t	*blocklights = NULL, *blocklight_max = NULL;
+// per thread, the main thread uses the buffer from R_ReallocateMapBuffers
+THREAD_LOCAL light_t	*blocklights = NULL, *blocklight_max = NULL;
+
+// buffers of the job threads, index 0 is unused
+static light_t	*r_threadlights[MAX_JOB_THREADS];
+static int	r_threadlightsize[MAX_JOB_THREADS];
+
+/*
+===============
+R_AllocThreadBlockLights
+
+Gives the job threads blocklights as large as the main threads.
+Called from the main thread.
+===============
+*/
+void
+R_AllocThreadBlockLights (int numthreads)
+{
+	int	i, size;
+
+	size = blocklight_max - blocklights;
+
+	for (i = 1; i < numthreads && i < MAX_JOB_THREADS; i++)
+	{
+		if (r_threadlightsize[i] == size)
+			continue;
+
+		free (r_threadlights[i]);
+		r_threadlights[i] = malloc (size * sizeof(light_t));
+		r_threadlightsize[i] = r_threadlights[i] ? size : 0;
+	}
+}
+
+void
+R_FreeThreadBlockLights (void)
+{
+	int	i;
+
+	for (i = 1; i < MAX_JOB_THREADS; i++)
+	{
+		free (r_threadlights[i]);
+		r_threadlights[i] = NULL;
+		r_threadlightsize[i] = 0;
+	}
+}
+
+/*
+===============
+R_BindBlockLights
+
+Selects the blocklights of a job thread
+===============
+*/
+void
+R_BindBlockLights (int thread)
+{
+	// the main thread has its own
+	if (!thread)
+		return;
+
+	blocklights = r_threadlights[thread];
+	blocklight_max = blocklights + r_threadlightsize[thread];
+}
 
 /*
 ===============
@@ -37,6 +37,13 @@ pixel_t		*vid_buffer = NULL;
 static pixel_t	*swap_buffers = NULL;
 static pixel_t	*swap_frames[2] = {NULL, NULL};
 static int	swap_current = 0;
+
+// 32 bit copy of the screen, only changed tiles are updated
+#define PRESENT_TILE_SIZE	64
+static Uint32	*present_pixels = NULL;
+static byte	*present_dirty = NULL;
+static int	present_tilesx, present_tilesy;
+static qboolean	present_full;	// present_pixels is outdated
 espan_t		*vid_polygon_spans = NULL;
 pixel_t		*vid_colormap = NULL;
 pixel_t		*vid_alphamap = NULL;
@@ -149,6 +156,8 @@ cvar_t	*sw_texture_filtering;
 cvar_t	*r_retexturing;
 cvar_t	*r_scale8bittextures;
 cvar_t	*sw_gunzposition;
+cvar_t	*sw_threads;
+cvar_t	*sw_surfcachegrow;
 static cvar_t	*sw_partialrefresh;
 
 cvar_t	*r_drawworld;
@@ -196,14 +205,14 @@ static cvar_t	*r_lockpvs;
 // FIXME: make into one big structure, like cl or sv
 // FIXME: do separately for refresh engine and driver
 
-float	d_sdivzstepu, d_tdivzstepu;
-float	d_sdivzstepv, d_tdivzstepv;
-float	d_sdivzorigin, d_tdivzorigin;
+THREAD_LOCAL float	d_sdivzstepu, d_tdivzstepu;
+THREAD_LOCAL float	d_sdivzstepv, d_tdivzstepv;
+THREAD_LOCAL float	d_sdivzorigin, d_tdivzorigin;
 
-int	sadjust, tadjust, bbextents, bbextentt;
+THREAD_LOCAL int	sadjust, tadjust, bbextents, bbextentt;
 
-pixel_t		*cacheblock;
-int		cachewidth;
+THREAD_LOCAL pixel_t	*cacheblock;
+THREAD_LOCAL int	cachewidth;
 pixel_t		*d_viewbuffer;
 zvalue_t	*d_pzbuffer;
 
@@ -280,7 +289,7 @@ VID_CheckDamageZBuffer(int u, int v, int ucount, int vcount)
 }
 
 // Need to recalculate whole z buffer
-static void
+void
 VID_WholeDamageZBuffer(void)
 {
 	vid_zminu = 0;
@@ -379,6 +388,8 @@ R_RegisterVariables (void)
 	r_retexturing = ri.Cvar_Get("r_retexturing", "1", CVAR_ARCHIVE);
 	r_scale8bittextures = ri.Cvar_Get("r_scale8bittextures", "0", CVAR_ARCHIVE);
 	sw_gunzposition = ri.Cvar_Get("sw_gunzposition", "8", CVAR_ARCHIVE);
+	sw_threads = ri.Cvar_Get("sw_threads", "0", CVAR_ARCHIVE);
+	sw_surfcachegrow = ri.Cvar_Get("sw_surfcachegrow", "10", CVAR_ARCHIVE);
 
 	// On MacOS texture is cleaned up after render and code have to copy a whole
 	// screen to texture, other platforms save previous texture content and can be
@@ -414,6 +425,8 @@ R_RegisterVariables (void)
 	ri.Cmd_AddCommand("modellist", Mod_Modellist_f);
 	ri.Cmd_AddCommand("screenshot", R_ScreenShot_f);
 	ri.Cmd_AddCommand("imagelist", R_ImageList_f);
+	ri.Cmd_AddCommand("sw_simdbench", R_SIMDBench_f);
+	ri.Cmd_AddCommand("sw_surfcacheinfo", R_SurfCacheInfo_f);
 
 	r_mode->modified = true; // force us to do mode specific stuff later
 	vid_gamma->modified = true; // force us to rebuild the gamma table later
@@ -428,6 +441,8 @@ R_UnRegister (void)
 	ri.Cmd_RemoveCommand( "screenshot" );
 	ri.Cmd_RemoveCommand( "modellist" );
 	ri.Cmd_RemoveCommand( "imagelist" );
+	ri.Cmd_RemoveCommand( "sw_simdbench" );
+	ri.Cmd_RemoveCommand( "sw_surfcacheinfo" );
 }
 
 static void RE_ShutdownContext(void);
@@ -444,6 +459,7 @@ static qboolean
 RE_Init(void)
 {
 	R_RegisterVariables ();
+	R_InitSIMD ();
 	R_InitImages ();
 	Mod_Init ();
 	Draw_InitLocal ();
@@ -501,6 +517,8 @@ RE_Shutdown (void)
 		free (sc_base);
 		sc_base = NULL;
 	}
+	D_ShutdownSpanSurfaces ();
+	D_ShutdownBuildSurfaces ();
 
 	// free colormap
 	if (vid_colormap)
@@ -1410,6 +1428,7 @@ RE_RenderFrame (refdef_t *fd)
 		R_PrintDSpeeds ();
 
 	R_ReallocateMapBuffers();
+	R_CheckCacheSize();
 }
 
 /*
@@ -1969,6 +1988,18 @@ RE_ShutdownContext(void)
 	swap_frames[0] = NULL;
 	swap_frames[1] = NULL;
 
+	if (present_pixels)
+	{
+		free(present_pixels);
+	}
+	present_pixels = NULL;
+
+	if (present_dirty)
+	{
+		free(present_dirty);
+	}
+	present_dirty = NULL;
+
 	if (sintable)
 	{
 		free(sintable);
@@ -2040,6 +2071,7 @@ RE_ShutdownContext(void)
 		free(blocklights);
 	}
 	blocklights = NULL;
+	R_FreeThreadBlockLights();
 
 	if(r_edges)
 	{
@@ -2086,25 +2118,11 @@ RE_CopyFrame (Uint32 * pixels, int pitch, int vmin, int vmax)
 	// no gaps between images rows
 	if (pitch == vid_buffer_width)
 	{
-		const Uint32	*max_pixels;
-		Uint32	*pixels_pos;
-		pixel_t	*buffer_pos;
-
-		max_pixels = pixels + vmax;
-		buffer_pos = vid_buffer + vmin;
-
-		pixels_pos = pixels + vmin;
-
-		while ( pixels_pos < max_pixels)
-		{
-			*pixels_pos = sdl_palette[*buffer_pos];
-			buffer_pos++;
-			pixels_pos++;
-		}
+		R_ExpandPalette (pixels + vmin, vid_buffer + vmin, vmax - vmin, sdl_palette);
 	}
 	else
 	{
-		int y,x, buffer_pos, ymin, ymax;
+		int y, buffer_pos, ymin, ymax;
 
 		ymin = vmin / vid_buffer_width;
 		ymax = vmax / vid_buffer_width;
@@ -2113,10 +2131,7 @@ RE_CopyFrame (Uint32 * pixels, int pitch, int vmin, int vmax)
 		pixels += ymin * pitch;
 		for (y=ymin; y < ymax;  y++)
 		{
-			for (x=0; x < vid_buffer_width; x ++)
-			{
-				pixels[x] = sdl_palette[vid_buffer[buffer_pos + x]];
-			}
+			R_ExpandPalette (pixels, vid_buffer + buffer_pos, vid_buffer_width, sdl_palette);
 			pixels += pitch;
 			buffer_pos += vid_buffer_width;
 		}
@@ -2126,34 +2141,13 @@ RE_CopyFrame (Uint32 * pixels, int pitch, int vmin, int vmax)
 static int
 RE_BufferDifferenceStart(int vmin, int vmax)
 {
-	int *front_buffer, *back_buffer, *back_max;
-
-	back_buffer = (int*)(swap_frames[0] + vmin);
-	front_buffer = (int*)(swap_frames[1] + vmin);
-	back_max = (int*)(swap_frames[0] + vmax);
-
-	while (back_buffer < back_max && *back_buffer == *front_buffer) {
-		back_buffer ++;
-		front_buffer ++;
-	}
-	return (pixel_t*)back_buffer - swap_frames[0];
+	return R_BufferDiffStart(swap_frames[0], swap_frames[1], vmin, vmax);
 }
 
 static int
 RE_BufferDifferenceEnd(int vmin, int vmax)
 {
-	int *front_buffer, *back_buffer, *back_min;
-
-	back_buffer = (int*)(swap_frames[0] + vmax);
-	front_buffer = (int*)(swap_frames[1] + vmax);
-	back_min = (int*)(swap_frames[0] + vmin);
-
-	do {
-		back_buffer --;
-		front_buffer --;
-	} while (back_buffer > back_min && *back_buffer == *front_buffer);
-	// +1 for fully cover changes
-	return (pixel_t*)back_buffer - swap_frames[0] + sizeof(int);
+	return R_BufferDiffEnd(swap_frames[0], swap_frames[1], vmin, vmax);
 }
 
 static void
@@ -2175,6 +2169,9 @@ RE_CleanFrame(void)
 	memset(pixels, 0, pitch * vid_buffer_height);
 	SDL_UnlockTexture(texture);
 
+	// the next tiled present must convert everything
+	present_full = true;
+
 	// All changes flushed
 	VID_NoDamageBuffer();
 }
@@ -2217,6 +2214,160 @@ RE_FlushFrame(int vmin, int vmax)
 
 	// All changes flushed
 	VID_NoDamageBuffer();
+
+	// present_pixels wasn't updated
+	present_full = true;
+}
+
+/*
+================
+RE_PresentTile
+
+Compares one tile of the damaged area with the last
+frame and converts it to present_pixels if it changed
+================
+*/
+static void
+RE_PresentTile(void *data, int tile, int thread)
+{
+	const pixel_t	*front_buffer;
+	int	umin, umax, vmin, vmax, v;
+	qboolean	dirty;
+
+	front_buffer = swap_frames[(swap_current + 1)&1];
+
+	umin = (tile % present_tilesx) * PRESENT_TILE_SIZE;
+	vmin = (tile / present_tilesx) * PRESENT_TILE_SIZE;
+	umax = umin + PRESENT_TILE_SIZE;
+	vmax = vmin + PRESENT_TILE_SIZE;
+
+	if (!present_full)
+	{
+		// the damage maximum is inclusive
+		umin = max(umin, vid_minu);
+		umax = min(umax, vid_maxu + 1);
+		vmin = max(vmin, vid_minv);
+		vmax = min(vmax, vid_maxv + 1);
+	}
+	umax = min(umax, vid_buffer_width);
+	vmax = min(vmax, vid_buffer_height);
+
+	dirty = present_full && (umin < umax);
+
+	for (v = vmin; !dirty && v < vmax && umin < umax; v++)
+	{
+		int	pos;
+
+		pos = v * vid_buffer_width;
+		if (memcmp(vid_buffer + pos + umin, front_buffer + pos + umin, umax - umin))
+		{
+			dirty = true;
+		}
+	}
+
+	present_dirty[tile] = dirty;
+
+	if (!dirty)
+	{
+		return;
+	}
+
+	for (v = vmin; v < vmax; v++)
+	{
+		int	pos;
+
+		pos = v * vid_buffer_width + umin;
+		R_ExpandPalette(present_pixels + pos, vid_buffer + pos, umax - umin,
+				(const unsigned *)sw_state.currentpalette);
+	}
+}
+
+/*
+================
+RE_PresentTiles
+
+Uploads runs of changed tiles. Returns false if nothing changed.
+================
+*/
+static qboolean
+RE_PresentTiles(void)
+{
+	qboolean	changed;
+	int	x, y;
+
+	if (palette_changed)
+	{
+		present_full = true;
+	}
+
+	ri.Jobs_Run(RE_PresentTile, NULL, present_tilesx * present_tilesy);
+
+	changed = false;
+
+	for (y = 0; y < present_tilesy; y++)
+	{
+		const byte	*dirty;
+
+		dirty = present_dirty + y * present_tilesx;
+
+		for (x = 0; x < present_tilesx; x++)
+		{
+			SDL_Rect	rect;
+			int	first;
+
+			if (!dirty[x])
+			{
+				continue;
+			}
+
+			// merge with the changed tiles to the right
+			first = x;
+			while (x + 1 < present_tilesx && dirty[x + 1])
+			{
+				x++;
+			}
+
+			rect.x = first * PRESENT_TILE_SIZE;
+			rect.y = y * PRESENT_TILE_SIZE;
+			rect.w = (x + 1) * PRESENT_TILE_SIZE;
+			rect.h = rect.y + PRESENT_TILE_SIZE;
+
+			if (!present_full)
+			{
+				rect.x = max(rect.x, vid_minu);
+				rect.y = max(rect.y, vid_minv);
+				rect.w = min(rect.w, vid_maxu + 1);
+				rect.h = min(rect.h, vid_maxv + 1);
+			}
+			rect.w = min(rect.w, vid_buffer_width) - rect.x;
+			rect.h = min(rect.h, vid_buffer_height) - rect.y;
+
+			SDL_UpdateTexture(texture, &rect,
+				present_pixels + rect.y * vid_buffer_width + rect.x,
+				vid_buffer_width * sizeof(Uint32));
+
+			changed = true;
+		}
+	}
+
+	if (!changed)
+	{
+		return false;
+	}
+
+	present_full = false;
+
+	SDL_RenderCopy(renderer, texture, NULL, NULL);
+	SDL_RenderPresent(renderer);
+
+	// replace use next buffer
+	swap_current ++;
+	vid_buffer = swap_frames[swap_current&1];
+
+	// All changes flushed
+	VID_NoDamageBuffer();
+
+	return true;
 }
 
 /*
@@ -2248,6 +2399,15 @@ RE_EndFrame (void)
 		vid_maxv = vid_buffer_height;
 	}
 
+	// changed 64x64 tiles are converted in parallel and
+	// uploaded alone, the smoothing needs whole lines
+	if (sw_partialrefresh->value &&
+		!((sw_anisotropic->value > 0) && !fastmoving))
+	{
+		RE_PresentTiles();
+		return;
+	}
+
 	vmin = vid_minu + vid_minv  * vid_buffer_width;
 	vmax = vid_maxu + vid_maxv  * vid_buffer_width;
 
@@ -2356,6 +2516,18 @@ SWimp_CreateRender(int width, int height)
 	// Need to rewrite whole frame
 	VID_WholeDamageBuffer();
 
+	present_tilesx = (width + PRESENT_TILE_SIZE - 1) / PRESENT_TILE_SIZE;
+	present_tilesy = (height + PRESENT_TILE_SIZE - 1) / PRESENT_TILE_SIZE;
+	present_pixels = malloc(height * width * sizeof(Uint32));
+	present_dirty = malloc(present_tilesx * present_tilesy);
+	if (!present_pixels || !present_dirty)
+	{
+		ri.Sys_Error(ERR_FATAL, "%s: Can't allocate present buffer.", __func__);
+		// code never returns after ERR_FATAL
+		return;
+	}
+	present_full = true;
+
 	sintable = malloc((width+CYCLE) * sizeof(int));
 	intsintable = malloc((width+CYCLE) * sizeof(int));
 	blanktable = malloc((width+CYCLE) * sizeof(int));
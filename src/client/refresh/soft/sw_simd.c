@@ -0,0 +1,547 @@
+/*
+Copyright (C) 1997-2001 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// sw_simd.c -- SIMD versions of the loops that present a frame
+//
+// The C versions are the reference, all others must return exactly
+// the same results. The best version the CPU supports is selected
+// by R_InitSIMD(), sw_simdbench compares them.
+
+#include <SDL.h>
+
+#include "header/local.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define R_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(R_SIMD_SSE2) && defined(__GNUC__)
+#define R_SIMD_AVX2
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#define R_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+typedef struct
+{
+	const char	*name;
+	void	(*expand)(unsigned *dst, const pixel_t *src, int count, const unsigned *palette);
+	int	(*diffstart)(const pixel_t *back, const pixel_t *front, int vmin, int vmax);
+	int	(*diffend)(const pixel_t *back, const pixel_t *front, int vmin, int vmax);
+	qboolean	(*supported)(void);
+} simdkernels_t;
+
+/*
+===============================================================================
+
+C
+
+===============================================================================
+*/
+
+static void
+R_ExpandPaletteC (unsigned *dst, const pixel_t *src, int count, const unsigned *palette)
+{
+	const unsigned	*max_dst;
+
+	max_dst = dst + count;
+
+	while (dst < max_dst)
+	{
+		*dst = palette[*src];
+		src++;
+		dst++;
+	}
+}
+
+// first int in back + vmin ... back + vmax that differs from front
+static int
+R_DiffStartC (const pixel_t *back, const pixel_t *front, int vmin, int vmax)
+{
+	const int	*front_buffer, *back_buffer, *back_max;
+
+	back_buffer = (const int*)(back + vmin);
+	front_buffer = (const int*)(front + vmin);
+	back_max = (const int*)(back + vmax);
+
+	while (back_buffer < back_max && *back_buffer == *front_buffer)
+	{
+		back_buffer ++;
+		front_buffer ++;
+	}
+	return (const pixel_t*)back_buffer - back;
+}
+
+// end of the last int before back + vmax that differs from front
+static int
+R_DiffEndC (const pixel_t *back, const pixel_t *front, int vmin, int vmax)
+{
+	const int	*front_buffer, *back_buffer, *back_min;
+
+	back_buffer = (const int*)(back + vmax);
+	front_buffer = (const int*)(front + vmax);
+	back_min = (const int*)(back + vmin);
+
+	do {
+		back_buffer --;
+		front_buffer --;
+	} while (back_buffer > back_min && *back_buffer == *front_buffer);
+	// +1 for fully cover changes
+	return (const pixel_t*)back_buffer - back + sizeof(int);
+}
+
+static qboolean
+R_SupportedC (void)
+{
+	return true;
+}
+
+/*
+===============================================================================
+
+SSE2
+
+===============================================================================
+*/
+
+#ifdef R_SIMD_SSE2
+// there's no gather, but four pixels are written at once
+static void
+R_ExpandPaletteSSE2 (unsigned *dst, const pixel_t *src, int count, const unsigned *palette)
+{
+	int	i;
+
+	for (i = 0; i + 4 <= count; i += 4)
+	{
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_setr_epi32(
+			palette[src[i]], palette[src[i + 1]],
+			palette[src[i + 2]], palette[src[i + 3]]));
+	}
+
+	R_ExpandPaletteC (dst + i, src + i, count - i, palette);
+}
+
+// skip 16 equal bytes at once, the C version finds the exact int
+static int
+R_DiffStartSSE2 (const pixel_t *back, const pixel_t *front, int vmin, int vmax)
+{
+	while (vmin + 16 <= vmax)
+	{
+		__m128i	a, b;
+
+		a = _mm_loadu_si128((const __m128i *)(back + vmin));
+		b = _mm_loadu_si128((const __m128i *)(front + vmin));
+
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) != 0xFFFF)
+		{
+			break;
+		}
+
+		vmin += 16;
+	}
+
+	return R_DiffStartC (back, front, vmin, vmax);
+}
+
+static int
+R_DiffEndSSE2 (const pixel_t *back, const pixel_t *front, int vmin, int vmax)
+{
+	while (vmax - 16 > vmin)
+	{
+		__m128i	a, b;
+
+		a = _mm_loadu_si128((const __m128i *)(back + vmax - 16));
+		b = _mm_loadu_si128((const __m128i *)(front + vmax - 16));
+
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) != 0xFFFF)
+		{
+			break;
+		}
+
+		vmax -= 16;
+	}
+
+	return R_DiffEndC (back, front, vmin, vmax);
+}
+
+static qboolean
+R_SupportedSSE2 (void)
+{
+	return true;
+}
+#endif
+
+/*
+===============================================================================
+
+AVX2
+
+===============================================================================
+*/
+
+#ifdef R_SIMD_AVX2
+__attribute__((target("avx2"))) static void
+R_ExpandPaletteAVX2 (unsigned *dst, const pixel_t *src, int count, const unsigned *palette)
+{
+	int	i;
+
+	for (i = 0; i + 8 <= count; i += 8)
+	{
+		__m256i	indices, colors;
+
+		indices = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src + i)));
+		colors = _mm256_i32gather_epi32((const int *)palette, indices, 4);
+		_mm256_storeu_si256((__m256i *)(dst + i), colors);
+	}
+
+	R_ExpandPaletteC (dst + i, src + i, count - i, palette);
+}
+
+__attribute__((target("avx2"))) static int
+R_DiffStartAVX2 (const pixel_t *back, const pixel_t *front, int vmin, int vmax)
+{
+	while (vmin + 32 <= vmax)
+	{
+		__m256i	a, b;
+
+		a = _mm256_loadu_si256((const __m256i *)(back + vmin));
+		b = _mm256_loadu_si256((const __m256i *)(front + vmin));
+
+		if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)) != -1)
+		{
+			break;
+		}
+
+		vmin += 32;
+	}
+
+	return R_DiffStartC (back, front, vmin, vmax);
+}
+
+__attribute__((target("avx2"))) static int
+R_DiffEndAVX2 (const pixel_t *back, const pixel_t *front, int vmin, int vmax)
+{
+	while (vmax - 32 > vmin)
+	{
+		__m256i	a, b;
+
+		a = _mm256_loadu_si256((const __m256i *)(back + vmax - 32));
+		b = _mm256_loadu_si256((const __m256i *)(front + vmax - 32));
+
+		if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)) != -1)
+		{
+			break;
+		}
+
+		vmax -= 32;
+	}
+
+	return R_DiffEndC (back, front, vmin, vmax);
+}
+
+static qboolean
+R_SupportedAVX2 (void)
+{
+	__builtin_cpu_init();
+
+	return __builtin_cpu_supports("avx2") ? true : false;
+}
+#endif
+
+/*
+===============================================================================
+
+NEON
+
+===============================================================================
+*/
+
+#ifdef R_SIMD_NEON
+// NEON has no useful 256 entry lookup, the palette stays in C
+static int
+R_DiffStartNEON (const pixel_t *back, const pixel_t *front, int vmin, int vmax)
+{
+	while (vmin + 16 <= vmax)
+	{
+		uint8x16_t	eq;
+
+		eq = vceqq_u8(vld1q_u8(back + vmin), vld1q_u8(front + vmin));
+
+		if (vminvq_u8(eq) != 0xFF)
+		{
+			break;
+		}
+
+		vmin += 16;
+	}
+
+	return R_DiffStartC (back, front, vmin, vmax);
+}
+
+static int
+R_DiffEndNEON (const pixel_t *back, const pixel_t *front, int vmin, int vmax)
+{
+	while (vmax - 16 > vmin)
+	{
+		uint8x16_t	eq;
+
+		eq = vceqq_u8(vld1q_u8(back + vmax - 16), vld1q_u8(front + vmax - 16));
+
+		if (vminvq_u8(eq) != 0xFF)
+		{
+			break;
+		}
+
+		vmax -= 16;
+	}
+
+	return R_DiffEndC (back, front, vmin, vmax);
+}
+
+static qboolean
+R_SupportedNEON (void)
+{
+	return true;
+}
+#endif
+
+// best first
+static const simdkernels_t r_simdkernels[] = {
+#ifdef R_SIMD_AVX2
+	{"avx2", R_ExpandPaletteAVX2, R_DiffStartAVX2, R_DiffEndAVX2, R_SupportedAVX2},
+#endif
+#ifdef R_SIMD_SSE2
+	{"sse2", R_ExpandPaletteSSE2, R_DiffStartSSE2, R_DiffEndSSE2, R_SupportedSSE2},
+#endif
+#ifdef R_SIMD_NEON
+	{"neon", R_ExpandPaletteC, R_DiffStartNEON, R_DiffEndNEON, R_SupportedNEON},
+#endif
+	{"c", R_ExpandPaletteC, R_DiffStartC, R_DiffEndC, R_SupportedC}
+};
+
+#define NUM_SIMDKERNELS (sizeof(r_simdkernels) / sizeof(r_simdkernels[0]))
+
+static const simdkernels_t	*r_simd = &r_simdkernels[NUM_SIMDKERNELS - 1];
+
+/*
+================
+R_InitSIMD
+================
+*/
+void
+R_InitSIMD (void)
+{
+	int	i;
+
+	for (i = 0; i < NUM_SIMDKERNELS; i++)
+	{
+		if (r_simdkernels[i].supported())
+		{
+			r_simd = &r_simdkernels[i];
+			break;
+		}
+	}
+
+	R_Printf(PRINT_ALL, "Using %s to present frames.\n", r_simd->name);
+}
+
+void
+R_ExpandPalette (unsigned *dst, const pixel_t *src, int count, const unsigned *palette)
+{
+	r_simd->expand(dst, src, count, palette);
+}
+
+int
+R_BufferDiffStart (const pixel_t *back, const pixel_t *front, int vmin, int vmax)
+{
+	return r_simd->diffstart(back, front, vmin, vmax);
+}
+
+int
+R_BufferDiffEnd (const pixel_t *back, const pixel_t *front, int vmin, int vmax)
+{
+	return r_simd->diffend(back, front, vmin, vmax);
+}
+
+/*
+===============================================================================
+
+BENCHMARK
+
+===============================================================================
+*/
+
+#define BENCH_WIDTH	1920
+#define BENCH_HEIGHT	1080
+#define BENCH_SIZE	(BENCH_WIDTH * BENCH_HEIGHT)
+
+static double
+R_BenchSeconds (Uint64 start)
+{
+	return (double)(SDL_GetPerformanceCounter() - start) /
+		(double)SDL_GetPerformanceFrequency();
+}
+
+// runs of random colors, like a rendered frame
+static void
+R_BenchFillFrame (pixel_t *frame, unsigned *seed)
+{
+	int	i;
+
+	i = 0;
+	while (i < BENCH_SIZE)
+	{
+		int	run;
+		pixel_t	color;
+
+		*seed = *seed * 1103515245 + 12345;
+		run = 1 + ((*seed >> 16) & 15);
+		color = (*seed >> 8) & 0xFF;
+
+		while (run-- && i < BENCH_SIZE)
+		{
+			frame[i++] = color;
+		}
+	}
+}
+
+/*
+================
+R_SIMDBench_f
+
+Times all present kernels the CPU supports on synthetic
+full HD frames. The results are checked against the C code.
+================
+*/
+void
+R_SIMDBench_f (void)
+{
+	pixel_t		*back, *front;
+	unsigned	*pixels, *reference;
+	unsigned	palette[256];
+	unsigned	seed;
+	int		frames;
+	int		i, y;
+	int		refstart, refend;
+	Uint64		start;
+	double		seconds;
+
+	frames = 100;
+	if (ri.Cmd_Argc() > 1)
+	{
+		frames = atoi(ri.Cmd_Argv(1));
+	}
+	if (frames < 1)
+	{
+		frames = 1;
+	}
+
+	back = malloc(BENCH_SIZE * sizeof(pixel_t) * 2 + 32);
+	pixels = malloc(BENCH_SIZE * sizeof(unsigned) * 2);
+	if (!back || !pixels)
+	{
+		free(back);
+		free(pixels);
+		R_Printf(PRINT_ALL, "%s: Couldn't allocate the frames.\n", __func__);
+		return;
+	}
+	front = back + BENCH_SIZE;
+	reference = pixels + BENCH_SIZE;
+
+	seed = 1;
+	for (i = 0; i < 256; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		palette[i] = seed | 0xFF000000;
+	}
+
+	R_BenchFillFrame(back, &seed);
+	memcpy(front, back, BENCH_SIZE * sizeof(pixel_t));
+
+	// the front frame differs in a 200x100 block
+	for (y = 490; y < 590; y++)
+	{
+		for (i = 860; i < 1060; i++)
+		{
+			front[y * BENCH_WIDTH + i] ^= 0x55;
+		}
+	}
+
+	R_ExpandPaletteC(reference, back, BENCH_SIZE, palette);
+	refstart = R_DiffStartC(back, front, 0, BENCH_SIZE);
+	refend = R_DiffEndC(back, front, refstart, BENCH_SIZE);
+
+	R_Printf(PRINT_ALL, "%dx%d, %d frames:\n", BENCH_WIDTH, BENCH_HEIGHT, frames);
+
+	for (i = 0; i < NUM_SIMDKERNELS; i++)
+	{
+		const simdkernels_t	*kernels;
+		double	expandms, diffms;
+		int	diffstart, diffend;
+		int	f;
+
+		kernels = &r_simdkernels[i];
+		if (!kernels->supported())
+		{
+			continue;
+		}
+
+		start = SDL_GetPerformanceCounter();
+		for (f = 0; f < frames; f++)
+		{
+			kernels->expand(pixels, back, BENCH_SIZE, palette);
+		}
+		seconds = R_BenchSeconds(start);
+		expandms = seconds * 1000.0 / frames;
+
+		diffstart = diffend = 0;
+		start = SDL_GetPerformanceCounter();
+		for (f = 0; f < frames; f++)
+		{
+			diffstart = kernels->diffstart(back, front, 0, BENCH_SIZE);
+			diffend = kernels->diffend(back, front, diffstart, BENCH_SIZE);
+		}
+		seconds = R_BenchSeconds(start);
+		diffms = seconds * 1000.0 / frames;
+
+		R_Printf(PRINT_ALL, "  %-4s: palette %.3f ms, difference %.3f ms%s\n",
+				kernels->name, expandms, diffms,
+				(memcmp(pixels, reference, BENCH_SIZE * sizeof(unsigned)) ||
+				 diffstart != refstart || diffend != refend) ?
+				", WRONG RESULTS" : "");
+	}
+
+	start = SDL_GetPerformanceCounter();
+	for (i = 0; i < frames; i++)
+	{
+		memcpy(pixels, reference, BENCH_SIZE * sizeof(unsigned));
+		SmoothColorImage(pixels, BENCH_SIZE, 4);
+	}
+	seconds = R_BenchSeconds(start);
+
+	R_Printf(PRINT_ALL, "  SmoothColorImage %.3f ms (including a copy)\n",
+			seconds * 1000.0 / frames);
+
+	free(back);
+	free(pixels);
+}
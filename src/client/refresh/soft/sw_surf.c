@@ -21,14 +21,15 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "header/local.h"
 
-static int		sourcetstep;
-static void		*prowdestbase;
-static unsigned char	*pbasesource;
-static int		r_stepback;
-static int		r_lightwidth;
-static int		r_numvblocks;
-static unsigned char	*r_source, *r_sourcemax;
-static unsigned		*r_lightptr;
+// surfaces can be built on several threads at once
+static THREAD_LOCAL int		sourcetstep;
+static THREAD_LOCAL void		*prowdestbase;
+static THREAD_LOCAL unsigned char	*pbasesource;
+static THREAD_LOCAL int		r_stepback;
+static THREAD_LOCAL int		r_lightwidth;
+static THREAD_LOCAL int		r_numvblocks;
+static THREAD_LOCAL unsigned char	*r_source, *r_sourcemax;
+static THREAD_LOCAL unsigned		*r_lightptr;
 
 void R_BuildLightMap (drawsurf_t *drawsurf);
 
@@ -36,6 +37,18 @@ static int	sc_size;
 static surfcache_t	*sc_rover;
 surfcache_t	*sc_base;
 
+// lower limit for the next R_InitCaches, raised by R_CheckCacheSize
+static int	sc_minsize;
+
+// statistics
+static int	sc_hits, sc_misses, sc_allocs, sc_evictions, sc_thrashes;
+int	c_surfhits, c_surfevictions;	// per frame for r_speeds
+
+// window for sw_surfcachegrow
+#define SC_GROW_FRAMES	32
+#define SC_GROW_MAXSIZE	(64 * 1024 * 1024)
+static int	sc_windowframes, sc_windowlookups, sc_windowallocs, sc_windowevictions;
+
 /*
 ===============
 R_TextureAnimation
@@ -229,6 +242,11 @@ R_InitCaches (void)
 		size = sw_surfcacheoverride->value;
 	}
 
+	if (sc_minsize > size)
+	{
+		size = sc_minsize;
+	}
+
 	// round up to page size
 	size = (size + 8191) & ~8191;
 
@@ -247,6 +265,12 @@ R_InitCaches (void)
 	sc_base->next = NULL;
 	sc_base->owner = NULL;
 	sc_base->size = sc_size;
+	sc_base->pinframe = 0;
+	sc_base->lastframe = 0;
+
+	// statistics are for the current size
+	sc_hits = sc_misses = sc_allocs = sc_evictions = sc_thrashes = 0;
+	sc_windowframes = sc_windowlookups = sc_windowallocs = sc_windowevictions = 0;
 }
 
 
@@ -273,6 +297,208 @@ D_FlushCaches (void)
 	sc_base->next = NULL;
 	sc_base->owner = NULL;
 	sc_base->size = sc_size;
+	sc_base->pinframe = 0;
+	sc_base->lastframe = 0;
+}
+
+/*
+==================
+R_CheckCacheSize
+
+Called after every frame. Doubles the surface cache if too many
+surfaces had to be rebuilt in the last frames because they were
+evicted, see sw_surfcachegrow.
+==================
+*/
+void
+R_CheckCacheSize (void)
+{
+	int	lookups, allocs, evictions;
+
+	if (sw_surfcachegrow->value <= 0 || !sc_base)
+	{
+		return;
+	}
+
+	if (++sc_windowframes < SC_GROW_FRAMES)
+	{
+		return;
+	}
+
+	lookups = (sc_hits + sc_misses) - sc_windowlookups;
+	allocs = sc_allocs - sc_windowallocs;
+	evictions = sc_evictions - sc_windowevictions;
+
+	sc_windowframes = 0;
+	sc_windowlookups = sc_hits + sc_misses;
+	sc_windowallocs = sc_allocs;
+	sc_windowevictions = sc_evictions;
+
+	// a cold cache allocates a lot, but doesn't evict
+	if (!lookups || !evictions ||
+		(allocs * 100.0f <= lookups * sw_surfcachegrow->value))
+	{
+		return;
+	}
+
+	if (sc_size >= SC_GROW_MAXSIZE)
+	{
+		return;
+	}
+
+	R_Printf(PRINT_ALL, "%i of %i surfaces rebuilt in %i frames, growing the surface cache.\n",
+			allocs, lookups, SC_GROW_FRAMES);
+
+	sc_minsize = sc_size * 2;
+	if (sc_minsize > SC_GROW_MAXSIZE)
+	{
+		sc_minsize = SC_GROW_MAXSIZE;
+	}
+
+	D_FlushCaches ();
+	free (sc_base);
+	sc_base = NULL;
+
+	R_InitCaches ();
+}
+
+/*
+==================
+R_SurfCacheInfo_f
+==================
+*/
+void
+R_SurfCacheInfo_f (void)
+{
+	surfcache_t	*c;
+	int		blocks, used, lookups;
+
+	if (!sc_base)
+	{
+		return;
+	}
+
+	blocks = used = 0;
+	for (c = sc_base ; c ; c = c->next)
+	{
+		if (c->owner)
+		{
+			blocks++;
+			used += c->size;
+		}
+	}
+
+	lookups = sc_hits + sc_misses;
+
+	R_Printf(PRINT_ALL, "%ik surface cache, %ik used by %i surfaces\n",
+			sc_size / 1024, used / 1024, blocks);
+	R_Printf(PRINT_ALL, "%i lookups, %i hits (%.1f%%), %i rebuilt, %i allocated\n",
+			lookups, sc_hits, lookups ? sc_hits * 100.0f / lookups : 0.0f,
+			sc_misses, sc_allocs);
+	R_Printf(PRINT_ALL, "%i evicted, %i allocations had to evict surfaces of the same frame\n",
+			sc_evictions, sc_thrashes);
+}
+
+/*
+=================
+D_SCUnpin
+
+The threaded span drawing keeps a list of surfaces and draws
+them all at once, so their cache blocks must not be reused
+before that happened. Draw them now if this block is one of them.
+=================
+*/
+static void
+D_SCUnpin (const surfcache_t *cache)
+{
+	if (d_spanpinframe && cache->pinframe == d_spanpinframe)
+		D_FlushSpanSurfaces ();
+}
+
+/*
+=================
+D_SCEvict
+=================
+*/
+static void
+D_SCEvict (surfcache_t *cache)
+{
+	*cache->owner = NULL;
+	cache->owner = NULL;
+
+	sc_evictions++;
+	c_surfevictions++;
+}
+
+/*
+=================
+D_SCFindRun
+
+Moves the rover to the next run of blocks that holds size bytes
+and wasn't used by this frame. The blocks are evicted in the order
+they were allocated, but never one the current frame needs. That's
+as close to LRU as it gets without moving blocks around. Returns
+false if the whole cache is used by this frame.
+=================
+*/
+static qboolean
+D_SCFindRun (int size)
+{
+	static int	thrashframe = -1;
+	surfcache_t	*start, *run, *c;
+	int		runsize;
+	qboolean	wrapped;
+
+	// this frame needs more than the whole cache, don't search again
+	if (thrashframe == r_framecount)
+		return false;
+
+	start = sc_rover;
+	run = c = sc_rover;
+	runsize = 0;
+	wrapped = false;
+
+	while (1)
+	{
+		if (c->owner && c->lastframe == r_framecount)
+		{
+			// still needed, try after it
+			run = c->next;
+			runsize = 0;
+		}
+		else
+		{
+			runsize += c->size;
+			if (runsize >= size)
+				break;
+		}
+
+		c = c->next;
+
+		if (!c)
+		{
+			// the run hit the end of memory
+			if (wrapped)
+				break;
+
+			wrapped = true;
+			run = c = sc_base;
+			runsize = 0;
+		}
+
+		if (wrapped && c >= start)
+			break;
+	}
+
+	if (runsize < size)
+	{
+		thrashframe = r_framecount;
+		return false;
+	}
+
+	sc_rover = run;
+
+	return true;
 }
 
 /*
@@ -309,10 +535,17 @@ D_SCAlloc (int width, int size)
 		sc_rover = sc_base;
 	}
 
+	// don't throw away what's drawn this frame if there's anything else
+	if (!D_SCFindRun (size))
+	{
+		sc_thrashes++;
+	}
+
 	// colect and free surfcache_t blocks until the rover block is large enough
 	new = sc_rover;
+	D_SCUnpin (sc_rover);
 	if (sc_rover->owner)
-		*sc_rover->owner = NULL;
+		D_SCEvict (sc_rover);
 
 	while (new->size < size)
 	{
@@ -322,8 +555,9 @@ D_SCAlloc (int width, int size)
 		{
 			ri.Sys_Error(ERR_FATAL, "%s: hit the end of memory", __func__);
 		}
+		D_SCUnpin (sc_rover);
 		if (sc_rover->owner)
-			*sc_rover->owner = NULL;
+			D_SCEvict (sc_rover);
 
 		new->size += sc_rover->size;
 		new->next = sc_rover->next;
@@ -337,6 +571,8 @@ D_SCAlloc (int width, int size)
 		sc_rover->next = new->next;
 		sc_rover->width = 0;
 		sc_rover->owner = NULL;
+		sc_rover->pinframe = 0;
+		sc_rover->lastframe = 0;
 		new->next = sc_rover;
 		new->size = size;
 	}
@@ -357,13 +593,86 @@ D_SCAlloc (int width, int size)
 
 static drawsurf_t	r_drawsurf;
 
+// surfaces waiting for D_BuildSurfaces
+static drawsurf_t	*d_buildsurfs;
+static int		d_numbuildsurfs;
+static int		d_maxbuildsurfs;
+
+static void
+D_BuildSurface (void *data, int index, int thread)
+{
+	R_BindBlockLights (thread);
+
+	// calculate the lightings
+	R_BuildLightMap (&d_buildsurfs[index]);
+
+	// rasterize the surface into the cache
+	R_DrawSurface (&d_buildsurfs[index]);
+}
+
 /*
 ================
-D_CacheSurface
+D_BuildSurfaces
+
+Builds all surfaces queued by D_CacheSurfaceDeferred in
+parallel. Their cache blocks are valid after this.
 ================
 */
-surfcache_t *
-D_CacheSurface (const entity_t *currententity, msurface_t *surface, int miplevel)
+void
+D_BuildSurfaces (void)
+{
+	if (!d_numbuildsurfs)
+		return;
+
+	R_AllocThreadBlockLights (ri.Jobs_NumThreads());
+
+	ri.Jobs_Run (D_BuildSurface, NULL, d_numbuildsurfs);
+
+	d_numbuildsurfs = 0;
+}
+
+void
+D_ShutdownBuildSurfaces (void)
+{
+	free (d_buildsurfs);
+	d_buildsurfs = NULL;
+	d_numbuildsurfs = 0;
+	d_maxbuildsurfs = 0;
+}
+
+static void
+D_QueueSurface (const drawsurf_t *drawsurf)
+{
+	if (d_numbuildsurfs == d_maxbuildsurfs)
+	{
+		drawsurf_t	*newsurfs;
+		int		newmax;
+
+		newmax = d_maxbuildsurfs ? d_maxbuildsurfs * 2 : 256;
+		newsurfs = realloc (d_buildsurfs, newmax * sizeof(drawsurf_t));
+		if (!newsurfs)
+		{
+			ri.Sys_Error(ERR_FATAL, "%s: Couldn't allocate %d surfaces",
+				__func__, newmax);
+			// code never returns after ERR_FATAL
+			return;
+		}
+
+		d_buildsurfs = newsurfs;
+		d_maxbuildsurfs = newmax;
+	}
+
+	d_buildsurfs[d_numbuildsurfs++] = *drawsurf;
+}
+
+/*
+================
+D_CacheSurfaceInternal
+================
+*/
+static surfcache_t *
+D_CacheSurfaceInternal (const entity_t *currententity, msurface_t *surface,
+		int miplevel, qboolean deferred)
 {
 	surfcache_t	*cache;
 	float		surfscale;
@@ -388,7 +697,14 @@ D_CacheSurface (const entity_t *currententity, msurface_t *surface, int miplevel
 			&& cache->lightadj[1] == r_drawsurf.lightadj[1]
 			&& cache->lightadj[2] == r_drawsurf.lightadj[2]
 			&& cache->lightadj[3] == r_drawsurf.lightadj[3] )
+	{
+		cache->lastframe = r_framecount;
+		sc_hits++;
+		c_surfhits++;
 		return cache;
+	}
+
+	sc_misses++;
 
 	//
 	// determine shape of surface
@@ -404,12 +720,17 @@ D_CacheSurface (const entity_t *currententity, msurface_t *surface, int miplevel
 	//
 	if (!cache) // if a texture just animated, don't reallocate it
 	{
+		sc_allocs++;
 		cache = D_SCAlloc (r_drawsurf.surfwidth,
 						   r_drawsurf.surfwidth * r_drawsurf.surfheight);
 		surface->cachespots[miplevel] = cache;
 		cache->owner = &surface->cachespots[miplevel];
 		cache->mipscale = surfscale;
 	}
+	else
+		D_SCUnpin (cache);	// redrawn in place
+
+	cache->lastframe = r_framecount;
 
 	if (surface->dlightframe == r_framecount)
 		cache->dlight = 1;
@@ -431,6 +752,12 @@ D_CacheSurface (const entity_t *currententity, msurface_t *surface, int miplevel
 
 	c_surf++;
 
+	if (deferred)
+	{
+		D_QueueSurface (&r_drawsurf);
+		return cache;
+	}
+
 	// calculate the lightings
 	R_BuildLightMap (&r_drawsurf);
 
@@ -439,3 +766,28 @@ D_CacheSurface (const entity_t *currententity, msurface_t *surface, int miplevel
 
 	return cache;
 }
+
+/*
+================
+D_CacheSurface
+================
+*/
+surfcache_t *
+D_CacheSurface (const entity_t *currententity, msurface_t *surface, int miplevel)
+{
+	return D_CacheSurfaceInternal (currententity, surface, miplevel, false);
+}
+
+/*
+================
+D_CacheSurfaceDeferred
+
+Like D_CacheSurface, but the surface is built by the
+next D_BuildSurfaces, together with all others.
+================
+*/
+surfcache_t *
+D_CacheSurfaceDeferred (const entity_t *currententity, msurface_t *surface, int miplevel)
+{
+	return D_CacheSurfaceInternal (currententity, surface, miplevel, true);
+}
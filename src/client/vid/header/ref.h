@@ -32,7 +32,7 @@
 
 #define	MAX_DLIGHTS		32
 #define	MAX_ENTITIES	512
-#define	MAX_PARTICLES	4096
+#define	MAX_PARTICLES	65536
 #define	MAX_LIGHTSTYLES	256
 
 #define POWERSUIT_SCALE		4.0F
@@ -88,6 +88,18 @@ typedef struct {
 	float	alpha;
 } particle_t;
 
+/* a particle as spawned by the client, for renderers
+   that move and fade particles themselves */
+typedef struct {
+	vec3_t	origin;
+	vec3_t	vel;
+	vec3_t	accel;
+	int		color;
+	float	alpha;
+	float	alphavel; /* per second */
+	float	time; /* spawn time in milliseconds */
+} particlestate_t;
+
 typedef struct {
 	float		rgb[3]; /* 0.0 - 2.0 */
 	float		white; /* r+g+b */
@@ -114,6 +126,15 @@ typedef struct {
 
 	int			num_particles;
 	particle_t	*particles;
+
+	/* particles spawned since the last frame, only filled if the
+	   renderer's KeepParticles() returned true. The renderer keeps
+	   them until they faded out, their position at particletime is
+	   origin + vel * t + accel * t * t with t in seconds. */
+	int				num_newparticles;
+	particlestate_t	*newparticles;
+	int				particletime; /* milliseconds */
+	qboolean		clearparticles; /* drop all kept particles first */
 } refdef_t;
 
 // Renderer restart type.
@@ -124,8 +145,7 @@ typedef enum {
 	RESTART_PARTIAL
 } ref_restart_t;
 
-// FIXME: bump API_VERSION?
-#define	API_VERSION		5
+#define	API_VERSION		7
 #define EXPORT
 #define IMPORT
 
@@ -202,6 +222,10 @@ typedef struct
 	void	(EXPORT *EndFrame) (void);
 	qboolean	(EXPORT *EndWorldRenderpass) (void); // finish world rendering, apply postprocess and switch to UI render pass
 
+	// returns true if the renderer animates the particles passed
+	// in refdef_t.newparticles itself, may be NULL
+	qboolean	(EXPORT *KeepParticles) (void);
+
 	//void	(EXPORT *AppActivate)( qboolean activate );
 } refexport_t;
 
@@ -243,6 +267,10 @@ typedef struct
 	qboolean	(IMPORT *GLimp_GetDesktopMode)(int *pwidth, int *pheight);
 
 	void		(IMPORT *Vid_RequestRestart)(ref_restart_t rs);
+
+	// the engines thread pool, see Jobs_Run()
+	void		(IMPORT *Jobs_Run)(jobfunc_t func, void *data, int count);
+	int		(IMPORT *Jobs_NumThreads)(void);
 } refimport_t;
 
 // this is the only function actually exported at the linker level
@@ -278,6 +306,7 @@ void Draw_StretchRaw(int x, int y, int w, int h, int cols, int rows, byte *data)
 void R_SetPalette(const unsigned char *palette);
 void R_BeginFrame(float camera_separation);
 qboolean R_EndWorldRenderpass(void);
+qboolean R_KeepParticles(void);
 void R_EndFrame(void);
 
 #endif
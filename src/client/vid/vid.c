@@ -445,6 +445,8 @@ VID_LoadRenderer(void)
 	ri.Vid_MenuInit = VID_MenuInit;
 	ri.Vid_WriteScreenshot = VID_WriteScreenshot;
 	ri.Vid_RequestRestart = VID_RequestRestart;
+	ri.Jobs_Run = Jobs_Run;
+	ri.Jobs_NumThreads = Jobs_NumThreads;
 
 	// Exchange our export struct with the renderers import struct.
 	re = GetRefAPI(ri);
@@ -771,6 +773,16 @@ R_EndWorldRenderpass(void)
 	return false;
 }
 
+qboolean
+R_KeepParticles(void)
+{
+	if(ref_active && re.KeepParticles)
+	{
+		return re.KeepParticles();
+	}
+	return false;
+}
+
 void
 R_EndFrame(void)
 {
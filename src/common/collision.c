@@ -55,7 +55,6 @@ typedef struct
 	int			contents;
 	int			numsides;
 	int			firstbrushside;
-	int			checkcount;	/* to avoid repeated testings */
 } cbrush_t;
 
 typedef struct
@@ -66,6 +65,15 @@ typedef struct
 	int		floodvalid;
 } carea_t;
 
+typedef struct
+{
+	int		*list;
+	int		count;
+	int		maxcount;
+	float	*mins, *maxs;
+	int		topnode;
+} boxleafs_t;
+
 byte *cmod_base;
 byte map_visibility[MAX_MAP_VISIBILITY];
 // DG: is casted to int32_t* in SV_FatPVS() so align accordingly
@@ -84,16 +92,12 @@ cnode_t	map_nodes[MAX_MAP_NODES_QBSP+6]; /* extra for box hull */
 cplane_t *box_planes;
 cplane_t map_planes[MAX_MAP_PLANES_QBSP+6]; /* extra for box hull */
 cvar_t *map_noareas;
+cvar_t *map_viscache;
 dareaportal_t map_areaportals[MAX_MAP_AREAPORTALS];
 dvis_t *map_vis = (dvis_t *)map_visibility;
 int box_headnode;
-int	checkcount;
 int	emptyleaf, solidleaf;
 int	floodvalid;
-float *leaf_mins, *leaf_maxs;
-int leaf_count, leaf_maxcount;
-int *leaf_list;
-int leaf_topnode;
 int	numareaportals;
 int numareas = 1;
 int	numbrushes;
@@ -107,16 +111,21 @@ int	numnodes;
 int	numplanes;
 int	numtexinfo;
 int	numvisibility;
-int trace_contents;
 mapsurface_t map_surfaces[MAX_MAP_TEXINFO];
 mapsurface_t nullsurface;
 qboolean portalopen[MAX_MAP_AREAPORTALS];
-qboolean trace_ispoint; /* optimized case */
-trace_t trace_trace;
 unsigned int	map_leafbrushes[MAX_MAP_LEAFBRUSHES];
-vec3_t trace_start, trace_end;
-vec3_t trace_mins, trace_maxs;
-vec3_t trace_extents;
+
+/* decompressed PVS and PHS rows, see CM_BuildVisCache() */
+static byte *map_pvscache;
+static byte *map_phscache;
+static int map_visrowstride;
+
+static void CM_FreeVisCache(void);
+static void CM_BuildVisCache(void);
+
+/* used by the non reentrant CM_BoxTrace() wrappers */
+static cmtrace_t cm_trace;
 
 #ifndef DEDICATED_ONLY
 int		c_pointcontents;
@@ -388,6 +397,23 @@ CM_InitBoxHull(void)
 	}
 }
 
+static void
+CM_SetBoxPlanes(cplane_t *planes, vec3_t mins, vec3_t maxs)
+{
+	planes[0].dist = maxs[0];
+	planes[1].dist = -maxs[0];
+	planes[2].dist = mins[0];
+	planes[3].dist = -mins[0];
+	planes[4].dist = maxs[1];
+	planes[5].dist = -maxs[1];
+	planes[6].dist = mins[1];
+	planes[7].dist = -mins[1];
+	planes[8].dist = maxs[2];
+	planes[9].dist = -maxs[2];
+	planes[10].dist = mins[2];
+	planes[11].dist = -mins[2];
+}
+
 /*
  * To keep everything totally uniform, bounding boxes are turned into
  * small BSP trees instead of being compared directly.
@@ -395,18 +421,24 @@ CM_InitBoxHull(void)
 int
 CM_HeadnodeForBox(vec3_t mins, vec3_t maxs)
 {
-	box_planes[0].dist = maxs[0];
-	box_planes[1].dist = -maxs[0];
-	box_planes[2].dist = mins[0];
-	box_planes[3].dist = -mins[0];
-	box_planes[4].dist = maxs[1];
-	box_planes[5].dist = -maxs[1];
-	box_planes[6].dist = mins[1];
-	box_planes[7].dist = -mins[1];
-	box_planes[8].dist = maxs[2];
-	box_planes[9].dist = -maxs[2];
-	box_planes[10].dist = mins[2];
-	box_planes[11].dist = -mins[2];
+	CM_SetBoxPlanes(box_planes, mins, maxs);
+	cm_trace.hasbox = false;
+
+	return box_headnode;
+}
+
+/*
+ * Same as CM_HeadnodeForBox(), but the box planes are stored
+ * in the trace context and not in the shared map planes. The
+ * returned headnode is only valid for the next trace through
+ * ctx, the trace clears the box again.
+ */
+int
+CM_HeadnodeForBoxContext(cmtrace_t *ctx, vec3_t mins, vec3_t maxs)
+{
+	memcpy(ctx->boxplanes, box_planes, sizeof(ctx->boxplanes));
+	CM_SetBoxPlanes(ctx->boxplanes, mins, maxs);
+	ctx->hasbox = true;
 
 	return box_headnode;
 }
@@ -466,8 +498,8 @@ CM_PointLeafnum(vec3_t p)
  * Fills in a list of all the leafs touched
  */
 
-void
-CM_BoxLeafnums_r(int nodenum)
+static void
+CM_BoxLeafnums_r(boxleafs_t *bl, int nodenum)
 {
 	cplane_t *plane;
 	cnode_t *node;
@@ -477,18 +509,18 @@ CM_BoxLeafnums_r(int nodenum)
 	{
 		if (nodenum < 0)
 		{
-			if (leaf_count >= leaf_maxcount)
+			if (bl->count >= bl->maxcount)
 			{
 				return;
 			}
 
-			leaf_list[leaf_count++] = -1 - nodenum;
+			bl->list[bl->count++] = -1 - nodenum;
 			return;
 		}
 
 		node = &map_nodes[nodenum];
 		plane = node->plane;
-		s = BOX_ON_PLANE_SIDE(leaf_mins, leaf_maxs, plane);
+		s = BOX_ON_PLANE_SIDE(bl->mins, bl->maxs, plane);
 
 		if (s == 1)
 		{
@@ -503,12 +535,12 @@ CM_BoxLeafnums_r(int nodenum)
 		else
 		{
 			/* go down both */
-			if (leaf_topnode == -1)
+			if (bl->topnode == -1)
 			{
-				leaf_topnode = nodenum;
+				bl->topnode = nodenum;
 			}
 
-			CM_BoxLeafnums_r(node->children[0]);
+			CM_BoxLeafnums_r(bl, node->children[0]);
 			nodenum = node->children[1];
 		}
 	}
@@ -518,22 +550,24 @@ int
 CM_BoxLeafnums_headnode(vec3_t mins, vec3_t maxs, int *list,
 		int listsize, int headnode, int *topnode)
 {
-	leaf_list = list;
-	leaf_count = 0;
-	leaf_maxcount = listsize;
-	leaf_mins = mins;
-	leaf_maxs = maxs;
+	boxleafs_t bl;
+
+	bl.list = list;
+	bl.count = 0;
+	bl.maxcount = listsize;
+	bl.mins = mins;
+	bl.maxs = maxs;
 
-	leaf_topnode = -1;
+	bl.topnode = -1;
 
-	CM_BoxLeafnums_r(headnode);
+	CM_BoxLeafnums_r(&bl, headnode);
 
 	if (topnode)
 	{
-		*topnode = leaf_topnode;
+		*topnode = bl.topnode;
 	}
 
-	return leaf_count;
+	return bl.count;
 }
 
 int
@@ -591,8 +625,57 @@ CM_TransformedPointContents(vec3_t p, int headnode,
 	return map_leafs[l].contents;
 }
 
-void
-CM_ClipBoxToBrush(vec3_t mins, vec3_t maxs, vec3_t p1,
+/*
+ * Returns the plane to use for this trace. The box hull planes
+ * are taken from the context if it has a private box set up.
+ */
+static inline cplane_t *
+CM_TracePlane(cmtrace_t *ctx, cplane_t *plane)
+{
+	if (ctx->hasbox && (plane >= box_planes) && (plane < box_planes + 12))
+	{
+		return &ctx->boxplanes[plane - box_planes];
+	}
+
+	return plane;
+}
+
+/*
+ * Marks a brush as checked for the current trace. Returns
+ * false if the brush was already checked. If the set is
+ * too crowded the brush is just checked again, that's
+ * harmless since clipping against a brush is idempotent.
+ */
+static qboolean
+CM_CheckBrush(cmtrace_t *ctx, int brushnum)
+{
+	unsigned int slot;
+	int i;
+
+	slot = ((unsigned int)brushnum * 2654435761u) & (CM_TRACE_CHECKBRUSHES - 1);
+
+	for (i = 0; i < 8; i++)
+	{
+		if (ctx->checkstamp[slot] != ctx->checkcount)
+		{
+			ctx->checkstamp[slot] = ctx->checkcount;
+			ctx->checkbrush[slot] = brushnum;
+			return true;
+		}
+
+		if (ctx->checkbrush[slot] == brushnum)
+		{
+			return false; /* already checked this brush in another leaf */
+		}
+
+		slot = (slot + 1) & (CM_TRACE_CHECKBRUSHES - 1);
+	}
+
+	return true;
+}
+
+static void
+CM_ClipBoxToBrush(cmtrace_t *ctx, vec3_t mins, vec3_t maxs, vec3_t p1,
 		vec3_t p2, trace_t *trace, cbrush_t *brush)
 {
 	int i, j;
@@ -625,9 +708,9 @@ CM_ClipBoxToBrush(vec3_t mins, vec3_t maxs, vec3_t p1,
 	for (i = 0; i < brush->numsides; i++)
 	{
 		side = &map_brushsides[brush->firstbrushside + i];
-		plane = side->plane;
+		plane = CM_TracePlane(ctx, side->plane);
 
-		if (!trace_ispoint)
+		if (!ctx->ispoint)
 		{
 			/* general box case
 			   push the plane out
@@ -740,8 +823,8 @@ CM_ClipBoxToBrush(vec3_t mins, vec3_t maxs, vec3_t p1,
 	}
 }
 
-void
-CM_TestBoxInBrush(vec3_t mins, vec3_t maxs, vec3_t p1,
+static void
+CM_TestBoxInBrush(cmtrace_t *ctx, vec3_t mins, vec3_t maxs, vec3_t p1,
 		trace_t *trace, cbrush_t *brush)
 {
 	int i, j;
@@ -759,7 +842,7 @@ CM_TestBoxInBrush(vec3_t mins, vec3_t maxs, vec3_t p1,
 	for (i = 0; i < brush->numsides; i++)
 	{
 		side = &map_brushsides[brush->firstbrushside + i];
-		plane = side->plane;
+		plane = CM_TracePlane(ctx, side->plane);
 
 		/* general box case
 		   push the plane out
@@ -795,8 +878,8 @@ CM_TestBoxInBrush(vec3_t mins, vec3_t maxs, vec3_t p1,
 	trace->contents = brush->contents;
 }
 
-void
-CM_TraceToLeaf(int leafnum)
+static void
+CM_TraceToLeaf(cmtrace_t *ctx, int leafnum)
 {
 	int k;
 	int brushnum;
@@ -805,7 +888,7 @@ CM_TraceToLeaf(int leafnum)
 
 	leaf = &map_leafs[leafnum];
 
-	if (!(leaf->contents & trace_contents))
+	if (!(leaf->contents & ctx->contents))
 	{
 		return;
 	}
@@ -816,30 +899,28 @@ CM_TraceToLeaf(int leafnum)
 		brushnum = map_leafbrushes[leaf->firstleafbrush + k];
 		b = &map_brushes[brushnum];
 
-		if (b->checkcount == checkcount)
+		if (!CM_CheckBrush(ctx, brushnum))
 		{
-			continue; /* already checked this brush in another leaf */
+			continue;
 		}
 
-		b->checkcount = checkcount;
-
-		if (!(b->contents & trace_contents))
+		if (!(b->contents & ctx->contents))
 		{
 			continue;
 		}
 
-		CM_ClipBoxToBrush(trace_mins, trace_maxs, trace_start,
-				trace_end, &trace_trace, b);
+		CM_ClipBoxToBrush(ctx, ctx->mins, ctx->maxs, ctx->start,
+				ctx->end, &ctx->trace, b);
 
-		if (!trace_trace.fraction)
+		if (!ctx->trace.fraction)
 		{
 			return;
 		}
 	}
 }
 
-void
-CM_TestInLeaf(int leafnum)
+static void
+CM_TestInLeaf(cmtrace_t *ctx, int leafnum)
 {
 	int k;
 	int brushnum;
@@ -848,7 +929,7 @@ CM_TestInLeaf(int leafnum)
 
 	leaf = &map_leafs[leafnum];
 
-	if (!(leaf->contents & trace_contents))
+	if (!(leaf->contents & ctx->contents))
 	{
 		return;
 	}
@@ -859,29 +940,28 @@ CM_TestInLeaf(int leafnum)
 		brushnum = map_leafbrushes[leaf->firstleafbrush + k];
 		b = &map_brushes[brushnum];
 
-		if (b->checkcount == checkcount)
+		if (!CM_CheckBrush(ctx, brushnum))
 		{
-			continue; /* already checked this brush in another leaf */
+			continue;
 		}
 
-		b->checkcount = checkcount;
-
-		if (!(b->contents & trace_contents))
+		if (!(b->contents & ctx->contents))
 		{
 			continue;
 		}
 
-		CM_TestBoxInBrush(trace_mins, trace_maxs, trace_start, &trace_trace, b);
+		CM_TestBoxInBrush(ctx, ctx->mins, ctx->maxs, ctx->start, &ctx->trace, b);
 
-		if (!trace_trace.fraction)
+		if (!ctx->trace.fraction)
 		{
 			return;
 		}
 	}
 }
 
-void
-CM_RecursiveHullCheck(int num, float p1f, float p2f, vec3_t p1, vec3_t p2)
+static void
+CM_RecursiveHullCheck(cmtrace_t *ctx, int num, float p1f, float p2f,
+		vec3_t p1, vec3_t p2)
 {
 	cnode_t *node;
 	cplane_t *plane;
@@ -893,7 +973,7 @@ CM_RecursiveHullCheck(int num, float p1f, float p2f, vec3_t p1, vec3_t p2)
 	int side;
 	float midf;
 
-	if (trace_trace.fraction <= p1f)
+	if (ctx->trace.fraction <= p1f)
 	{
 		return; /* already hit something nearer */
 	}
@@ -901,20 +981,20 @@ CM_RecursiveHullCheck(int num, float p1f, float p2f, vec3_t p1, vec3_t p2)
 	/* if < 0, we are in a leaf node */
 	if (num < 0)
 	{
-		CM_TraceToLeaf(-1 - num);
+		CM_TraceToLeaf(ctx, -1 - num);
 		return;
 	}
 
 	/* find the point distances to the seperating plane
 	   and the offset for the size of the box */
 	node = map_nodes + num;
-	plane = node->plane;
+	plane = CM_TracePlane(ctx, node->plane);
 
 	if (plane->type < 3)
 	{
 		t1 = p1[plane->type] - plane->dist;
 		t2 = p2[plane->type] - plane->dist;
-		offset = trace_extents[plane->type];
+		offset = ctx->extents[plane->type];
 	}
 
 	else
@@ -922,29 +1002,29 @@ CM_RecursiveHullCheck(int num, float p1f, float p2f, vec3_t p1, vec3_t p2)
 		t1 = DotProduct(plane->normal, p1) - plane->dist;
 		t2 = DotProduct(plane->normal, p2) - plane->dist;
 
-		if (trace_ispoint)
+		if (ctx->ispoint)
 		{
 			offset = 0;
 		}
 
 		else
 		{
-			offset = (float)fabs(trace_extents[0] * plane->normal[0]) +
-					 (float)fabs(trace_extents[1] * plane->normal[1]) +
-					 (float)fabs(trace_extents[2] * plane->normal[2]);
+			offset = (float)fabs(ctx->extents[0] * plane->normal[0]) +
+					 (float)fabs(ctx->extents[1] * plane->normal[1]) +
+					 (float)fabs(ctx->extents[2] * plane->normal[2]);
 		}
 	}
 
 	/* see which sides we need to consider */
 	if ((t1 >= offset) && (t2 >= offset))
 	{
-		CM_RecursiveHullCheck(node->children[0], p1f, p2f, p1, p2);
+		CM_RecursiveHullCheck(ctx, node->children[0], p1f, p2f, p1, p2);
 		return;
 	}
 
 	if ((t1 < -offset) && (t2 < -offset))
 	{
-		CM_RecursiveHullCheck(node->children[1], p1f, p2f, p1, p2);
+		CM_RecursiveHullCheck(ctx, node->children[1], p1f, p2f, p1, p2);
 		return;
 	}
 
@@ -990,7 +1070,7 @@ CM_RecursiveHullCheck(int num, float p1f, float p2f, vec3_t p1, vec3_t p2)
 		mid[i] = p1[i] + frac * (p2[i] - p1[i]);
 	}
 
-	CM_RecursiveHullCheck(node->children[side], p1f, midf, p1, mid);
+	CM_RecursiveHullCheck(ctx, node->children[side], p1f, midf, p1, mid);
 
 	/* go past the node */
 	if (frac2 < 0)
@@ -1010,36 +1090,49 @@ CM_RecursiveHullCheck(int num, float p1f, float p2f, vec3_t p1, vec3_t p2)
 		mid[i] = p1[i] + frac2 * (p2[i] - p1[i]);
 	}
 
-	CM_RecursiveHullCheck(node->children[side ^ 1], midf, p2f, mid, p2);
+	CM_RecursiveHullCheck(ctx, node->children[side ^ 1], midf, p2f, mid, p2);
 }
 
-trace_t
-CM_BoxTrace(vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs,
-		int headnode, int brushmask)
+void
+CM_InitTraceContext(cmtrace_t *ctx)
+{
+	memset(ctx, 0, sizeof(*ctx));
+}
+
+static void
+CM_TraceContext(cmtrace_t *ctx, vec3_t start, vec3_t end,
+		vec3_t mins, vec3_t maxs, int headnode, int brushmask)
 {
 	int i;
 
-	checkcount++; /* for multi-check avoidance */
+	ctx->checkcount++; /* for multi-check avoidance */
+
+	if (!ctx->checkcount)
+	{
+		/* wrapped around, forget all stamps */
+		memset(ctx->checkstamp, 0, sizeof(ctx->checkstamp));
+		ctx->checkcount = 1;
+	}
 
 #ifndef DEDICATED_ONLY
 	c_traces++; /* for statistics, may be zeroed */
 #endif
 
 	/* fill in a default trace */
-	memset(&trace_trace, 0, sizeof(trace_trace));
-	trace_trace.fraction = 1;
-	trace_trace.surface = &(nullsurface.c);
+	memset(&ctx->trace, 0, sizeof(ctx->trace));
+	ctx->trace.fraction = 1;
+	ctx->trace.surface = &(nullsurface.c);
 
 	if (!numnodes)  /* map not loaded */
 	{
-		return trace_trace;
+		return;
 	}
 
-	trace_contents = brushmask;
-	VectorCopy(start, trace_start);
-	VectorCopy(end, trace_end);
-	VectorCopy(mins, trace_mins);
-	VectorCopy(maxs, trace_maxs);
+	ctx->contents = brushmask;
+	VectorCopy(start, ctx->start);
+	VectorCopy(end, ctx->end);
+	VectorCopy(mins, ctx->mins);
+	VectorCopy(maxs, ctx->maxs);
 
 	/* check for position test special case */
 	if ((start[0] == end[0]) && (start[1] == end[1]) && (start[2] == end[2]))
@@ -1063,52 +1156,70 @@ CM_BoxTrace(vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs,
 
 		for (i = 0; i < numleafs; i++)
 		{
-			CM_TestInLeaf(leafs[i]);
+			CM_TestInLeaf(ctx, leafs[i]);
 
-			if (trace_trace.allsolid)
+			if (ctx->trace.allsolid)
 			{
 				break;
 			}
 		}
 
-		VectorCopy(start, trace_trace.endpos);
-		return trace_trace;
+		VectorCopy(start, ctx->trace.endpos);
+		return;
 	}
 
 	/* check for point special case */
 	if ((mins[0] == 0) && (mins[1] == 0) && (mins[2] == 0) &&
 		(maxs[0] == 0) && (maxs[1] == 0) && (maxs[2] == 0))
 	{
-		trace_ispoint = true;
-		VectorClear(trace_extents);
+		ctx->ispoint = true;
+		VectorClear(ctx->extents);
 	}
 
 	else
 	{
-		trace_ispoint = false;
-		trace_extents[0] = -mins[0] > maxs[0] ? -mins[0] : maxs[0];
-		trace_extents[1] = -mins[1] > maxs[1] ? -mins[1] : maxs[1];
-		trace_extents[2] = -mins[2] > maxs[2] ? -mins[2] : maxs[2];
+		ctx->ispoint = false;
+		ctx->extents[0] = -mins[0] > maxs[0] ? -mins[0] : maxs[0];
+		ctx->extents[1] = -mins[1] > maxs[1] ? -mins[1] : maxs[1];
+		ctx->extents[2] = -mins[2] > maxs[2] ? -mins[2] : maxs[2];
 	}
 
 	/* general sweeping through world */
-	CM_RecursiveHullCheck(headnode, 0, 1, start, end);
+	CM_RecursiveHullCheck(ctx, headnode, 0, 1, start, end);
 
-	if (trace_trace.fraction == 1)
+	if (ctx->trace.fraction == 1)
 	{
-		VectorCopy(end, trace_trace.endpos);
+		VectorCopy(end, ctx->trace.endpos);
 	}
 
 	else
 	{
 		for (i = 0; i < 3; i++)
 		{
-			trace_trace.endpos[i] = start[i] + trace_trace.fraction *
+			ctx->trace.endpos[i] = start[i] + ctx->trace.fraction *
 									(end[i] - start[i]);
 		}
 	}
+}
 
-	return trace_trace;
+trace_t
+CM_BoxTraceContext(cmtrace_t *ctx, vec3_t start, vec3_t end,
+		vec3_t mins, vec3_t maxs, int headnode, int brushmask)
+{
+	CM_TraceContext(ctx, start, end, mins, maxs, headnode, brushmask);
+
+	/* the private box hull is only set up for one trace */
+	ctx->hasbox = false;
+
+	return ctx->trace;
+}
+
+trace_t
+CM_BoxTrace(vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs,
+		int headnode, int brushmask)
+{
+	return CM_BoxTraceContext(&cm_trace, start, end, mins, maxs,
+			headnode, brushmask);
 }
 
 /*
@@ -1116,8 +1227,9 @@ CM_BoxTrace(vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs,
  * rotating entities
  */
 trace_t
-CM_TransformedBoxTrace(vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs,
-		int headnode, int brushmask, vec3_t origin, vec3_t angles)
+CM_TransformedBoxTraceContext(cmtrace_t *ctx, vec3_t start, vec3_t end,
+		vec3_t mins, vec3_t maxs, int headnode, int brushmask,
+		vec3_t origin, vec3_t angles)
 {
 	trace_t trace;
 	vec3_t start_l, end_l;
@@ -1158,7 +1270,8 @@ CM_TransformedBoxTrace(vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs,
 	}
 
 	/* sweep the box through the model */
-	trace = CM_BoxTrace(start_l, end_l, mins, maxs, headnode, brushmask);
+	trace = CM_BoxTraceContext(ctx, start_l, end_l, mins, maxs,
+			headnode, brushmask);
 
 	if (rotated && (trace.fraction != 1.0))
 	{
@@ -1178,6 +1291,14 @@ CM_TransformedBoxTrace(vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs,
 	return trace;
 }
 
+trace_t
+CM_TransformedBoxTrace(vec3_t start, vec3_t end, vec3_t mins, vec3_t maxs,
+		int headnode, int brushmask, vec3_t origin, vec3_t angles)
+{
+	return CM_TransformedBoxTraceContext(&cm_trace, start, end, mins, maxs,
+			headnode, brushmask, origin, angles);
+}
+
 void
 CMod_LoadSubmodels(lump_t *l)
 {
@@ -1868,6 +1989,7 @@ CM_LoadMap(char *name, qboolean clientload, unsigned *checksum)
 	static unsigned last_checksum;
 
 	map_noareas = Cvar_Get("map_noareas", "0", 0);
+	map_viscache = Cvar_Get("map_viscache", "64", CVAR_ARCHIVE);
 
 	if (strcmp(map_name, name) == 0
 		&& (clientload || !Cvar_VariableValue("flushmap")))
@@ -1884,6 +2006,7 @@ CM_LoadMap(char *name, qboolean clientload, unsigned *checksum)
 	}
 
 	/* free old stuff */
+	CM_FreeVisCache();
 	numplanes = 0;
 	numnodes = 0;
 	numleafs = 0;
@@ -1980,6 +2103,7 @@ CM_LoadMap(char *name, qboolean clientload, unsigned *checksum)
 	FS_FreeFile(buf);
 
 	CM_InitBoxHull();
+	CM_BuildVisCache();
 
 	memset(portalopen, 0, sizeof(portalopen));
 	FloodAreaConnections();
@@ -2108,36 +2232,123 @@ CM_DecompressVis(byte *in, byte *out)
 	while (out_p - out < row);
 }
 
+static void
+CM_FreeVisCache(void)
+{
+	if (map_pvscache)
+	{
+		Z_Free(map_pvscache);
+	}
+
+	map_pvscache = NULL;
+	map_phscache = NULL;
+	map_visrowstride = 0;
+}
+
+/*
+ * Decompresses all PVS and PHS rows at map load, so
+ * CM_ClusterPVS() and CM_ClusterPHS() become a simple
+ * lookup returning stable pointers. map_viscache limits
+ * the memory used for that in megabytes, if the map needs
+ * more the rows are decompressed on every call.
+ */
+static void
+CM_BuildVisCache(void)
+{
+	int i;
+	size_t size;
+
+	CM_FreeVisCache();
+
+	if ((map_viscache->value <= 0) || (numclusters <= 0))
+	{
+		return;
+	}
+
+	/* SV_FatPVS() reads the rows as int32_t */
+	map_visrowstride = ((numclusters + 31) >> 5) << 2;
+	size = (size_t)map_visrowstride * numclusters * 2;
+
+	if (size > (size_t)(map_viscache->value * 1024 * 1024))
+	{
+		Com_DPrintf("CM_BuildVisCache: %i clusters need %lu bytes, not cached\n",
+				numclusters, (unsigned long)size);
+		map_visrowstride = 0;
+		return;
+	}
+
+	map_pvscache = Z_Malloc((int)size);
+	map_phscache = map_pvscache + (size_t)map_visrowstride * numclusters;
+
+	for (i = 0; i < numclusters; i++)
+	{
+		CM_DecompressVis(map_visibility +
+				LittleLong(map_vis->bitofs[i][DVIS_PVS]),
+				map_pvscache + (size_t)map_visrowstride * i);
+		CM_DecompressVis(map_visibility +
+				LittleLong(map_vis->bitofs[i][DVIS_PHS]),
+				map_phscache + (size_t)map_visrowstride * i);
+	}
+
+	Com_DPrintf("CM_BuildVisCache: %i clusters, %lu bytes\n",
+			numclusters, (unsigned long)size);
+}
+
+/*
+ * Like CM_ClusterPVS(), but rows that aren't cached are
+ * decompressed into buffer (MAX_MAP_LEAFS / 8 bytes) and
+ * not into a shared one. Thread safe.
+ */
 byte *
-CM_ClusterPVS(int cluster)
+CM_ClusterPVSBuffer(int cluster, byte *buffer)
 {
 	if (cluster == -1)
 	{
-		memset(pvsrow, 0, (numclusters + 7) >> 3);
+		memset(buffer, 0, (numclusters + 7) >> 3);
+	}
+	else if (map_pvscache && (cluster < numclusters))
+	{
+		return map_pvscache + (size_t)map_visrowstride * cluster;
 	}
 	else
 	{
 		CM_DecompressVis(map_visibility +
-				LittleLong(map_vis->bitofs[cluster][DVIS_PVS]), pvsrow);
+				LittleLong(map_vis->bitofs[cluster][DVIS_PVS]), buffer);
 	}
 
-	return pvsrow;
+	return buffer;
 }
 
 byte *
-CM_ClusterPHS(int cluster)
+CM_ClusterPHSBuffer(int cluster, byte *buffer)
 {
 	if (cluster == -1)
 	{
-		memset(phsrow, 0, (numclusters + 7) >> 3);
+		memset(buffer, 0, (numclusters + 7) >> 3);
+	}
+
+	else if (map_phscache && (cluster < numclusters))
+	{
+		return map_phscache + (size_t)map_visrowstride * cluster;
 	}
 
 	else
 	{
 		CM_DecompressVis(map_visibility +
-				LittleLong(map_vis->bitofs[cluster][DVIS_PHS]), phsrow);
+				LittleLong(map_vis->bitofs[cluster][DVIS_PHS]), buffer);
 	}
 
-	return phsrow;
+	return buffer;
+}
+
+byte *
+CM_ClusterPVS(int cluster)
+{
+	return CM_ClusterPVSBuffer(cluster, pvsrow);
 }
 
+byte *
+CM_ClusterPHS(int cluster)
+{
+	return CM_ClusterPHSBuffer(cluster, phsrow);
+}
@@ -26,6 +26,14 @@
  */
 
 //#include <libgen.h>
+#include <ctype.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include "header/common.h"
 #include "header/glob.h"
@@ -34,6 +42,7 @@
 #include "../client/sound/header/vorbis.h"
 
 #define MAX_HANDLES 512
+#define MAX_MAPPINGS 256
 #define MAX_MODS 32
 #define MAX_PAKS 100
 
@@ -49,6 +58,8 @@ typedef struct
 	fsMode_t mode;
 	FILE *file;           /* Only one will be used. */
 	unzFile *zip;        /* (file or zip) */
+	struct fsPack_s *pack; /* Pack the file was found in, if any. */
+	int packFile;         /* Index into pack->files. */
 } fsHandle_t;
 
 typedef struct fsLink_s
@@ -64,16 +75,20 @@ typedef struct
 	char name[MAX_QPATH];
 	int size;
 	int offset;     /* Ignored in PK3 files. */
+	int hashNext;   /* Next file in the same hash bucket or -1. */
 } fsPackFile_t;
 
-typedef struct
+typedef struct fsPack_s
 {
 	char name[MAX_OSPATH];
 	int numFiles;
+	int fd;         /* For mmap(), opened on demand. */
 	FILE *pak;
 	unzFile *pk3;
 	qboolean isProtectedPak;
 	fsPackFile_t *files;
+	int hashSize;   /* Power of two. */
+	int *hashTable; /* First file in each bucket or -1. */
 } fsPack_t;
 
 typedef struct fsSearchPath_s
@@ -122,6 +137,46 @@ fsHandle_t *FS_GetFileByHandle(fileHandle_t f);
 
 // --------
 
+// Merged index of all files in all packs of the search path.
+// Every name points to the pack that comes first in the search
+// path. Rebuild lazily after the search path changed.
+typedef struct
+{
+	fsPack_t *pack;
+	int file;
+	int next;
+} fsIndexEntry_t;
+
+typedef struct
+{
+	qboolean valid;
+	int hashSize;
+	int *hashTable;
+	int numEntries;
+	fsIndexEntry_t *entries;
+
+	int hits;
+	int misses;
+} fsFileIndex_t;
+
+fsFileIndex_t fs_fileIndex;
+
+// --------
+
+// Files returned by FS_LoadFile() that are private
+// mappings of their pack instead of Z_Malloc() copies.
+typedef struct
+{
+	void *buffer;
+	void *base;
+	size_t length;
+} fsMapping_t;
+
+fsMapping_t fs_mappings[MAX_MAPPINGS];
+cvar_t *fs_mmap;
+
+// --------
+
 // Raw search path, the actual search
 // bath is build from this one.
 typedef struct fsRawPath_s {
@@ -364,6 +419,214 @@ FS_FCloseFile(fileHandle_t f)
 	memset(handle, 0, sizeof(*handle));
 }
 
+/*
+ * Case insensitive FNV-1a hash of a file name.
+ */
+static unsigned int
+FS_HashFileName(const char *name)
+{
+	unsigned int hash;
+
+	hash = 2166136261u;
+
+	while (*name)
+	{
+		hash ^= (unsigned char)tolower((unsigned char)*name++);
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static int
+FS_HashSizeForFiles(int numFiles)
+{
+	int size;
+
+	for (size = 64; size < numFiles; size <<= 1)
+	{
+	}
+
+	return size;
+}
+
+/*
+ * Builds the hash table of a pack. The buckets are filled backwards,
+ * so the first file with a given name comes first in its bucket. That
+ * matches the linear scan which was used before.
+ */
+static void
+FS_HashPack(fsPack_t *pack)
+{
+	unsigned int bucket;
+	int i;
+
+	pack->hashSize = FS_HashSizeForFiles(pack->numFiles);
+	pack->hashTable = Z_Malloc(pack->hashSize * sizeof(int));
+
+	for (i = 0; i < pack->hashSize; i++)
+	{
+		pack->hashTable[i] = -1;
+	}
+
+	for (i = pack->numFiles - 1; i >= 0; i--)
+	{
+		bucket = FS_HashFileName(pack->files[i].name) & (pack->hashSize - 1);
+		pack->files[i].hashNext = pack->hashTable[bucket];
+		pack->hashTable[bucket] = i;
+	}
+}
+
+/*
+ * Returns the index of the file in the pack or -1.
+ */
+static int
+FS_FindInPack(fsPack_t *pack, const char *name)
+{
+	int i;
+
+	i = pack->hashTable[FS_HashFileName(name) & (pack->hashSize - 1)];
+
+	for ( ; i != -1; i = pack->files[i].hashNext)
+	{
+		if (Q_stricmp(pack->files[i].name, name) == 0)
+		{
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+/*
+ * Throws the merged file index away, must be called
+ * every time the search path changes.
+ */
+static void
+FS_InvalidateFileIndex(void)
+{
+	if (fs_fileIndex.hashTable)
+	{
+		Z_Free(fs_fileIndex.hashTable);
+	}
+
+	if (fs_fileIndex.entries)
+	{
+		Z_Free(fs_fileIndex.entries);
+	}
+
+	fs_fileIndex.hashTable = NULL;
+	fs_fileIndex.entries = NULL;
+	fs_fileIndex.numEntries = 0;
+	fs_fileIndex.valid = false;
+}
+
+static void
+FS_BuildFileIndex(void)
+{
+	fsSearchPath_t *search;
+	fsIndexEntry_t *entry;
+	fsPack_t *pack;
+	unsigned int bucket;
+	int i, j, numFiles;
+
+	FS_InvalidateFileIndex();
+
+	numFiles = 0;
+
+	for (search = fs_searchPaths; search; search = search->next)
+	{
+		if (search->pack)
+		{
+			numFiles += search->pack->numFiles;
+		}
+	}
+
+	fs_fileIndex.hashSize = FS_HashSizeForFiles(numFiles);
+	fs_fileIndex.hashTable = Z_Malloc(fs_fileIndex.hashSize * sizeof(int));
+	fs_fileIndex.entries = Z_Malloc((numFiles ? numFiles : 1) * sizeof(fsIndexEntry_t));
+
+	for (i = 0; i < fs_fileIndex.hashSize; i++)
+	{
+		fs_fileIndex.hashTable[i] = -1;
+	}
+
+	/* Packs earlier in the search path win. */
+	for (search = fs_searchPaths; search; search = search->next)
+	{
+		if (!search->pack)
+		{
+			continue;
+		}
+
+		pack = search->pack;
+
+		for (i = 0; i < pack->numFiles; i++)
+		{
+			bucket = FS_HashFileName(pack->files[i].name) & (fs_fileIndex.hashSize - 1);
+
+			for (j = fs_fileIndex.hashTable[bucket]; j != -1; j = fs_fileIndex.entries[j].next)
+			{
+				entry = &fs_fileIndex.entries[j];
+
+				if (Q_stricmp(entry->pack->files[entry->file].name, pack->files[i].name) == 0)
+				{
+					break;
+				}
+			}
+
+			if (j != -1)
+			{
+				continue;
+			}
+
+			entry = &fs_fileIndex.entries[fs_fileIndex.numEntries];
+			entry->pack = pack;
+			entry->file = i;
+			entry->next = fs_fileIndex.hashTable[bucket];
+			fs_fileIndex.hashTable[bucket] = fs_fileIndex.numEntries++;
+		}
+	}
+
+	fs_fileIndex.valid = true;
+
+	FS_DPrintf("FS_BuildFileIndex: %i files in %i packed files.\n",
+			fs_fileIndex.numEntries, numFiles);
+}
+
+/*
+ * Returns the index entry for the given name or NULL
+ * if no pack in the search path contains the file.
+ */
+static fsIndexEntry_t *
+FS_FindInFileIndex(const char *name)
+{
+	fsIndexEntry_t *entry;
+	int i;
+
+	if (!fs_fileIndex.valid)
+	{
+		FS_BuildFileIndex();
+	}
+
+	i = fs_fileIndex.hashTable[FS_HashFileName(name) & (fs_fileIndex.hashSize - 1)];
+
+	for ( ; i != -1; i = fs_fileIndex.entries[i].next)
+	{
+		entry = &fs_fileIndex.entries[i];
+
+		if (Q_stricmp(entry->pack->files[entry->file].name, name) == 0)
+		{
+			fs_fileIndex.hits++;
+			return entry;
+		}
+	}
+
+	fs_fileIndex.misses++;
+
+	return NULL;
+}
+
 /*
  * Finds the file in the search path. Returns filesize and an open FILE *. Used
  * for streaming data out of either a pak file or a seperate file.
@@ -373,8 +636,10 @@ FS_FOpenFile(const char *rawname, fileHandle_t *f, qboolean gamedir_only)
 {
 	char path[MAX_OSPATH], lwrName[MAX_OSPATH];
 	fsHandle_t *handle;
+	fsIndexEntry_t *indexed;
 	fsPack_t *pack;
 	fsSearchPath_t *search;
+	qboolean useIndex;
 	int i;
 
 	// Remove self references and empty dirs from the requested path.
@@ -434,6 +699,12 @@ FS_FOpenFile(const char *rawname, fileHandle_t *f, qboolean gamedir_only)
 	Q_strlcpy(handle->name, name, sizeof(handle->name));
 	handle->mode = FS_READ;
 
+	/* The merged index knows the first pack with the file. It
+	   can't be used if some packs are skipped, see below. */
+	useIndex = !gamedir_only && !((strcmp(fs_gamedirvar->string, "") == 0) &&
+		((strcmp(name, "maps.lst") == 0) || (strncmp(name, "players/", 8) == 0)));
+	indexed = useIndex ? FS_FindInFileIndex(handle->name) : NULL;
+
 	/* Search through the path, one element at a time. */
 	for (search = fs_searchPaths; search; search = search->next)
 	{
@@ -458,68 +729,76 @@ FS_FOpenFile(const char *rawname, fileHandle_t *f, qboolean gamedir_only)
 		{
 			pack = search->pack;
 
-			for (i = 0; i < pack->numFiles; i++)
+			if (useIndex)
 			{
-				if (Q_stricmp(pack->files[i].name, handle->name) == 0)
+				i = (indexed && (indexed->pack == pack)) ? indexed->file : -1;
+			}
+			else
+			{
+				i = FS_FindInPack(pack, handle->name);
+			}
+
+			if (i != -1)
+			{
+				/* Found it! */
+				if (fs_debug->value)
 				{
-					/* Found it! */
-					if (fs_debug->value)
-					{
-						Com_Printf("FS_FOpenFile: '%s' (found in '%s').\n",
-						           handle->name, pack->name);
-					}
+					Com_Printf("FS_FOpenFile: '%s' (found in '%s').\n",
+					           handle->name, pack->name);
+				}
 
-					// save the name with *correct case* in the handle
-					// (relevant for savegames, when starting map with wrong case but it's still found
-					//  because it's from pak, but save/bla/MAPname.sav/sv2 will have wrong case and can't be found then)
-					Q_strlcpy(handle->name, pack->files[i].name, sizeof(handle->name));
+				// save the name with *correct case* in the handle
+				// (relevant for savegames, when starting map with wrong case but it's still found
+				//  because it's from pak, but save/bla/MAPname.sav/sv2 will have wrong case and can't be found then)
+				Q_strlcpy(handle->name, pack->files[i].name, sizeof(handle->name));
+				handle->pack = pack;
+				handle->packFile = i;
 
-					if (pack->pak)
+				if (pack->pak)
+				{
+					/* PAK */
+					if (pack->isProtectedPak)
 					{
-						/* PAK */
-						if (pack->isProtectedPak)
-						{
-							file_from_protected_pak = true;
-						}
+						file_from_protected_pak = true;
+					}
 
-						handle->file = Q_fopen(pack->name, "rb");
+					handle->file = Q_fopen(pack->name, "rb");
 
-						if (handle->file)
-						{
-							fseek(handle->file, pack->files[i].offset, SEEK_SET);
-							return pack->files[i].size;
-						}
+					if (handle->file)
+					{
+						fseek(handle->file, pack->files[i].offset, SEEK_SET);
+						return pack->files[i].size;
 					}
-					else if (pack->pk3)
+				}
+				else if (pack->pk3)
+				{
+					/* PK3 */
+					if (pack->isProtectedPak)
 					{
-						/* PK3 */
-						if (pack->isProtectedPak)
-						{
-							file_from_protected_pak = true;
-						}
+						file_from_protected_pak = true;
+					}
 
 #ifdef _WIN32
-						handle->zip = unzOpen2(pack->name, &zlib_file_api);
+					handle->zip = unzOpen2(pack->name, &zlib_file_api);
 #else
-						handle->zip = unzOpen(pack->name);
+					handle->zip = unzOpen(pack->name);
 #endif
 
-						if (handle->zip)
+					if (handle->zip)
+					{
+						if (unzLocateFile(handle->zip, handle->name, 2) == UNZ_OK)
 						{
-							if (unzLocateFile(handle->zip, handle->name, 2) == UNZ_OK)
+							if (unzOpenCurrentFile(handle->zip) == UNZ_OK)
 							{
-								if (unzOpenCurrentFile(handle->zip) == UNZ_OK)
-								{
-									return pack->files[i].size;
-								}
+								return pack->files[i].size;
 							}
-
-							unzClose(handle->zip);
 						}
-					}
 
-					Com_Error(ERR_FATAL, "Couldn't reopen '%s'", pack->name);
+						unzClose(handle->zip);
+					}
 				}
+
+				Com_Error(ERR_FATAL, "Couldn't reopen '%s'", pack->name);
 			}
 		}
 		else
@@ -689,6 +968,163 @@ FS_FRead(void *buffer, int size, int count, fileHandle_t f)
 	return size;
 }
 
+/*
+ * Maps an uncompressed file inside a pack directly into memory
+ * instead of copying it. The mapping is private, a caller writing
+ * into the buffer gets its own copy of the touched pages and
+ * neither the pack nor later loads of the same file are affected.
+ * The page aligned region holding the file is mapped and the returned
+ * buffer points to the file inside it. Returns NULL if the file can't
+ * be mapped, e.g. if it's compressed, not int aligned in the pack or
+ * if the pack is shorter than it claims.
+ */
+static void *
+FS_MapFile(fileHandle_t f, int size)
+{
+#ifndef _WIN32
+	fsHandle_t *handle;
+	fsMapping_t *mapping;
+	unz_file_info info;
+	struct stat st;
+	long long offset, aligned;
+	long pagesize;
+	void *base;
+	int i;
+
+	if (!fs_mmap->value)
+	{
+		return NULL;
+	}
+
+	handle = FS_GetFileByHandle(f);
+
+	if (!handle->pack)
+	{
+		return NULL;
+	}
+
+	for (i = 0, mapping = NULL; i < MAX_MAPPINGS; i++)
+	{
+		if (!fs_mappings[i].buffer)
+		{
+			mapping = &fs_mappings[i];
+			break;
+		}
+	}
+
+	if (!mapping)
+	{
+		return NULL;
+	}
+
+	if (handle->file)
+	{
+		offset = handle->pack->files[handle->packFile].offset;
+	}
+	else if (handle->zip)
+	{
+		/* only stored, unencrypted files */
+		if (unzGetCurrentFileInfo(handle->zip, &info, NULL, 0,
+					NULL, 0, NULL, 0) != UNZ_OK)
+		{
+			return NULL;
+		}
+
+		if ((info.compression_method != 0) || (info.flag & 1) ||
+			(info.uncompressed_size != size))
+		{
+			return NULL;
+		}
+
+		offset = unzGetCurrentFileZStreamPos64(handle->zip);
+	}
+	else
+	{
+		return NULL;
+	}
+
+	/* the loaders cast the buffer to int and float,
+	   a mapping is only as aligned as the file inside
+	   the pack. All their lumps are int aligned. */
+	if (offset % sizeof(int))
+	{
+		return NULL;
+	}
+
+	if (handle->pack->fd == -1)
+	{
+		/* the same file the index was read from,
+		   even if the pack was replaced since */
+		if (handle->pack->pak)
+		{
+			handle->pack->fd = dup(fileno(handle->pack->pak));
+		}
+		else
+		{
+			handle->pack->fd = open(handle->pack->name, O_RDONLY);
+		}
+
+		if (handle->pack->fd == -1)
+		{
+			return NULL;
+		}
+	}
+
+	/* reading a mapping past the end of the
+	   pack raises SIGBUS, e.g. if it's broken
+	   or was truncated since it was opened */
+	if ((fstat(handle->pack->fd, &st) == -1) ||
+		(offset + size > (long long)st.st_size))
+	{
+		return NULL;
+	}
+
+	pagesize = sysconf(_SC_PAGESIZE);
+	aligned = offset - (offset % pagesize);
+
+	base = mmap(NULL, size + (offset - aligned), PROT_READ | PROT_WRITE,
+			MAP_PRIVATE, handle->pack->fd, aligned);
+
+	if (base == MAP_FAILED)
+	{
+		return NULL;
+	}
+
+	mapping->base = base;
+	mapping->length = size + (offset - aligned);
+	mapping->buffer = (byte *)base + (offset - aligned);
+
+	return mapping->buffer;
+#else
+	return NULL;
+#endif
+}
+
+/*
+ * Releases a buffer returned by FS_MapFile().
+ * Returns false if buffer isn't mapped.
+ */
+static qboolean
+FS_UnmapFile(void *buffer)
+{
+#ifndef _WIN32
+	int i;
+
+	for (i = 0; i < MAX_MAPPINGS; i++)
+	{
+		if (fs_mappings[i].buffer == buffer)
+		{
+			munmap(fs_mappings[i].base, fs_mappings[i].length);
+			memset(&fs_mappings[i], 0, sizeof(fs_mappings[i]));
+
+			return true;
+		}
+	}
+#endif
+
+	return false;
+}
+
 /*
  * Filename are reletive to the quake search path. A null buffer will just
  * return the file length without loading.
@@ -719,6 +1155,16 @@ FS_LoadFile(char *path, void **buffer)
 		return size;
 	}
 
+	buf = FS_MapFile(f, size);
+
+	if (buf)
+	{
+		*buffer = buf;
+		FS_FCloseFile(f);
+
+		return size;
+	}
+
 	buf = Z_Malloc(size);
 	*buffer = buf;
 
@@ -737,6 +1183,11 @@ FS_FreeFile(void *buffer)
 		return;
 	}
 
+	if (FS_UnmapFile(buffer))
+	{
+		return;
+	}
+
 	Z_Free(buffer);
 }
 
@@ -774,6 +1225,15 @@ fsSearchPath_t *FS_FreeSearchPaths(fsSearchPath_t *start, fsSearchPath_t *end)
 				unzClose(cur->pack->pk3);
 			}
 
+#ifndef _WIN32
+			/* Mapped files stay valid after close(). */
+			if (cur->pack->fd != -1)
+			{
+				close(cur->pack->fd);
+			}
+#endif
+
+			Z_Free(cur->pack->hashTable);
 			Z_Free(cur->pack->files);
 			Z_Free(cur->pack);
 		}
@@ -859,10 +1319,12 @@ FS_LoadPAK(const char *packPath)
 
 	pack = Z_Malloc(sizeof(fsPack_t));
 	Q_strlcpy(pack->name, packPath, sizeof(pack->name));
+	pack->fd = -1;
 	pack->pak = handle;
 	pack->pk3 = NULL;
 	pack->numFiles = numFiles;
 	pack->files = files;
+	FS_HashPack(pack);
 
 	Com_Printf("Added packfile '%s' (%i files).\n", pack->name, numFiles);
 
@@ -933,10 +1395,12 @@ FS_LoadPK3(const char *packPath)
 
 	pack = Z_Malloc(sizeof(fsPack_t));
 	Q_strlcpy(pack->name, packPath, sizeof(pack->name));
+	pack->fd = -1;
 	pack->pak = NULL;
 	pack->pk3 = handle;
 	pack->numFiles = numFiles;
 	pack->files = files;
+	FS_HashPack(pack);
 
 	Com_Printf("Added packfile '%s' (%i files).\n", pack->name, numFiles);
 
@@ -1020,6 +1484,12 @@ FS_Path_f(void)
 	Com_Printf("----------------------\n");
 
 	Com_Printf("%i files in PAK/PK2/PK3/ZIP files.\n", totalFiles);
+
+	if (fs_debug->value)
+	{
+		Com_Printf("Pack file index: %i lookups found, %i not found.\n",
+				fs_fileIndex.hits, fs_fileIndex.misses);
+	}
 }
 
 /*
@@ -1584,6 +2054,7 @@ FS_AddPAKFromGamedir(const char *pak)
 			search->pack = pakfile;
 			search->next = fs_searchPaths;
 			fs_searchPaths = search;
+			FS_InvalidateFileIndex();
 
 			return true;
 		}
@@ -1652,6 +2123,7 @@ FS_AddDirToSearchPath(char *dir, qboolean create) {
 	Q_strlcpy(search->path, dir, sizeof(search->path));
 	search->next = fs_searchPaths;
 	fs_searchPaths = search;
+	FS_InvalidateFileIndex();
 
 
 	// Numbered paks contain the official game data, they
@@ -1695,6 +2167,7 @@ FS_AddDirToSearchPath(char *dir, qboolean create) {
 			search->pack = pack;
 			search->next = fs_searchPaths;
 			fs_searchPaths = search;
+			FS_InvalidateFileIndex();
 		}
 	}
 
@@ -1765,6 +2238,7 @@ FS_AddDirToSearchPath(char *dir, qboolean create) {
 			search->pack = pack;
 			search->next = fs_searchPaths;
 			fs_searchPaths = search;
+			FS_InvalidateFileIndex();
 		}
 
 		FS_FreeList(list, nfiles);
@@ -1847,6 +2321,7 @@ FS_BuildGameSpecificSearchPath(char *dir)
 	// path. This can happen if the server changes the mod. Let's
 	// remove them.
 	fs_searchPaths = FS_FreeSearchPaths(fs_searchPaths, fs_baseSearchPaths);
+	FS_InvalidateFileIndex();
 
 	/* Close open files for game dir. */
 	for (i = 0; i < MAX_HANDLES; i++)
@@ -2057,6 +2532,7 @@ FS_InitFilesystem(void)
 	fs_cddir = Cvar_Get("cddir", "", CVAR_NOSET);
 	fs_gamedirvar = Cvar_Get("game", "", CVAR_LATCH | CVAR_SERVERINFO);
 	fs_debug = Cvar_Get("fs_debug", "0", 0);
+	fs_mmap = Cvar_Get("fs_mmap", "1", 0);
 
 	// Deprecation warning, can be removed at a later time.
 	if (strcmp(fs_basedir->string, ".") != 0)
@@ -2100,6 +2576,7 @@ void
 FS_ShutdownFilesystem(void)
 {
 	fs_searchPaths = FS_FreeSearchPaths(fs_searchPaths, NULL);
+	FS_InvalidateFileIndex();
 	fs_rawPath = FS_FreeRawPaths(fs_rawPath, NULL);
 
 	fs_baseSearchPaths = NULL;
@@ -173,7 +173,12 @@ Qcommon_Mainloop(void)
 			}
 		}
 #else
-		Sys_Nanosleep(850000);
+		/* With the event loop SV_Frame() sleeps
+		   until the next frame or a packet. */
+		if (!sv_eventloop->value)
+		{
+			Sys_Nanosleep(850000);
+		}
 #endif
 
 		newtime = Sys_Microseconds();
@@ -360,6 +365,7 @@ Qcommon_Init(int argc, char **argv)
 
 	// Start late subsystem.
 	Sys_Init();
+	Jobs_Init();
 	NET_Init();
 	Netchan_Init();
 	SV_Init();
@@ -738,8 +744,9 @@ Qcommon_Frame(int usec)
 	servertimedelta += usec;
 
 
-	// Network frame time.
-	if (packetdelta < (1000000.0f / pfps)) {
+	// Network frame time. The event loop wakes
+	// us only when there's something to do.
+	if ((packetdelta < (1000000.0f / pfps)) && !sv_eventloop->value) {
 		packetframe = false;
 	}
 
@@ -770,6 +777,7 @@ Qcommon_Frame(int usec)
 void
 Qcommon_Shutdown(void)
 {
+	Jobs_Shutdown();
 	FS_ShutdownFilesystem();
 	Cvar_Fini();
 
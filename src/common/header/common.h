@@ -58,6 +58,7 @@
 typedef struct sizebuf_s
 {
 	qboolean allowoverflow;     /* if false, do a Com_Error */
+	qboolean quietoverflow;     /* don't print overflows, for job threads */
 	qboolean overflowed;        /* set to true if the buffer size failed */
 	byte *data;
 	int maxsize;
@@ -519,6 +520,8 @@ void NET_Config(qboolean multiplayer);
 qboolean NET_GetPacket(netsrc_t sock, netadr_t *net_from,
 		sizebuf_t *net_message);
 void NET_SendPacket(netsrc_t sock, int length, void *data, netadr_t to);
+void NET_BeginSendBatch(void);
+void NET_EndSendBatch(void);
 
 qboolean NET_CompareAdr(netadr_t a, netadr_t b);
 qboolean NET_CompareBaseAdr(netadr_t a, netadr_t b);
@@ -526,6 +529,7 @@ qboolean NET_IsLocalAddress(netadr_t adr);
 char *NET_AdrToString(netadr_t a);
 qboolean NET_StringToAdr(const char *s, netadr_t *a);
 void NET_Sleep(int msec);
+void NET_SleepUntil(long long deadline);
 
 /*=================================================================== */
 
@@ -606,9 +610,46 @@ trace_t CM_TransformedBoxTrace(vec3_t start, vec3_t end,
 		vec3_t mins, vec3_t maxs, int headnode,
 		int brushmask, vec3_t origin, vec3_t angles);
 
+/* Per trace state. The functions above share one context and
+   are not reentrant, every thread tracing concurrently must use
+   its own context with the functions below. */
+#define CM_TRACE_CHECKBRUSHES 1024 /* must be a power of two */
+
+typedef struct
+{
+	trace_t		trace;
+	vec3_t		start, end;
+	vec3_t		mins, maxs;
+	vec3_t		extents;
+	int			contents;
+	qboolean	ispoint; /* optimized case */
+
+	/* brushes already checked by the current trace */
+	unsigned int	checkcount;
+	unsigned int	checkstamp[CM_TRACE_CHECKBRUSHES];
+	int				checkbrush[CM_TRACE_CHECKBRUSHES];
+
+	/* private box hull for the next trace,
+	   see CM_HeadnodeForBoxContext() */
+	qboolean	hasbox;
+	cplane_t	boxplanes[12];
+} cmtrace_t;
+
+void CM_InitTraceContext(cmtrace_t *ctx);
+int CM_HeadnodeForBoxContext(cmtrace_t *ctx, vec3_t mins, vec3_t maxs);
+trace_t CM_BoxTraceContext(cmtrace_t *ctx, vec3_t start, vec3_t end,
+		vec3_t mins, vec3_t maxs, int headnode, int brushmask);
+trace_t CM_TransformedBoxTraceContext(cmtrace_t *ctx, vec3_t start,
+		vec3_t end, vec3_t mins, vec3_t maxs, int headnode,
+		int brushmask, vec3_t origin, vec3_t angles);
+
 byte *CM_ClusterPVS(int cluster);
 byte *CM_ClusterPHS(int cluster);
 
+/* thread safe variants, buffer must hold MAX_MAP_LEAFS / 8 bytes */
+byte *CM_ClusterPVSBuffer(int cluster, byte *buffer);
+byte *CM_ClusterPHSBuffer(int cluster, byte *buffer);
+
 int CM_PointLeafnum(vec3_t p);
 
 /* call with topnode set to the headnode, returns with topnode */
@@ -696,6 +737,24 @@ char **FS_ListMods(int *nummods);
 void FS_FreeFile(void *buffer);
 void FS_CreatePath(char *path);
 
+/* JOBS */
+
+#define MAX_JOB_THREADS 32
+
+/* index is the loop index, thread identifies the
+   executing thread, 0 <= thread < Jobs_NumThreads() */
+typedef void (*jobfunc_t)(void *data, int index, int thread);
+
+void Jobs_Init(void);
+void Jobs_Shutdown(void);
+int Jobs_NumThreads(void);
+void Jobs_Run(jobfunc_t func, void *data, int count);
+
+/* for data shared by job functions, both are full memory barriers */
+long Jobs_AtomicAdd(volatile long *value, long add); /* returns the new value */
+long Jobs_CompareExchange(volatile long *value, long comparand,
+		long exchange); /* returns the old value */
+
 /* MISC */
 
 #define ERR_FATAL 0         /* exit the entire game with a popup window */
@@ -749,6 +808,7 @@ extern cvar_t *log_stats;
 
 /* External entity files. */
 extern cvar_t *sv_entfile;
+extern cvar_t *sv_eventloop;
 
 /* Hack for portable client */
 extern qboolean is_portable;
@@ -0,0 +1,342 @@
+/*
+ * Copyright (C) 1997-2001 Id Software, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ * =======================================================================
+ *
+ * A small pool of worker threads. Jobs_Run() is a parallel for loop,
+ * the calling thread works on the loop, too, and the call returns
+ * after all indices were processed. There's no job queue, everything
+ * outside Jobs_Run() stays single threaded.
+ *
+ * =======================================================================
+ */
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#include "header/common.h"
+
+#ifdef _WIN32
+typedef HANDLE jobthread_t;
+typedef CRITICAL_SECTION jobmutex_t;
+typedef CONDITION_VARIABLE jobcond_t;
+
+#define Jobs_Lock(m) EnterCriticalSection(m)
+#define Jobs_Unlock(m) LeaveCriticalSection(m)
+#define Jobs_Wait(c, m) SleepConditionVariableCS(c, m, INFINITE)
+#define Jobs_Broadcast(c) WakeAllConditionVariable(c)
+#define Jobs_AtomicIncrement(v) (InterlockedIncrement(v) - 1)
+#define Jobs_AtomicAddFetch(v, n) (InterlockedExchangeAdd(v, n) + (n))
+#define Jobs_CAS(v, c, e) InterlockedCompareExchange(v, e, c)
+#else
+typedef pthread_t jobthread_t;
+typedef pthread_mutex_t jobmutex_t;
+typedef pthread_cond_t jobcond_t;
+
+#define Jobs_Lock(m) pthread_mutex_lock(m)
+#define Jobs_Unlock(m) pthread_mutex_unlock(m)
+#define Jobs_Wait(c, m) pthread_cond_wait(c, m)
+#define Jobs_Broadcast(c) pthread_cond_broadcast(c)
+#define Jobs_AtomicIncrement(v) __sync_fetch_and_add(v, 1)
+#define Jobs_AtomicAddFetch(v, n) __sync_add_and_fetch(v, n)
+#define Jobs_CAS(v, c, e) __sync_val_compare_and_swap(v, c, e)
+#endif
+
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+typedef struct
+{
+	qboolean initialized;
+	int numthreads; /* including the calling thread */
+	jobthread_t threads[MAX_JOB_THREADS];
+
+	jobmutex_t lock;
+	jobcond_t wake;
+	jobcond_t done;
+
+	/* the current loop */
+	jobfunc_t func;
+	void *data;
+	int count;
+	volatile long next;
+
+	int generation;
+	int busy;
+	qboolean quit;
+	qboolean running;
+} jobs_t;
+
+static jobs_t jobs;
+
+/* thread index of the executing thread, 0 for the main thread */
+static THREAD_LOCAL int jobs_thread;
+
+cvar_t *jobs_threads;
+
+static void
+Jobs_Work(int thread)
+{
+	int i;
+
+	while ((i = (int)Jobs_AtomicIncrement(&jobs.next)) < jobs.count)
+	{
+		jobs.func(jobs.data, i, thread);
+	}
+}
+
+#ifdef _WIN32
+static DWORD WINAPI
+#else
+static void *
+#endif
+Jobs_Thread(void *arg)
+{
+	int thread;
+	int generation;
+
+	thread = (int)(size_t)arg;
+	generation = 0;
+
+	jobs_thread = thread;
+
+	while (1)
+	{
+		Jobs_Lock(&jobs.lock);
+
+		while (!jobs.quit && (jobs.generation == generation))
+		{
+			Jobs_Wait(&jobs.wake, &jobs.lock);
+		}
+
+		generation = jobs.generation;
+
+		if (jobs.quit)
+		{
+			Jobs_Unlock(&jobs.lock);
+			break;
+		}
+
+		Jobs_Unlock(&jobs.lock);
+
+		Jobs_Work(thread);
+
+		Jobs_Lock(&jobs.lock);
+
+		if (--jobs.busy == 0)
+		{
+			Jobs_Broadcast(&jobs.done);
+		}
+
+		Jobs_Unlock(&jobs.lock);
+	}
+
+	return 0;
+}
+
+static int
+Jobs_NumCPUs(void)
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+
+	GetSystemInfo(&info);
+
+	return (int)info.dwNumberOfProcessors;
+#else
+	long n;
+
+	n = sysconf(_SC_NPROCESSORS_ONLN);
+
+	return n > 0 ? (int)n : 1;
+#endif
+}
+
+void
+Jobs_Init(void)
+{
+	int i, numthreads;
+
+	jobs_threads = Cvar_Get("jobs_threads", "0", CVAR_ARCHIVE | CVAR_NOSET);
+
+	numthreads = (int)jobs_threads->value;
+
+	if (numthreads <= 0)
+	{
+		numthreads = Jobs_NumCPUs();
+	}
+
+	if (numthreads > MAX_JOB_THREADS)
+	{
+		numthreads = MAX_JOB_THREADS;
+	}
+
+	memset(&jobs, 0, sizeof(jobs));
+	jobs.numthreads = 1;
+
+#ifdef _WIN32
+	InitializeCriticalSection(&jobs.lock);
+	InitializeConditionVariable(&jobs.wake);
+	InitializeConditionVariable(&jobs.done);
+#else
+	pthread_mutex_init(&jobs.lock, NULL);
+	pthread_cond_init(&jobs.wake, NULL);
+	pthread_cond_init(&jobs.done, NULL);
+#endif
+
+	jobs.initialized = true;
+
+	for (i = 1; i < numthreads; i++)
+	{
+#ifdef _WIN32
+		jobs.threads[i] = CreateThread(NULL, 0, Jobs_Thread, (void *)(size_t)i, 0, NULL);
+
+		if (!jobs.threads[i])
+		{
+			break;
+		}
+#else
+		if (pthread_create(&jobs.threads[i], NULL, Jobs_Thread, (void *)(size_t)i) != 0)
+		{
+			break;
+		}
+#endif
+
+		jobs.numthreads++;
+	}
+
+	Com_Printf("Job system: %i thread%s.\n", jobs.numthreads,
+			jobs.numthreads == 1 ? "" : "s");
+}
+
+void
+Jobs_Shutdown(void)
+{
+	int i;
+
+	if (!jobs.initialized)
+	{
+		return;
+	}
+
+	Jobs_Lock(&jobs.lock);
+	jobs.quit = true;
+	Jobs_Broadcast(&jobs.wake);
+	Jobs_Unlock(&jobs.lock);
+
+	for (i = 1; i < jobs.numthreads; i++)
+	{
+#ifdef _WIN32
+		WaitForSingleObject(jobs.threads[i], INFINITE);
+		CloseHandle(jobs.threads[i]);
+#else
+		pthread_join(jobs.threads[i], NULL);
+#endif
+	}
+
+#ifdef _WIN32
+	DeleteCriticalSection(&jobs.lock);
+#else
+	pthread_cond_destroy(&jobs.done);
+	pthread_cond_destroy(&jobs.wake);
+	pthread_mutex_destroy(&jobs.lock);
+#endif
+
+	memset(&jobs, 0, sizeof(jobs));
+}
+
+int
+Jobs_NumThreads(void)
+{
+	return jobs.numthreads > 0 ? jobs.numthreads : 1;
+}
+
+/*
+ * Calls func(data, i, thread) for every i in 0 <= i < count,
+ * spread over all threads of the pool. thread is unique for
+ * each concurrently running call, 0 <= thread < Jobs_NumThreads(),
+ * and can be used to select per thread scratch data. Returns
+ * after all calls finished. Nested calls run serially on the
+ * calling thread and get its thread index, so they don't share
+ * scratch data with another thread.
+ */
+void
+Jobs_Run(jobfunc_t func, void *data, int count)
+{
+	int i;
+
+	if ((jobs.numthreads <= 1) || (count <= 1) || jobs.running)
+	{
+		for (i = 0; i < count; i++)
+		{
+			func(data, i, jobs_thread);
+		}
+
+		return;
+	}
+
+	Jobs_Lock(&jobs.lock);
+
+	jobs.running = true;
+	jobs.func = func;
+	jobs.data = data;
+	jobs.count = count;
+	jobs.next = 0;
+	jobs.busy = jobs.numthreads - 1;
+	jobs.generation++;
+
+	Jobs_Broadcast(&jobs.wake);
+	Jobs_Unlock(&jobs.lock);
+
+	Jobs_Work(0);
+
+	Jobs_Lock(&jobs.lock);
+
+	while (jobs.busy > 0)
+	{
+		Jobs_Wait(&jobs.done, &jobs.lock);
+	}
+
+	jobs.running = false;
+	Jobs_Unlock(&jobs.lock);
+}
+
+long
+Jobs_AtomicAdd(volatile long *value, long add)
+{
+	return Jobs_AtomicAddFetch(value, add);
+}
+
+/*
+ * Sets *value to exchange if it's comparand.
+ * Returns the value before, comparand if the
+ * exchange happened.
+ */
+long
+Jobs_CompareExchange(volatile long *value, long comparand, long exchange)
+{
+	return Jobs_CAS(value, comparand, exchange);
+}
@@ -36,6 +36,37 @@ static float enemy_yaw;
 qboolean FindTarget(edict_t *self);
 qboolean ai_checkattack(edict_t *self);
 
+/*
+ * Line of sight traces prefetched by AI_PrefetchTraces().
+ * Their world part only depends on the map, so it's
+ * computed for all monsters at once on the engines job
+ * threads. The entity part is added when the trace is
+ * really done, in edict order as before.
+ */
+#define AI_MAX_PREFETCH 3
+
+#define MASK_SHOT_CLEAR (CONTENTS_SOLID | CONTENTS_MONSTER | \
+		CONTENTS_SLIME | CONTENTS_LAVA | CONTENTS_WINDOW)
+
+typedef struct
+{
+	vec3_t start;
+	vec3_t end;
+	int contentmask;
+	trace_t trace;
+} aitrace_t;
+
+typedef struct
+{
+	int numtraces;
+	aitrace_t traces[AI_MAX_PREFETCH];
+} aiprefetch_t;
+
+/* allocated on first use, indexed by edict number */
+static aiprefetch_t *ai_prefetch;
+static edict_t **ai_prefetchents;
+static qboolean ai_prefetchactive;
+
 /*
  * Called once each frame to set level.sight_client
  * to the player to be checked for in findtarget.
@@ -331,6 +362,167 @@ range(edict_t *self, edict_t *other)
 	return RANGE_FAR;
 }
 
+static void
+AI_AddPrefetch(aiprefetch_t *prefetch, edict_t *self, edict_t *other,
+		int contentmask)
+{
+	aitrace_t *t;
+
+	if (!other || !other->inuse || (prefetch->numtraces == AI_MAX_PREFETCH))
+	{
+		return;
+	}
+
+	t = &prefetch->traces[prefetch->numtraces++];
+
+	VectorCopy(self->s.origin, t->start);
+	t->start[2] += self->viewheight;
+	VectorCopy(other->s.origin, t->end);
+	t->end[2] += other->viewheight;
+	t->contentmask = contentmask;
+}
+
+static void
+AI_PrefetchJob(void *data, int index, int thread)
+{
+	aiprefetch_t *prefetch;
+	aitrace_t *t;
+	int i;
+
+	prefetch = &ai_prefetch[((edict_t **)data)[index] - g_edicts];
+
+	for (i = 0; i < prefetch->numtraces; i++)
+	{
+		t = &prefetch->traces[i];
+		t->trace = gi.trace_world(t->start, vec3_origin, vec3_origin,
+				t->end, t->contentmask, thread);
+	}
+}
+
+/*
+ * Called by G_RunFrame() before the entities
+ * think. Computes the world part of the traces
+ * visible() and M_CheckAttack() are likely to
+ * do this frame.
+ */
+void
+AI_PrefetchTraces(void)
+{
+	edict_t *ent;
+	aiprefetch_t *prefetch;
+	int i, num;
+
+	ai_prefetchactive = false;
+
+	if (!g_parallelthink || !g_parallelthink->value || !gi.RunJobs ||
+		!gi.trace_world || !gi.trace_entities)
+	{
+		return;
+	}
+
+	if (!ai_prefetch)
+	{
+		ai_prefetch = gi.TagMalloc(game.maxentities * sizeof(ai_prefetch[0]),
+				TAG_GAME);
+		ai_prefetchents = gi.TagMalloc(game.maxentities *
+				sizeof(ai_prefetchents[0]), TAG_GAME);
+	}
+
+	num = 0;
+
+	for (i = 1; i < globals.num_edicts; i++)
+	{
+		ent = &g_edicts[i];
+		prefetch = &ai_prefetch[i];
+		prefetch->numtraces = 0;
+
+		if (!ent->inuse || !(ent->svflags & SVF_MONSTER) ||
+			(ent->health <= 0))
+		{
+			continue;
+		}
+
+		if (ent->enemy && ent->enemy->inuse)
+		{
+			AI_AddPrefetch(prefetch, ent, ent->enemy, MASK_OPAQUE);
+			AI_AddPrefetch(prefetch, ent, ent->enemy, MASK_SHOT_CLEAR);
+		}
+
+		if (level.sight_client && (level.sight_client != ent->enemy))
+		{
+			AI_AddPrefetch(prefetch, ent, level.sight_client, MASK_OPAQUE);
+		}
+
+		if (prefetch->numtraces)
+		{
+			ai_prefetchents[num++] = ent;
+		}
+	}
+
+	gi.RunJobs(AI_PrefetchJob, ai_prefetchents, num);
+
+	ai_prefetchactive = true;
+}
+
+/*
+ * Called by G_RunFrame() after all entities
+ * ran, the prefetched traces are outdated.
+ */
+void
+AI_ClearPrefetch(void)
+{
+	ai_prefetchactive = false;
+}
+
+/*
+ * Called after TAG_GAME was freed, the
+ * buffers are allocated again on use.
+ */
+void
+AI_FreePrefetch(void)
+{
+	ai_prefetch = NULL;
+	ai_prefetchents = NULL;
+	ai_prefetchactive = false;
+}
+
+/*
+ * A point trace from start to end, like done by
+ * visible() and M_CheckAttack(). Returns exactly
+ * what gi.trace() would return, but uses the
+ * prefetched world part if there's one.
+ */
+static trace_t
+AI_Trace(edict_t *self, vec3_t start, vec3_t end, int contentmask)
+{
+	aiprefetch_t *prefetch;
+	aitrace_t *t;
+	int i, num;
+
+	num = self - g_edicts;
+
+	if (ai_prefetchactive && (num > 0) && (num < game.maxentities))
+	{
+		prefetch = &ai_prefetch[num];
+
+		for (i = 0; i < prefetch->numtraces; i++)
+		{
+			t = &prefetch->traces[i];
+
+			/* compare the bits, the result must not differ */
+			if ((t->contentmask == contentmask) &&
+				!memcmp(t->start, start, sizeof(vec3_t)) &&
+				!memcmp(t->end, end, sizeof(vec3_t)))
+			{
+				return gi.trace_entities(&t->trace, start, vec3_origin,
+						vec3_origin, end, self, contentmask);
+			}
+		}
+	}
+
+	return gi.trace(start, vec3_origin, vec3_origin, end, self, contentmask);
+}
+
 /*
  * returns 1 if the entity is visible
  * to self, even if not infront
@@ -351,7 +543,7 @@ visible(edict_t *self, edict_t *other)
 	spot1[2] += self->viewheight;
 	VectorCopy(other->s.origin, spot2);
 	spot2[2] += other->viewheight;
-	trace = gi.trace(spot1, vec3_origin, vec3_origin, spot2, self, MASK_OPAQUE);
+	trace = AI_Trace(self, spot1, spot2, MASK_OPAQUE);
 
 	if (trace.fraction == 1.0)
 	{
@@ -755,9 +947,7 @@ M_CheckAttack(edict_t *self)
 		VectorCopy(self->enemy->s.origin, spot2);
 		spot2[2] += self->enemy->viewheight;
 
-		tr = gi.trace(spot1, NULL, NULL, spot2, self,
-				CONTENTS_SOLID | CONTENTS_MONSTER | CONTENTS_SLIME |
-				CONTENTS_LAVA | CONTENTS_WINDOW);
+		tr = AI_Trace(self, spot1, spot2, MASK_SHOT_CLEAR);
 
 		/* do we have a clear shot? */
 		if (tr.ent != self->enemy)
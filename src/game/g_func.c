@@ -2110,6 +2110,7 @@ SP_func_water(edict_t *self)
 	}
 
 	self->classname = "func_door";
+	G_IndexEdict(self);
 
 	gi.linkentity(self);
 }
@@ -2966,6 +2967,7 @@ SP_func_door_secret(edict_t *ent)
 	}
 
 	ent->classname = "func_door";
+	G_IndexEdict(ent);
 
 	gi.linkentity(ent);
 }
@@ -88,6 +88,8 @@ cvar_t *gib_on;
 
 cvar_t *aimfix;
 cvar_t *g_machinegun_norecoil;
+cvar_t *g_parallelthink;
+cvar_t *g_savecompression;
 
 void G_RunFrame(void);
 
@@ -100,6 +102,7 @@ ShutdownGame(void)
 
 	gi.FreeTags(TAG_LEVEL);
 	gi.FreeTags(TAG_GAME);
+	AI_FreePrefetch();
 }
 
 /*
@@ -146,6 +149,7 @@ Q2_DLL_EXPORTED game_export_t *
 GetGameAPI(game_import_t *import)
 {
 	gi = *import;
+	G_InitFindRadius();
 
 	globals.apiversion = GAME_API_VERSION;
 	globals.Init = InitGame;
@@ -464,6 +468,9 @@ G_RunFrame(void)
 		return;
 	}
 
+	/* line of sight traces for the monsters */
+	AI_PrefetchTraces();
+
 	/* treat each object in turn
 	   even the world gets a chance
 	   to think */
@@ -502,6 +509,8 @@ G_RunFrame(void)
 		G_RunEntity(ent);
 	}
 
+	AI_ClearPrefetch();
+
 	/* see if it is time to end a deathmatch */
 	CheckDMRules();
 
@@ -399,6 +399,12 @@ ED_ParseField(const char *key, const char *value, edict_t *ent)
 			{
 				case F_LSTRING:
 					*(char **)(b + f->ofs) = ED_NewString(value);
+
+					if (b == (byte *)ent)
+					{
+						G_IndexEdict(ent);
+					}
+
 					break;
 				case F_VECTOR:
 					sscanf(value, "%f %f %f", &vec[0], &vec[1], &vec[2]);
@@ -613,6 +619,7 @@ SpawnEntities(const char *mapname, char *entities, const char *spawnpoint)
 
 	memset(&level, 0, sizeof(level));
 	memset(g_edicts, 0, game.maxentities * sizeof(g_edicts[0]));
+	G_ClearFindIndex();
 
 	Q_strlcpy(level.mapname, mapname, sizeof(level.mapname));
 	Q_strlcpy(game.spawnpoint, spawnpoint, sizeof(game.spawnpoint));
@@ -868,6 +875,7 @@ SP_worldspawn(edict_t *ent)
 	ent->solid = SOLID_BSP;
 	ent->inuse = true; /* since the world doesn't use G_Spawn() */
 	ent->s.modelindex = 1; /* world model is always index 1 */
+	G_IndexEdict(ent);
 
 	/* --------------- */
 
@@ -19,7 +19,7 @@
  *
  * =======================================================================
  *
- * Game side of server CMDs. At this time only the ipfilter.
+ * Game side of server CMDs. The ipfilter and some debug helpers.
  *
  * =======================================================================
  */
@@ -312,6 +312,89 @@ SVCmd_WriteIP_f(void)
 	fclose(f);
 }
 
+/*
+ * sv rockets [count]
+ *
+ * Fires count (default 500) rockets into random directions from the
+ * first player or the singleplayer spawn point. Each
+ * explosion does radius damage, this is used to check
+ * how findradius() scales with the number of edicts.
+ */
+void
+SVCmd_Rockets_f(void)
+{
+	edict_t *owner, *spot;
+	vec3_t start, dir;
+	int i, count, max;
+
+	count = 500;
+
+	if ((gi.argc() > 2) && gi.argv(2)[0])
+	{
+		count = (int)strtol(gi.argv(2), NULL, 10);
+	}
+
+	/* leave some room for gibs, debris and the like */
+	max = game.maxentities - globals.num_edicts - 128;
+
+	if (count > max)
+	{
+		count = max;
+	}
+
+	if (count <= 0)
+	{
+		gi.cprintf(NULL, PRINT_HIGH, "No free edicts for rockets.\n");
+		return;
+	}
+
+	spot = &g_edicts[1];
+
+	if (!spot->inuse || !spot->client)
+	{
+		spot = G_Find(NULL, FOFS(classname), "info_player_start");
+	}
+
+	if (!spot)
+	{
+		spot = G_Find(NULL, FOFS(classname), "info_player_deathmatch");
+	}
+
+	if (!spot)
+	{
+		gi.cprintf(NULL, PRINT_HIGH, "No place to fire the rockets from.\n");
+		return;
+	}
+
+	VectorCopy(spot->s.origin, start);
+	start[2] += 16;
+
+	/* rockets don't explode when touching their owner,
+	   so the world can't be the owner */
+	owner = G_Spawn();
+	owner->classname = "rocket_launcher";
+	VectorCopy(start, owner->s.origin);
+	owner->think = G_FreeEdict;
+	owner->nextthink = level.time + 20;
+
+	for (i = 0; i < count; i++)
+	{
+		dir[0] = crandom();
+		dir[1] = crandom();
+		dir[2] = crandom();
+
+		if (VectorNormalize(dir) == 0)
+		{
+			dir[0] = 1;
+		}
+
+		fire_rocket(owner, start, dir, 100, 650, 120, 120);
+	}
+
+	gi.cprintf(NULL, PRINT_HIGH, "%i rockets fired, %i edicts in use.\n",
+			count, globals.num_edicts);
+}
+
 /*
  * ServerCommand will be called when an "sv" command is issued.
  * The game can issue gi.argc() / gi.argv() commands to get the rest
@@ -344,6 +427,10 @@ ServerCommand(void)
 	{
 		SVCmd_WriteIP_f();
 	}
+	else if (Q_stricmp(cmd, "rockets") == 0)
+	{
+		SVCmd_Rockets_f();
+	}
 	else
 	{
 		gi.cprintf(NULL, PRINT_HIGH, "Unknown server command \"%s\"\n", cmd);
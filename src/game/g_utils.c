@@ -24,6 +24,8 @@
  * =======================================================================
  */
 
+#include <ctype.h>
+
 #include "header/local.h"
 
 #define MAXCHOICES 8
@@ -38,6 +40,205 @@ G_ProjectSource(vec3_t point, vec3_t distance, vec3_t forward,
 				distance[2];
 }
 
+/*
+ * Hash index for G_Find() on the classname, targetname
+ * and team fields. Edicts are added to a queue when
+ * they're spawned, freed or one of the fields is set
+ * by the entity parser or G_IndexEdict(). The queue
+ * is worked off by the next G_Find() call, so all the
+ * field assignments after G_Spawn() are catched. Each
+ * hit is checked again, edicts which were renamed
+ * without calling G_IndexEdict() are never returned
+ * with their old name.
+ */
+#define FIND_HASH_SIZE 1024 /* must be a power of two */
+#define FIND_NUM_FIELDS 3
+
+typedef struct
+{
+	int fieldofs;
+	int buckets[FIND_HASH_SIZE];
+
+	/* per edict, -1 if not in the index */
+	int bucket[MAX_EDICTS];
+	int next[MAX_EDICTS];
+	int prev[MAX_EDICTS];
+} findindex_t;
+
+static findindex_t find_index[FIND_NUM_FIELDS];
+static int find_queue[MAX_EDICTS];
+static int find_queuelen;
+static qboolean find_queued[MAX_EDICTS];
+static qboolean find_active;
+
+static unsigned int
+G_FindHash(const char *s)
+{
+	unsigned int hash;
+
+	hash = 0;
+
+	while (*s)
+	{
+		hash = hash * 31 + tolower((unsigned char)*s);
+		s++;
+	}
+
+	return hash & (FIND_HASH_SIZE - 1);
+}
+
+static findindex_t *
+G_FindIndexForField(int fieldofs)
+{
+	int i;
+
+	if (!find_active)
+	{
+		return NULL;
+	}
+
+	for (i = 0; i < FIND_NUM_FIELDS; i++)
+	{
+		if (find_index[i].fieldofs == fieldofs)
+		{
+			return &find_index[i];
+		}
+	}
+
+	return NULL;
+}
+
+static void
+G_FindUnlink(findindex_t *index, int num)
+{
+	if (index->bucket[num] == -1)
+	{
+		return;
+	}
+
+	if (index->prev[num] != -1)
+	{
+		index->next[index->prev[num]] = index->next[num];
+	}
+	else
+	{
+		index->buckets[index->bucket[num]] = index->next[num];
+	}
+
+	if (index->next[num] != -1)
+	{
+		index->prev[index->next[num]] = index->prev[num];
+	}
+
+	index->bucket[num] = -1;
+}
+
+static void
+G_FindLink(findindex_t *index, int num)
+{
+	char *s;
+	int hash;
+
+	G_FindUnlink(index, num);
+
+	if (!g_edicts[num].inuse)
+	{
+		return;
+	}
+
+	s = *(char **)((byte *)&g_edicts[num] + index->fieldofs);
+
+	if (!s)
+	{
+		return;
+	}
+
+	hash = G_FindHash(s);
+
+	index->bucket[num] = hash;
+	index->prev[num] = -1;
+	index->next[num] = index->buckets[hash];
+
+	if (index->buckets[hash] != -1)
+	{
+		index->prev[index->buckets[hash]] = num;
+	}
+
+	index->buckets[hash] = num;
+}
+
+static void
+G_FlushFindIndex(void)
+{
+	int i, j, num;
+
+	for (i = 0; i < find_queuelen; i++)
+	{
+		num = find_queue[i];
+		find_queued[num] = false;
+
+		for (j = 0; j < FIND_NUM_FIELDS; j++)
+		{
+			G_FindLink(&find_index[j], num);
+		}
+	}
+
+	find_queuelen = 0;
+}
+
+/*
+ * Empties the G_Find() index. Must be called
+ * whenever all edicts are wiped.
+ */
+void
+G_ClearFindIndex(void)
+{
+	int i;
+
+	/* without a bound the index would need dynamic memory */
+	find_active = (game.maxentities <= MAX_EDICTS);
+
+	find_index[0].fieldofs = FOFS(classname);
+	find_index[1].fieldofs = FOFS(targetname);
+	find_index[2].fieldofs = FOFS(team);
+
+	for (i = 0; i < FIND_NUM_FIELDS; i++)
+	{
+		memset(find_index[i].buckets, -1, sizeof(find_index[i].buckets));
+		memset(find_index[i].bucket, -1, sizeof(find_index[i].bucket));
+	}
+
+	memset(find_queued, 0, sizeof(find_queued));
+	find_queuelen = 0;
+}
+
+/*
+ * Must be called after the classname, targetname
+ * or team of an edict that's already in use was
+ * changed, otherwise G_Find() won't find the
+ * edict by the new name.
+ */
+void
+G_IndexEdict(edict_t *ent)
+{
+	int num;
+
+	if (!find_active || !ent)
+	{
+		return;
+	}
+
+	num = ent - g_edicts;
+
+	if ((num < 0) || (num >= MAX_EDICTS) || find_queued[num])
+	{
+		return;
+	}
+
+	find_queued[num] = true;
+	find_queue[find_queuelen++] = num;
+}
+
 /*
  * Searches all active entities for the next
  * one that holds the matching string at fieldofs
@@ -50,7 +251,10 @@ G_ProjectSource(vec3_t point, vec3_t distance, vec3_t forward,
 edict_t *
 G_Find(edict_t *from, int fieldofs, char *match)
 {
+	findindex_t *index;
+	edict_t *best;
 	char *s;
+	int i, first;
 
 	if (!from)
 	{
@@ -66,6 +270,40 @@ G_Find(edict_t *from, int fieldofs, char *match)
 		return NULL;
 	}
 
+	index = G_FindIndexForField(fieldofs);
+
+	if (index)
+	{
+		G_FlushFindIndex();
+
+		/* the bucket isn't sorted, look for
+		   the lowest matching edict after from */
+		first = from - g_edicts;
+		best = NULL;
+
+		for (i = index->buckets[G_FindHash(match)]; i != -1; i = index->next[i])
+		{
+			if ((i < first) || (best && (&g_edicts[i] > best)))
+			{
+				continue;
+			}
+
+			if (!g_edicts[i].inuse)
+			{
+				continue;
+			}
+
+			s = *(char **)((byte *)&g_edicts[i] + fieldofs);
+
+			if (s && !Q_stricmp(s, match))
+			{
+				best = &g_edicts[i];
+			}
+		}
+
+		return best;
+	}
+
 	for ( ; from < &g_edicts[globals.num_edicts]; from++)
 	{
 		if (!from->inuse)
@@ -90,15 +328,78 @@ G_Find(edict_t *from, int fieldofs, char *match)
 }
 
 /*
- * Returns entities that have origins
- * within a spherical area
+ * findradius() keeps the result of its last query. The
+ * loops calling it for every returned entity continue
+ * with that list instead of querying again each time.
+ * Once an edict was linked, e.g. a gib spawned by a
+ * monster the loop killed, the query is done again,
+ * so the loop sees the same entities as a fresh query.
  */
-edict_t *
-findradius(edict_t *from, vec3_t org, float rad)
+static struct
+{
+	vec3_t org;
+	float rad;
+	edict_t *list[MAX_EDICTS + 1]; /* +1 for the world */
+	int num;
+	int next; /* the entry after the one returned last */
+	edict_t *last; /* returned last, NULL if the query ended */
+	int links; /* radius_links at the time of the query */
+	int numedicts; /* globals.num_edicts at the time of the query */
+} radius_query;
+
+static int radius_links;
+static void (*radius_linkentity)(edict_t *ent);
+
+static void
+findradius_linkentity(edict_t *ent)
+{
+	radius_links++;
+	radius_linkentity(ent);
+}
+
+/*
+ * Called by GetGameAPI(), counts the
+ * calls to gi.linkentity().
+ */
+void
+G_InitFindRadius(void)
+{
+	radius_linkentity = gi.linkentity;
+	gi.linkentity = findradius_linkentity;
+}
+
+static qboolean
+findradius_test(edict_t *ent, vec3_t org, float rad)
 {
 	vec3_t eorg;
 	int j;
 
+	if (!ent->inuse)
+	{
+		return false;
+	}
+
+	if (ent->solid == SOLID_NOT)
+	{
+		return false;
+	}
+
+	for (j = 0; j < 3; j++)
+	{
+		eorg[j] = org[j] - (ent->s.origin[j] +
+				   (ent->mins[j] + ent->maxs[j]) * 0.5);
+	}
+
+	return VectorLength(eorg) <= rad;
+}
+
+/*
+ * Walks over all edicts, for more
+ * edicts than the index can hold
+ */
+static edict_t *
+findradius_scan(edict_t *from, vec3_t org, float rad)
+{
 	if (!from)
 	{
 		from = g_edicts;
@@ -110,31 +411,87 @@ findradius(edict_t *from, vec3_t org, float rad)
 
 	for ( ; from < &g_edicts[globals.num_edicts]; from++)
 	{
-		if (!from->inuse)
+		if (findradius_test(from, org, rad))
 		{
-			continue;
+			return from;
 		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Returns entities that have origins
+ * within a spherical area
+ */
+edict_t *
+findradius(edict_t *from, vec3_t org, float rad)
+{
+	edict_t *ent;
+
+	if ((game.maxentities > MAX_EDICTS) || !gi.RadiusEdicts)
+	{
+		return findradius_scan(from, org, rad);
+	}
 
-		if (from->solid == SOLID_NOT)
+	/* a new query, another one ran since
+	   or an edict was linked since */
+	if (!from || (from != radius_query.last) ||
+		!VectorCompare(org, radius_query.org) || (rad != radius_query.rad) ||
+		(radius_links != radius_query.links))
+	{
+		VectorCopy(org, radius_query.org);
+		radius_query.rad = rad;
+		radius_query.links = radius_links;
+		radius_query.numedicts = globals.num_edicts;
+		radius_query.num = 0;
+		radius_query.next = 0;
+
+		/* the world isn't in the servers spatial index */
+		if (findradius_test(g_edicts, org, rad))
 		{
-			continue;
+			radius_query.list[radius_query.num++] = g_edicts;
 		}
 
-		for (j = 0; j < 3; j++)
+		/* sorted by edict number */
+		radius_query.num += gi.RadiusEdicts(org, rad,
+				radius_query.list + radius_query.num, MAX_EDICTS);
+	}
+
+	while (radius_query.next < radius_query.num)
+	{
+		ent = radius_query.list[radius_query.next++];
+
+		if (from && (ent <= from))
 		{
-			eorg[j] = org[j] - (from->s.origin[j] +
-					   (from->mins[j] + from->maxs[j]) * 0.5);
+			continue;
 		}
 
-		if (VectorLength(eorg) > rad)
+		/* the caller may have changed it since the query */
+		if (!findradius_test(ent, org, rad))
 		{
 			continue;
 		}
 
-		return from;
+		radius_query.last = ent;
+
+		return ent;
 	}
 
-	return NULL;
+	/* edicts spawned into new slots since the query
+	   and not linked yet aren't in the index, they
+	   are numbered after all edicts it has seen */
+	ent = &g_edicts[radius_query.numedicts - 1];
+
+	if (from && (from > ent))
+	{
+		ent = from;
+	}
+
+	ent = findradius_scan(ent, org, rad);
+	radius_query.last = ent;
+
+	return ent;
 }
 
 /*
@@ -496,6 +853,8 @@ G_InitEdict(edict_t *e)
 	e->classname = "noclass";
 	e->gravity = 1.0;
 	e->s.number = e - g_edicts;
+
+	G_IndexEdict(e);
 }
 
 /*
@@ -589,6 +948,8 @@ G_FreeEdict(edict_t *ed)
 	ed->classname = "freed";
 	ed->freetime = level.time;
 	ed->inuse = false;
+
+	G_IndexEdict(ed);
 }
 
 void
@@ -181,6 +181,29 @@ typedef struct
 	void (*AddCommandString)(char *text);
 
 	void (*DebugGraph)(float value, int color);
+
+	/* optional, appended without changing GAME_API_VERSION
+	   so existing games and mods keep loading. The game
+	   must check them for NULL before using them. */
+
+	/* calls func(data, index, thread) for 0 <= index < count on
+	   the engines worker threads and returns when all are done.
+	   Only trace_world() may be called from func. */
+	void (*RunJobs)(void (*func)(void *data, int index, int thread),
+			void *data, int count);
+
+	/* trace() in two steps: trace_world() only clips against the
+	   world and is thread safe, trace_entities() finishes its
+	   result and returns exactly what trace() would return */
+	trace_t (*trace_world)(vec3_t start, vec3_t mins, vec3_t maxs,
+			vec3_t end, int contentmask, int thread);
+	trace_t (*trace_entities)(trace_t *world, vec3_t start, vec3_t mins,
+			vec3_t maxs, vec3_t end, edict_t *passent, int contentmask);
+
+	/* linked solid and trigger edicts with their bounding box
+	   center within radius of org, sorted by edict number */
+	int (*RadiusEdicts)(vec3_t org, float radius, edict_t **list,
+			int maxcount);
 } game_import_t;
 
 /* functions exported by the game subsystem */
@@ -551,6 +551,8 @@ extern cvar_t *sv_maplist;
 
 extern cvar_t *aimfix;
 extern cvar_t *g_machinegun_norecoil;
+extern cvar_t *g_parallelthink;
+extern cvar_t *g_savecompression;
 
 #define world (&g_edicts[0])
 
@@ -632,7 +634,10 @@ qboolean KillBox(edict_t *ent);
 void G_ProjectSource(vec3_t point, vec3_t distance, vec3_t forward,
 		vec3_t right, vec3_t result);
 edict_t *G_Find(edict_t *from, int fieldofs, char *match);
+void G_ClearFindIndex(void);
+void G_IndexEdict(edict_t *ent);
 edict_t *findradius(edict_t *from, vec3_t org, float rad);
+void G_InitFindRadius(void);
 edict_t *G_PickTarget(char *targetname);
 void G_UseTargets(edict_t *ent, edict_t *activator);
 void G_SetMovedir(vec3_t angles, vec3_t movedir);
@@ -719,6 +724,9 @@ void BecomeExplosion1(edict_t *self);
 
 /* g_ai.c */
 void AI_SetSightClient(void);
+void AI_PrefetchTraces(void);
+void AI_ClearPrefetch(void);
+void AI_FreePrefetch(void);
 
 void ai_stand(edict_t *self, float dist);
 void ai_move(edict_t *self, float dist);
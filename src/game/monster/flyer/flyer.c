@@ -832,6 +832,7 @@ SP_monster_flyer(edict_t *self)
 	{
 		self->targetname = self->target;
 		self->target = NULL;
+		G_IndexEdict(self);
 	}
 
 	sound_sight = gi.soundindex("flyer/flysght1.wav");
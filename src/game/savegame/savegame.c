@@ -64,7 +64,10 @@
  * system and architecture are in the hands of the user.
  */
 
+#include <stddef.h>
+
 #include "../header/local.h"
+#include "../../common/unzip/miniz.h"
 #include "savegame.h"
 /*
  * When ever the savegame version is changed, q2 will refuse to
@@ -155,6 +158,8 @@ static mmoveList_t mmoveList[] = {
 	#include "tables/gamemmove_list.h"
 };
 
+static void InitSaveTables(void);
+
 /*
  * Fields to be saved (used in g_spawn.c)
  */
@@ -245,10 +250,15 @@ InitGame(void)
 	/* others */
 	aimfix = gi.cvar("aimfix", "0", CVAR_ARCHIVE);
 	g_machinegun_norecoil = gi.cvar("g_machinegun_norecoil", "0", CVAR_ARCHIVE);
+	g_parallelthink = gi.cvar("g_parallelthink", "0", CVAR_ARCHIVE);
+	g_savecompression = gi.cvar("g_savecompression", "1", CVAR_ARCHIVE);
 
 	/* items */
 	InitItems();
 
+	/* savegame lookup tables */
+	InitSaveTables();
+
 	game.helpmessage1[0] = 0;
 	game.helpmessage2[0] = 0;
 
@@ -257,6 +267,7 @@ InitGame(void)
 	g_edicts = gi.TagMalloc(game.maxentities * sizeof(g_edicts[0]), TAG_GAME);
 	globals.edicts = g_edicts;
 	globals.max_edicts = game.maxentities;
+	G_ClearFindIndex();
 
 	/* initialize all clients for this game */
 	game.maxclients = maxclients->value;
@@ -266,6 +277,124 @@ InitGame(void)
 
 /* ========================================================= */
 
+/*
+ * Hash tables to look up the function and
+ * mmove_t lists by address and by name.
+ * The lists contain some 1000 entries and
+ * every function pointer in every edict is
+ * looked up while saving or loading. The
+ * tables hold the list index + 1, 0 marks
+ * an empty slot. They're never more than
+ * half full.
+ */
+#define NUM_FUNCTIONS (sizeof(functionList) / sizeof(functionList[0]))
+#define NUM_MMOVES (sizeof(mmoveList) / sizeof(mmoveList[0]))
+
+static int functionsByAddress[NUM_FUNCTIONS * 2];
+static int functionsByName[NUM_FUNCTIONS * 2];
+static int mmovesByAddress[NUM_MMOVES * 2];
+static int mmovesByName[NUM_MMOVES * 2];
+
+static unsigned int
+HashSaveName(const char *name)
+{
+	unsigned int hash;
+
+	hash = 5381;
+
+	while (*name)
+	{
+		hash = hash * 33 + (unsigned char)*name;
+		name++;
+	}
+
+	return hash;
+}
+
+static unsigned int
+HashSaveAddress(const void *adr)
+{
+	size_t v;
+
+	v = (size_t)adr;
+
+	return (unsigned int)(v ^ (v >> 16)) * 2654435761u;
+}
+
+/*
+ * Fills both tables for a list of { name, pointer } pairs.
+ * If a name or pointer is in the list more than once the
+ * first one wins, like with the linear search.
+ */
+static void
+HashSaveList(const byte *list, size_t stride, size_t ptrofs, int num,
+		int *byaddress, int *byname)
+{
+	int i, size;
+	unsigned int slot;
+	const char *name;
+	const void *ptr;
+
+	size = num * 2;
+	memset(byaddress, 0, size * sizeof(int));
+	memset(byname, 0, size * sizeof(int));
+
+	for (i = 0; i < num; i++)
+	{
+		name = *(char **)(list + i * stride);
+		ptr = *(void **)(list + i * stride + ptrofs);
+
+		if (!name)
+		{
+			continue;
+		}
+
+		for (slot = HashSaveAddress(ptr) % size; byaddress[slot];
+			 slot = (slot + 1) % size)
+		{
+			if (*(void **)(list + (byaddress[slot] - 1) * stride + ptrofs) == ptr)
+			{
+				break;
+			}
+		}
+
+		if (!byaddress[slot])
+		{
+			byaddress[slot] = i + 1;
+		}
+
+		for (slot = HashSaveName(name) % size; byname[slot];
+			 slot = (slot + 1) % size)
+		{
+			if (!strcmp(*(char **)(list + (byname[slot] - 1) * stride), name))
+			{
+				break;
+			}
+		}
+
+		if (!byname[slot])
+		{
+			byname[slot] = i + 1;
+		}
+	}
+}
+
+/*
+ * Builds the lookup tables
+ * for the functions below.
+ * Called by InitGame.
+ */
+static void
+InitSaveTables(void)
+{
+	HashSaveList((byte *)functionList, sizeof(functionList[0]),
+			offsetof(functionList_t, funcPtr), NUM_FUNCTIONS,
+			functionsByAddress, functionsByName);
+	HashSaveList((byte *)mmoveList, sizeof(mmoveList[0]),
+			offsetof(mmoveList_t, mmovePtr), NUM_MMOVES,
+			mmovesByAddress, mmovesByName);
+}
+
 /*
  * Helper function to get
  * the human readable function
@@ -276,13 +405,16 @@ InitGame(void)
 functionList_t *
 GetFunctionByAddress(byte *adr)
 {
-	int i;
+	unsigned int slot, size;
 
-	for (i = 0; functionList[i].funcStr; i++)
+	size = NUM_FUNCTIONS * 2;
+
+	for (slot = HashSaveAddress(adr) % size; functionsByAddress[slot];
+		 slot = (slot + 1) % size)
 	{
-		if (functionList[i].funcPtr == adr)
+		if (functionList[functionsByAddress[slot] - 1].funcPtr == adr)
 		{
-			return &functionList[i];
+			return &functionList[functionsByAddress[slot] - 1];
 		}
 	}
 
@@ -299,13 +431,16 @@ GetFunctionByAddress(byte *adr)
 byte *
 FindFunctionByName(char *name)
 {
-	int i;
+	unsigned int slot, size;
+
+	size = NUM_FUNCTIONS * 2;
 
-	for (i = 0; functionList[i].funcStr; i++)
+	for (slot = HashSaveName(name) % size; functionsByName[slot];
+		 slot = (slot + 1) % size)
 	{
-		if (!strcmp(name, functionList[i].funcStr))
+		if (!strcmp(name, functionList[functionsByName[slot] - 1].funcStr))
 		{
-			return functionList[i].funcPtr;
+			return functionList[functionsByName[slot] - 1].funcPtr;
 		}
 	}
 
@@ -320,13 +455,16 @@ FindFunctionByName(char *name)
 mmoveList_t *
 GetMmoveByAddress(mmove_t *adr)
 {
-	int i;
+	unsigned int slot, size;
+
+	size = NUM_MMOVES * 2;
 
-	for (i = 0; mmoveList[i].mmoveStr; i++)
+	for (slot = HashSaveAddress(adr) % size; mmovesByAddress[slot];
+		 slot = (slot + 1) % size)
 	{
-		if (mmoveList[i].mmovePtr == adr)
+		if (mmoveList[mmovesByAddress[slot] - 1].mmovePtr == adr)
 		{
-			return &mmoveList[i];
+			return &mmoveList[mmovesByAddress[slot] - 1];
 		}
 	}
 
@@ -341,13 +479,16 @@ GetMmoveByAddress(mmove_t *adr)
 mmove_t *
 FindMmoveByName(char *name)
 {
-	int i;
+	unsigned int slot, size;
 
-	for (i = 0; mmoveList[i].mmoveStr; i++)
+	size = NUM_MMOVES * 2;
+
+	for (slot = HashSaveName(name) % size; mmovesByName[slot];
+		 slot = (slot + 1) % size)
 	{
-		if (!strcmp(name, mmoveList[i].mmoveStr))
+		if (!strcmp(name, mmoveList[mmovesByName[slot] - 1].mmoveStr))
 		{
-			return mmoveList[i].mmovePtr;
+			return mmoveList[mmovesByName[slot] - 1].mmovePtr;
 		}
 	}
 
@@ -355,6 +496,241 @@ FindMmoveByName(char *name)
 }
 
 
+/* ========================================================= */
+
+/*
+ * Savegame files. Up to YQ2-5 the files
+ * were just the data written by the
+ * functions below. Now they start with
+ * the header below, which is followed
+ * by the same data, compressed with
+ * miniz if g_savecompression is set.
+ * The whole file is assembled in memory
+ * and written or read with one call.
+ * Files without the header are still
+ * read as they are.
+ */
+#define SAVEFILE_MAGIC (('S' << 24) + ('2' << 16) + ('Q' << 8) + 'Y') /* "YQ2S" */
+#define SAVEFILE_VERSION 1
+
+#define SAVEFILE_COMPRESSED 1
+
+typedef struct
+{
+	int magic;
+	int version;
+	int flags;
+	int size; /* of the uncompressed data */
+} savefileHeader_t;
+
+static void
+InitSaveBuffer(savebuffer_t *f)
+{
+	memset(f, 0, sizeof(*f));
+
+	f->maxsize = 256 * 1024;
+	f->data = malloc(f->maxsize);
+
+	if (!f->data)
+	{
+		gi.error("Couldn't allocate %i bytes for the savegame", (int)f->maxsize);
+	}
+
+	/* room for the header */
+	f->size = sizeof(savefileHeader_t);
+}
+
+static void
+FreeSaveBuffer(savebuffer_t *f)
+{
+	free(f->data);
+	memset(f, 0, sizeof(*f));
+}
+
+static void
+SaveWrite(savebuffer_t *f, const void *data, size_t len)
+{
+	byte *newdata;
+
+	if (f->size + len > f->maxsize)
+	{
+		while (f->size + len > f->maxsize)
+		{
+			f->maxsize *= 2;
+		}
+
+		newdata = realloc(f->data, f->maxsize);
+
+		if (!newdata)
+		{
+			gi.error("Couldn't allocate %i bytes for the savegame", (int)f->maxsize);
+		}
+
+		f->data = newdata;
+	}
+
+	memcpy(f->data + f->size, data, len);
+	f->size += len;
+}
+
+/*
+ * Returns 1 if len bytes were read,
+ * 0 if the data ended before.
+ */
+static size_t
+SaveRead(savebuffer_t *f, void *data, size_t len)
+{
+	if (f->size - f->pos < len)
+	{
+		memset(data, 0, len);
+		f->pos = f->size;
+
+		return 0;
+	}
+
+	memcpy(data, f->data + f->pos, len);
+	f->pos += len;
+
+	return 1;
+}
+
+static void
+WriteSaveBuffer(savebuffer_t *f, const char *filename)
+{
+	savefileHeader_t header;
+	byte *out, *compressed;
+	mz_ulong len;
+	FILE *file;
+
+	header.magic = SAVEFILE_MAGIC;
+	header.version = SAVEFILE_VERSION;
+	header.flags = 0;
+	header.size = (int)(f->size - sizeof(header));
+
+	out = f->data;
+	len = f->size - sizeof(header);
+	compressed = NULL;
+
+	if (g_savecompression && g_savecompression->value)
+	{
+		len = mz_compressBound(len);
+		compressed = malloc(sizeof(header) + len);
+
+		if (compressed && (mz_compress2(compressed + sizeof(header), &len,
+				f->data + sizeof(header), header.size, MZ_BEST_SPEED) == MZ_OK))
+		{
+			out = compressed;
+			header.flags |= SAVEFILE_COMPRESSED;
+		}
+		else
+		{
+			len = f->size - sizeof(header);
+		}
+	}
+
+	memcpy(out, &header, sizeof(header));
+
+	file = Q_fopen(filename, "wb");
+
+	if (!file)
+	{
+		free(compressed);
+		gi.error("Couldn't open %s", filename);
+	}
+
+	if (fwrite(out, sizeof(header) + len, 1, file) != 1)
+	{
+		fclose(file);
+		free(compressed);
+		gi.error("Couldn't write %s", filename);
+	}
+
+	fclose(file);
+	free(compressed);
+}
+
+static void
+ReadSaveBuffer(savebuffer_t *f, const char *filename)
+{
+	savefileHeader_t header;
+	byte *data;
+	mz_ulong len;
+	FILE *file;
+	long size;
+
+	memset(f, 0, sizeof(*f));
+
+	file = Q_fopen(filename, "rb");
+
+	if (!file)
+	{
+		gi.error("Couldn't open %s", filename);
+	}
+
+	fseek(file, 0, SEEK_END);
+	size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	if (size <= 0)
+	{
+		fclose(file);
+		gi.error("Couldn't read %s", filename);
+	}
+
+	f->data = malloc(size);
+
+	if (!f->data || (fread(f->data, size, 1, file) != 1))
+	{
+		fclose(file);
+		FreeSaveBuffer(f);
+		gi.error("Couldn't read %s", filename);
+	}
+
+	fclose(file);
+
+	f->size = f->maxsize = size;
+
+	if (size < sizeof(header))
+	{
+		return;
+	}
+
+	memcpy(&header, f->data, sizeof(header));
+
+	if (header.magic != SAVEFILE_MAGIC)
+	{
+		return; /* older savegame */
+	}
+
+	if ((header.version > SAVEFILE_VERSION) || (header.size < 0))
+	{
+		FreeSaveBuffer(f);
+		gi.error("%s is from a newer version", filename);
+	}
+
+	if (!(header.flags & SAVEFILE_COMPRESSED))
+	{
+		f->pos = sizeof(header);
+		return;
+	}
+
+	len = header.size;
+	data = malloc(header.size ? header.size : 1);
+
+	if (!data || (mz_uncompress(data, &len, f->data + sizeof(header),
+			size - sizeof(header)) != MZ_OK) || (len != header.size))
+	{
+		free(data);
+		FreeSaveBuffer(f);
+		gi.error("%s is corrupt", filename);
+	}
+
+	free(f->data);
+	f->data = data;
+	f->size = f->maxsize = header.size;
+	f->pos = 0;
+}
+
 /* ========================================================= */
 
 /*
@@ -364,7 +740,7 @@ FindMmoveByName(char *name)
  * below this block into files.
  */
 void
-WriteField1(FILE *f, field_t *field, byte *base)
+WriteField1(savebuffer_t *f, field_t *field, byte *base)
 {
 	void *p;
 	int len;
@@ -487,7 +863,7 @@ WriteField1(FILE *f, field_t *field, byte *base)
 }
 
 void
-WriteField2(FILE *f, field_t *field, byte *base)
+WriteField2(savebuffer_t *f, field_t *field, byte *base)
 {
 	int len;
 	void *p;
@@ -508,7 +884,7 @@ WriteField2(FILE *f, field_t *field, byte *base)
 			if (*(char **)p)
 			{
 				len = strlen(*(char **)p) + 1;
-				fwrite(*(char **)p, len, 1, f);
+				SaveWrite(f, *(char **)p, len);
 			}
 
 			break;
@@ -524,7 +900,7 @@ WriteField2(FILE *f, field_t *field, byte *base)
 				}
 
 				len = strlen(func->funcStr)+1;
-				fwrite (func->funcStr, len, 1, f);
+				SaveWrite(f, func->funcStr, len);
 			}
 
 			break;
@@ -539,7 +915,7 @@ WriteField2(FILE *f, field_t *field, byte *base)
 				}
 
 				len = strlen(mmove->mmoveStr)+1;
-				fwrite (mmove->mmoveStr, len, 1, f);
+				SaveWrite(f, mmove->mmoveStr, len);
 			}
 
 			break;
@@ -558,7 +934,7 @@ WriteField2(FILE *f, field_t *field, byte *base)
  * below
  */
 void
-ReadField(FILE *f, field_t *field, byte *base)
+ReadField(savebuffer_t *f, field_t *field, byte *base)
 {
 	void *p;
 	int len;
@@ -591,7 +967,7 @@ ReadField(FILE *f, field_t *field, byte *base)
 			else
 			{
 				*(char **)p = gi.TagMalloc(32 + len, TAG_LEVEL);
-				fread(*(char **)p, len, 1, f);
+				SaveRead(f, *(char **)p, len);
 			}
 
 			break;
@@ -649,7 +1025,7 @@ ReadField(FILE *f, field_t *field, byte *base)
 							(int)sizeof(funcStr));
 				}
 
-				fread (funcStr, len, 1, f);
+				SaveRead(f, funcStr, len);
 
 				if ( !(*(byte **)p = FindFunctionByName (funcStr)) )
 				{
@@ -673,7 +1049,7 @@ ReadField(FILE *f, field_t *field, byte *base)
 							(int)sizeof(funcStr));
 				}
 
-				fread (funcStr, len, 1, f);
+				SaveRead(f, funcStr, len);
 
 				if ( !(*(mmove_t **)p = FindMmoveByName (funcStr)) )
 				{
@@ -693,7 +1069,7 @@ ReadField(FILE *f, field_t *field, byte *base)
  * Write the client struct into a file.
  */
 void
-WriteClient(FILE *f, gclient_t *client)
+WriteClient(savebuffer_t *f, gclient_t *client)
 {
 	field_t *field;
 	gclient_t temp;
@@ -708,7 +1084,7 @@ WriteClient(FILE *f, gclient_t *client)
 	}
 
 	/* write the block */
-	fwrite(&temp, sizeof(temp), 1, f);
+	SaveWrite(f, &temp, sizeof(temp));
 
 	/* now write any allocated data following the edict */
 	for (field = clientfields; field->name; field++)
@@ -721,11 +1097,11 @@ WriteClient(FILE *f, gclient_t *client)
  * Read the client struct from a file
  */
 void
-ReadClient(FILE *f, gclient_t *client, short save_ver)
+ReadClient(savebuffer_t *f, gclient_t *client, short save_ver)
 {
 	field_t *field;
 
-	fread(client, sizeof(*client), 1, f);
+	SaveRead(f, client, sizeof(*client));
 
 	for (field = clientfields; field->name; field++)
 	{
@@ -756,7 +1132,7 @@ void
 WriteGame(const char *filename, qboolean autosave)
 {
 	savegameHeader_t sv;
-	FILE *f;
+	savebuffer_t f;
 	int i;
 
 	if (!autosave)
@@ -764,12 +1140,7 @@ WriteGame(const char *filename, qboolean autosave)
 		SaveClientData();
 	}
 
-	f = Q_fopen(filename, "wb");
-
-	if (!f)
-	{
-		gi.error("Couldn't open %s", filename);
-	}
+	InitSaveBuffer(&f);
 
 	/* Savegame identification */
 	memset(&sv, 0, sizeof(sv));
@@ -779,18 +1150,19 @@ WriteGame(const char *filename, qboolean autosave)
 	Q_strlcpy(sv.os, YQ2OSTYPE, sizeof(sv.os) - 1);
 	Q_strlcpy(sv.arch, YQ2ARCH, sizeof(sv.arch) - 1);
 
-	fwrite(&sv, sizeof(sv), 1, f);
+	SaveWrite(&f, &sv, sizeof(sv));
 
 	game.autosaved = autosave;
-	fwrite(&game, sizeof(game), 1, f);
+	SaveWrite(&f, &game, sizeof(game));
 	game.autosaved = false;
 
 	for (i = 0; i < game.maxclients; i++)
 	{
-		WriteClient(f, &game.clients[i]);
+		WriteClient(&f, &game.clients[i]);
 	}
 
-	fclose(f);
+	WriteSaveBuffer(&f, filename);
+	FreeSaveBuffer(&f);
 }
 
 /*
@@ -802,22 +1174,18 @@ void
 ReadGame(const char *filename)
 {
 	savegameHeader_t sv;
-	FILE *f;
+	savebuffer_t f;
 	int i;
 
 	short save_ver = 0;
 
 	gi.FreeTags(TAG_GAME);
+	AI_FreePrefetch();
 
-	f = Q_fopen(filename, "rb");
-
-	if (!f)
-	{
-		gi.error("Couldn't open %s", filename);
-	}
+	ReadSaveBuffer(&f, filename);
 
 	/* Sanity checks */
-	fread(&sv, sizeof(sv), 1, f);
+	SaveRead(&f, &sv, sizeof(sv));
 
 	static const struct {
 		const char* verstr;
@@ -841,7 +1209,7 @@ ReadGame(const char *filename)
 
 	if (save_ver == 0) // not found in mappings table
 	{
-		fclose(f);
+		FreeSaveBuffer(&f);
 		gi.error("Savegame from an incompatible version.\n");
 	}
 
@@ -849,12 +1217,12 @@ ReadGame(const char *filename)
 	{
 		if (strcmp(sv.game, GAMEVERSION) != 0)
 		{
-			fclose(f);
+			FreeSaveBuffer(&f);
 			gi.error("Savegame from another game.so.\n");
 		}
 		else if (strcmp(sv.os, OSTYPE_1) != 0)
 		{
-			fclose(f);
+			FreeSaveBuffer(&f);
 			gi.error("Savegame from another os.\n");
 		}
 
@@ -862,13 +1230,13 @@ ReadGame(const char *filename)
 		/* Windows was forced to i386 */
 		if (strcmp(sv.arch, "i386") != 0)
 		{
-			fclose(f);
+			FreeSaveBuffer(&f);
 			gi.error("Savegame from another architecture.\n");
 		}
 #else
 		if (strcmp(sv.arch, ARCH_1) != 0)
 		{
-			fclose(f);
+			FreeSaveBuffer(&f);
 			gi.error("Savegame from another architecture.\n");
 		}
 #endif
@@ -877,12 +1245,12 @@ ReadGame(const char *filename)
 	{
 		if (strcmp(sv.game, GAMEVERSION) != 0)
 		{
-			fclose(f);
+			FreeSaveBuffer(&f);
 			gi.error("Savegame from another game.so.\n");
 		}
 		else if (strcmp(sv.os, YQ2OSTYPE) != 0)
 		{
-			fclose(f);
+			FreeSaveBuffer(&f);
 			gi.error("Savegame from another os.\n");
 		}
 		else if (strcmp(sv.arch, YQ2ARCH) != 0)
@@ -895,7 +1263,7 @@ ReadGame(const char *filename)
 			if (save_ver >= 4 || strcmp(sv.arch, "AMD64") != 0)
 #endif
 			{
-				fclose(f);
+				FreeSaveBuffer(&f);
 				gi.error("Savegame from another architecture.\n");
 			}
 		}
@@ -904,16 +1272,17 @@ ReadGame(const char *filename)
 	g_edicts = gi.TagMalloc(game.maxentities * sizeof(g_edicts[0]), TAG_GAME);
 	globals.edicts = g_edicts;
 
-	fread(&game, sizeof(game), 1, f);
+	SaveRead(&f, &game, sizeof(game));
+	G_ClearFindIndex();
 	game.clients = gi.TagMalloc(game.maxclients * sizeof(game.clients[0]),
 			TAG_GAME);
 
 	for (i = 0; i < game.maxclients; i++)
 	{
-		ReadClient(f, &game.clients[i], save_ver);
+		ReadClient(&f, &game.clients[i], save_ver);
 	}
 
-	fclose(f);
+	FreeSaveBuffer(&f);
 }
 
 /* ========================================================== */
@@ -924,7 +1293,7 @@ ReadGame(const char *filename)
  * WriteLevel.
  */
 void
-WriteEdict(FILE *f, edict_t *ent)
+WriteEdict(savebuffer_t *f, edict_t *ent)
 {
 	field_t *field;
 	edict_t temp;
@@ -939,7 +1308,7 @@ WriteEdict(FILE *f, edict_t *ent)
 	}
 
 	/* write the block */
-	fwrite(&temp, sizeof(temp), 1, f);
+	SaveWrite(f, &temp, sizeof(temp));
 
 	/* now write any allocated data following the edict */
 	for (field = fields; field->name; field++)
@@ -954,7 +1323,7 @@ WriteEdict(FILE *f, edict_t *ent)
  * Called by WriteLevel.
  */
 void
-WriteLevelLocals(FILE *f)
+WriteLevelLocals(savebuffer_t *f)
 {
 	field_t *field;
 	level_locals_t temp;
@@ -969,7 +1338,7 @@ WriteLevelLocals(FILE *f)
 	}
 
 	/* write the block */
-	fwrite(&temp, sizeof(temp), 1, f);
+	SaveWrite(f, &temp, sizeof(temp));
 
 	/* now write any allocated data following the edict */
 	for (field = levelfields; field->name; field++)
@@ -987,21 +1356,16 @@ WriteLevel(const char *filename)
 {
 	int i;
 	edict_t *ent;
-	FILE *f;
+	savebuffer_t f;
 
-	f = Q_fopen(filename, "wb");
-
-	if (!f)
-	{
-		gi.error("Couldn't open %s", filename);
-	}
+	InitSaveBuffer(&f);
 
 	/* write out edict size for checking */
 	i = sizeof(edict_t);
-	fwrite(&i, sizeof(i), 1, f);
+	SaveWrite(&f, &i, sizeof(i));
 
 	/* write out level_locals_t */
-	WriteLevelLocals(f);
+	WriteLevelLocals(&f);
 
 	/* write out all the entities */
 	for (i = 0; i < globals.num_edicts; i++)
@@ -1013,14 +1377,15 @@ WriteLevel(const char *filename)
 			continue;
 		}
 
-		fwrite(&i, sizeof(i), 1, f);
-		WriteEdict(f, ent);
+		SaveWrite(&f, &i, sizeof(i));
+		WriteEdict(&f, ent);
 	}
 
 	i = -1;
-	fwrite(&i, sizeof(i), 1, f);
+	SaveWrite(&f, &i, sizeof(i));
 
-	fclose(f);
+	WriteSaveBuffer(&f, filename);
+	FreeSaveBuffer(&f);
 }
 
 /* ========================================================== */
@@ -1032,11 +1397,11 @@ WriteLevel(const char *filename)
  * by ReadLevel.
  */
 void
-ReadEdict(FILE *f, edict_t *ent)
+ReadEdict(savebuffer_t *f, edict_t *ent)
 {
 	field_t *field;
 
-	fread(ent, sizeof(*ent), 1, f);
+	SaveRead(f, ent, sizeof(*ent));
 
 	for (field = fields; field->name; field++)
 	{
@@ -1051,11 +1416,11 @@ ReadEdict(FILE *f, edict_t *ent)
  * Called by ReadLevel.
  */
 void
-ReadLevelLocals(FILE *f)
+ReadLevelLocals(savebuffer_t *f)
 {
 	field_t *field;
 
-	fread(&level, sizeof(level), 1, f);
+	SaveRead(f, &level, sizeof(level));
 
 	for (field = levelfields; field->name; field++)
 	{
@@ -1076,16 +1441,11 @@ void
 ReadLevel(const char *filename)
 {
 	int entnum;
-	FILE *f;
+	savebuffer_t f;
 	int i;
 	edict_t *ent;
 
-	f = Q_fopen(filename, "rb");
-
-	if (!f)
-	{
-		gi.error("Couldn't open %s", filename);
-	}
+	ReadSaveBuffer(&f, filename);
 
 	/* free any dynamic memory allocated by
 	   loading the level  base state */
@@ -1094,25 +1454,26 @@ ReadLevel(const char *filename)
 	/* wipe all the entities */
 	memset(g_edicts, 0, game.maxentities * sizeof(g_edicts[0]));
 	globals.num_edicts = maxclients->value + 1;
+	G_ClearFindIndex();
 
 	/* check edict size */
-	fread(&i, sizeof(i), 1, f);
+	SaveRead(&f, &i, sizeof(i));
 
 	if (i != sizeof(edict_t))
 	{
-		fclose(f);
+		FreeSaveBuffer(&f);
 		gi.error("ReadLevel: mismatched edict size");
 	}
 
 	/* load the level locals */
-	ReadLevelLocals(f);
+	ReadLevelLocals(&f);
 
 	/* load all the entities */
 	while (1)
 	{
-		if (fread(&entnum, sizeof(entnum), 1, f) != 1)
+		if (SaveRead(&f, &entnum, sizeof(entnum)) != 1)
 		{
-			fclose(f);
+			FreeSaveBuffer(&f);
 			gi.error("ReadLevel: failed to read entnum");
 		}
 
@@ -1127,14 +1488,15 @@ ReadLevel(const char *filename)
 		}
 
 		ent = &g_edicts[entnum];
-		ReadEdict(f, ent);
+		ReadEdict(&f, ent);
+		G_IndexEdict(ent);
 
 		/* let the server rebuild world links for this ent */
 		memset(&ent->area, 0, sizeof(ent->area));
 		gi.linkentity(ent);
 	}
 
-	fclose(f);
+	FreeSaveBuffer(&f);
 
 	/* mark all clients as unconnected */
 	for (i = 0; i < maxclients->value; i++)
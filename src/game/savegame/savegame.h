@@ -53,4 +53,17 @@ typedef struct
     char arch[32];
 } savegameHeader_t;
 
+/*
+ * Savegames are assembled in and
+ * parsed from memory, the file is
+ * written or read in one go.
+ */
+typedef struct
+{
+	byte *data;
+	size_t size;
+	size_t maxsize;
+	size_t pos; /* read position */
+} savebuffer_t;
+
 #endif /* SAVEGAME_LOCAL_H */
@@ -26,18 +26,18 @@
  */
 
 extern void ReadLevel ( const char * filename ) ;
-extern void ReadLevelLocals ( FILE * f ) ;
-extern void ReadEdict ( FILE * f , edict_t * ent ) ;
+extern void ReadLevelLocals ( savebuffer_t * f ) ;
+extern void ReadEdict ( savebuffer_t * f , edict_t * ent ) ;
 extern void WriteLevel ( const char * filename ) ;
-extern void WriteLevelLocals ( FILE * f ) ;
-extern void WriteEdict ( FILE * f , edict_t * ent ) ;
+extern void WriteLevelLocals ( savebuffer_t * f ) ;
+extern void WriteEdict ( savebuffer_t * f , edict_t * ent ) ;
 extern void ReadGame ( const char * filename ) ;
 extern void WriteGame ( const char * filename , qboolean autosave ) ;
-extern void ReadClient ( FILE * f , gclient_t * client , short save_ver ) ;
-extern void WriteClient ( FILE * f , gclient_t * client ) ;
-extern void ReadField ( FILE * f , field_t * field , byte * base ) ;
-extern void WriteField2 ( FILE * f , field_t * field , byte * base ) ;
-extern void WriteField1 ( FILE * f , field_t * field , byte * base ) ;
+extern void ReadClient ( savebuffer_t * f , gclient_t * client , short save_ver ) ;
+extern void WriteClient ( savebuffer_t * f , gclient_t * client ) ;
+extern void ReadField ( savebuffer_t * f , field_t * field , byte * base ) ;
+extern void WriteField2 ( savebuffer_t * f , field_t * field , byte * base ) ;
+extern void WriteField1 ( savebuffer_t * f , field_t * field , byte * base ) ;
 extern mmove_t * FindMmoveByName ( char * name ) ;
 extern mmoveList_t * GetMmoveByAddress ( mmove_t * adr ) ;
 extern byte * FindFunctionByName ( char * name ) ;
@@ -194,6 +194,9 @@ extern cvar_t *sv_airaccelerate;            /* don't reload level state when ree
 											/* development tool */
 extern cvar_t *sv_enforcetime;
 extern cvar_t *sv_downloadserver;			/* Download server. */
+extern cvar_t *sv_areagrid;                 /* use the loose grid for entity links */
+extern cvar_t *sv_parallelframes;           /* build client frames on the job threads */
+extern cvar_t *sv_deltamemo;                /* reuse entity deltas between clients */
 
 extern client_t *sv_client;
 extern edict_t *sv_player;
@@ -215,6 +218,7 @@ void SV_UserinfoChanged(client_t *cl);
 
 void Master_Heartbeat(void);
 void Master_Packet(void);
+void SV_Jitter_f(void);
 
 void SV_InitGame(void);
 void SV_Map(qboolean attractloop, char *levelstring, qboolean loadgame, qboolean isautosave);
@@ -244,9 +248,33 @@ void SV_ExecuteClientMessage(client_t *cl);
 void SV_ReadLevelFile(void);
 void SV_Status_f(void);
 
+/* the entities a client sees, see SV_CollectClientEntities() */
+typedef struct
+{
+	vec3_t org;
+	int group; /* see SV_FindVisGroup() */
+	int num_entities;
+	short entities[MAX_EDICTS];
+} clientvis_t;
+
+/* scratch space of SV_BuildVisGroup(), the rows are
+   read as int32_t and the struct must be allocated */
+typedef struct
+{
+	byte fatpvs[MAX_MAP_LEAFS / 8];
+	byte pvsrow[MAX_MAP_LEAFS / 8];
+	byte phsrow[MAX_MAP_LEAFS / 8];
+} visscratch_t;
+
 void SV_WriteFrameToClient(client_t *client, sizebuf_t *msg);
 void SV_RecordDemoMessage(void);
-void SV_BuildClientFrame(client_t *client);
+void SV_PrepareClientFrames(void);
+int SV_FindVisGroup(client_t *client, clientvis_t *vis);
+void SV_BuildVisGroup(int group, visscratch_t *scratch);
+void SV_CollectClientEntities(client_t *client, clientvis_t *vis);
+void SV_StoreClientEntities(client_t *client, clientvis_t *vis);
+visscratch_t *SV_VisScratch(void);
+void SV_DeltaStats_f(void);
 
 extern game_export_t *ge;
 
@@ -261,6 +289,7 @@ void SV_WriteLevelFile(void);
 void SV_WriteServerFile(qboolean autosave);
 void SV_Loadgame_f(void);
 void SV_Savegame_f(void);
+void SV_SaveBench_f(void);
 
 /* high level object sorting to reduce interaction tests */
 void SV_ClearWorld(void);
@@ -279,10 +308,22 @@ void SV_LinkEdict(edict_t *ent);
 int SV_AreaEdicts(vec3_t mins, vec3_t maxs, edict_t **list,
 		int maxcount, int areatype);
 
+int SV_RadiusEdicts(vec3_t org, float radius, edict_t **list,
+		int maxcount);
+
 int SV_PointContents(vec3_t p);
 
+void SV_AreaBench_f(void);
+
 trace_t SV_Trace(vec3_t start, vec3_t mins, vec3_t maxs,
 		vec3_t end, edict_t *passedict, int contentmask);
 
+/* SV_Trace() split in two: the world part is thread safe
+   and can run in jobs, the entity part must not */
+trace_t SV_TraceWorld(vec3_t start, vec3_t mins, vec3_t maxs,
+		vec3_t end, int contentmask, int thread);
+trace_t SV_TraceEntities(trace_t *world, vec3_t start, vec3_t mins,
+		vec3_t maxs, vec3_t end, edict_t *passedict, int contentmask);
+
 #endif
 
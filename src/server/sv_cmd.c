@@ -780,5 +780,10 @@ SV_InitOperatorCommands(void)
 	Cmd_AddCommand("killserver", SV_KillServer_f);
 
 	Cmd_AddCommand("sv", SV_ServerCommand_f);
+
+	Cmd_AddCommand("sv_areabench", SV_AreaBench_f);
+	Cmd_AddCommand("sv_savebench", SV_SaveBench_f);
+	Cmd_AddCommand("sv_deltastats", SV_DeltaStats_f);
+	Cmd_AddCommand("sv_jitter", SV_Jitter_f);
 }
 
@@ -30,8 +30,206 @@
 
 #include "header/server.h"
 
-// DG: is casted to int32_t* in SV_FatPVS() so align accordingly
-static YQ2_ALIGNAS_TYPE(int32_t) byte fatpvs[65536 / 8];
+static visscratch_t *sv_visscratch;
+
+/*
+ * Clients that acknowledged the same frame get the same
+ * deltas for most entities. The encoded bytes of each
+ * delta are kept for the current frame and reused when
+ * another client needs exactly the same one. The table
+ * is shared by the job threads, a slot is claimed with a
+ * compare and exchange and read after it became ready.
+ */
+#define DELTA_MEMO_SIZE 4096 /* must be a power of two */
+#define DELTA_MEMO_PROBES 8
+#define DELTA_MEMO_BYTES 64 /* the largest delta is about 50 bytes */
+
+#define MEMO_EMPTY 0
+#define MEMO_BUSY 1
+#define MEMO_READY 2
+
+typedef struct
+{
+	unsigned int hash;
+	int flags; /* force and newentity */
+	entity_state_t from;
+	entity_state_t to;
+	int length;
+	byte data[DELTA_MEMO_BYTES];
+} deltamemo_t;
+
+static deltamemo_t *sv_deltamemos;
+static volatile long sv_deltamemostate[DELTA_MEMO_SIZE];
+
+/* statistics, printed by sv_deltastats */
+static volatile long sv_deltahits, sv_deltamisses;
+static long long sv_deltatotalhits, sv_deltatotalmisses;
+static long sv_deltalasthits, sv_deltalastmisses;
+
+static unsigned int
+SV_HashDelta(entity_state_t *from, entity_state_t *to, int flags)
+{
+	const int *f = (const int *)from;
+	const int *t = (const int *)to;
+	unsigned int hash;
+	int i;
+
+	/* number, origin and angles of both change most often */
+	hash = to->number * 2654435761u + flags;
+
+	for (i = 1; i < 7; i++)
+	{
+		hash = (hash ^ f[i]) * 16777619u;
+		hash = (hash ^ t[i]) * 16777619u;
+	}
+
+	hash = (hash ^ from->frame) * 16777619u;
+	hash = (hash ^ to->frame) * 16777619u;
+	hash = (hash ^ to->event) * 16777619u;
+
+	return hash;
+}
+
+/*
+ * MSG_WriteDeltaEntity() with the memo.
+ * hits and misses count the lookups.
+ */
+static void
+SV_WriteDeltaEntity(entity_state_t *from, entity_state_t *to,
+		sizebuf_t *msg, qboolean force, qboolean newentity,
+		int *hits, int *misses)
+{
+	byte buf[128];
+	sizebuf_t delta;
+	deltamemo_t *memo;
+	unsigned int hash;
+	long state;
+	int flags, i, slot, claimed;
+
+	if (!sv_deltamemos || !sv_deltamemo->value)
+	{
+		MSG_WriteDeltaEntity(from, to, msg, force, newentity);
+		return;
+	}
+
+	flags = (force ? 1 : 0) | (newentity ? 2 : 0);
+	hash = SV_HashDelta(from, to, flags);
+	claimed = -1;
+
+	for (i = 0; i < DELTA_MEMO_PROBES; i++)
+	{
+		slot = (hash + i) & (DELTA_MEMO_SIZE - 1);
+
+		/* a read with barrier, nobody sets -1 */
+		state = Jobs_CompareExchange(&sv_deltamemostate[slot], -1, -1);
+
+		if (state == MEMO_EMPTY)
+		{
+			state = Jobs_CompareExchange(&sv_deltamemostate[slot],
+					MEMO_EMPTY, MEMO_BUSY);
+
+			if (state == MEMO_EMPTY)
+			{
+				claimed = slot;
+				break;
+			}
+		}
+
+		if (state != MEMO_READY)
+		{
+			continue;
+		}
+
+		memo = &sv_deltamemos[slot];
+
+		if ((memo->hash == hash) && (memo->flags == flags) &&
+			!memcmp(&memo->to, to, sizeof(*to)) &&
+			!memcmp(&memo->from, from, sizeof(*from)))
+		{
+			SZ_Write(msg, memo->data, memo->length);
+			(*hits)++;
+			return;
+		}
+	}
+
+	(*misses)++;
+
+	SZ_Init(&delta, buf, sizeof(buf));
+	MSG_WriteDeltaEntity(from, to, &delta, force, newentity);
+	SZ_Write(msg, delta.data, delta.cursize);
+
+	if (claimed == -1)
+	{
+		return; /* no free slot, don't remember it */
+	}
+
+	memo = &sv_deltamemos[claimed];
+
+	if (delta.cursize > DELTA_MEMO_BYTES)
+	{
+		/* the slot stays busy until the next frame */
+		return;
+	}
+
+	memo->hash = hash;
+	memo->flags = flags;
+	memo->from = *from;
+	memo->to = *to;
+	memo->length = delta.cursize;
+	memcpy(memo->data, delta.data, delta.cursize);
+
+	Jobs_CompareExchange(&sv_deltamemostate[claimed], MEMO_BUSY, MEMO_READY);
+}
+
+/*
+ * Forgets the deltas of the last frame.
+ */
+static void
+SV_ClearDeltaMemo(void)
+{
+	if (!sv_deltamemos)
+	{
+		sv_deltamemos = Z_Malloc(sizeof(deltamemo_t) * DELTA_MEMO_SIZE);
+	}
+
+	memset((void *)sv_deltamemostate, 0, sizeof(sv_deltamemostate));
+
+	sv_deltalasthits = sv_deltahits;
+	sv_deltalastmisses = sv_deltamisses;
+	sv_deltatotalhits += sv_deltahits;
+	sv_deltatotalmisses += sv_deltamisses;
+	sv_deltahits = sv_deltamisses = 0;
+}
+
+/*
+ * Prints the hit rate of the delta memo,
+ * "sv_deltastats reset" clears the counters.
+ */
+void
+SV_DeltaStats_f(void)
+{
+	long long lookups;
+
+	if ((Cmd_Argc() > 1) && !Q_stricmp(Cmd_Argv(1), "reset"))
+	{
+		sv_deltatotalhits = sv_deltatotalmisses = 0;
+		Com_Printf("Delta statistics cleared.\n");
+		return;
+	}
+
+	Com_Printf("Entity delta memo %s:\n",
+			sv_deltamemo->value ? "on" : "off");
+
+	lookups = sv_deltalasthits + sv_deltalastmisses;
+	Com_Printf("  last frame: %li of %lli deltas reused (%.1f%%)\n",
+			sv_deltalasthits, lookups,
+			lookups ? 100.0 * sv_deltalasthits / lookups : 0.0);
+
+	lookups = sv_deltatotalhits + sv_deltatotalmisses;
+	Com_Printf("  total:      %lli of %lli deltas reused (%.1f%%)\n",
+			sv_deltatotalhits, lookups,
+			lookups ? 100.0 * sv_deltatotalhits / lookups : 0.0);
+}
 
 /*
  * Writes a delta update of an entity_state_t list to the message.
@@ -44,6 +242,7 @@ SV_EmitPacketEntities(client_frame_t *from, client_frame_t *to, sizebuf_t *msg)
 	int oldnum, newnum;
 	int from_num_entities;
 	int bits;
+	int hits, misses;
 
 	MSG_WriteByte(msg, svc_packetentities);
 
@@ -60,6 +259,7 @@ SV_EmitPacketEntities(client_frame_t *from, client_frame_t *to, sizebuf_t *msg)
 	oldindex = 0;
 	newent = NULL;
 	oldent = NULL;
+	hits = misses = 0;
 
 	while (newindex < to->num_entities || oldindex < from_num_entities)
 	{
@@ -97,8 +297,8 @@ SV_EmitPacketEntities(client_frame_t *from, client_frame_t *to, sizebuf_t *msg)
 			   being emited if the entity has not changed at all
 			   note that players are always 'newentities', this
 			   updates their oldorigin always and prevents warping */
-			MSG_WriteDeltaEntity(oldent, newent, msg,
-					false, newent->number <= maxclients->value);
+			SV_WriteDeltaEntity(oldent, newent, msg, false,
+					newent->number <= maxclients->value, &hits, &misses);
 			oldindex++;
 			newindex++;
 			continue;
@@ -107,7 +307,8 @@ SV_EmitPacketEntities(client_frame_t *from, client_frame_t *to, sizebuf_t *msg)
 		if (newnum < oldnum)
 		{
 			/* this is a new entity, send it from the baseline */
-			MSG_WriteDeltaEntity(&sv.baselines[newnum], newent, msg, true, true);
+			SV_WriteDeltaEntity(&sv.baselines[newnum], newent, msg,
+					true, true, &hits, &misses);
 			newindex++;
 			continue;
 		}
@@ -144,6 +345,16 @@ SV_EmitPacketEntities(client_frame_t *from, client_frame_t *to, sizebuf_t *msg)
 	}
 
 	MSG_WriteShort(msg, 0);
+
+	if (hits)
+	{
+		Jobs_AtomicAdd(&sv_deltahits, hits);
+	}
+
+	if (misses)
+	{
+		Jobs_AtomicAdd(&sv_deltamisses, misses);
+	}
 }
 
 void
@@ -436,17 +647,134 @@ SV_WriteFrameToClient(client_t *client, sizebuf_t *msg)
 }
 
 /*
- * The client will interpolate the view position,
- * so we can't use a single PVS point
+ * Entities that may be visible to a client, collected once per
+ * frame by SV_PrepareClientFrames(). Everything the visibility
+ * tests need is copied into flat arrays, the edicts are only
+ * looked at again when the states are stored.
+ */
+#define VIS_BEAM 1 /* only the first cluster is tested against the PHS */
+#define VIS_SOUND 2 /* no model, clients further away don't hear it */
+
+typedef struct
+{
+	int num;
+	short number[MAX_EDICTS];
+	short index[MAX_EDICTS]; /* edict number -> candidate, -1 if none */
+	byte flags[MAX_EDICTS];
+	int areanum[MAX_EDICTS];
+	int areanum2[MAX_EDICTS];
+	int num_clusters[MAX_EDICTS];
+	int clusternums[MAX_EDICTS][MAX_ENT_CLUSTERS];
+	int headnode[MAX_EDICTS];
+	vec3_t origin[MAX_EDICTS];
+} viscandidates_t;
+
+/*
+ * Clients seeing through the same clusters from the same
+ * area share one visibility group. The candidates visible
+ * to the group are tested once per frame, left for each
+ * client are the tests depending on its own position.
+ */
+#define VIS_MAXCLUSTERS 64
+
+typedef struct
+{
+	unsigned int hash;
+	int area;
+	int phscluster;
+	int numclusters;
+	int clusters[VIS_MAXCLUSTERS]; /* fat PVS, sorted */
+	unsigned int visible[MAX_EDICTS / 32]; /* candidate bits */
+} visgroup_t;
+
+static viscandidates_t *sv_candidates;
+static visgroup_t sv_visgroups[MAX_CLIENTS];
+static int sv_numvisgroups;
+
+/*
+ * Collects the candidates of this frame and forgets
+ * the visibility groups of the last one. Must be
+ * called after the world was changed and before
+ * SV_FindVisGroup().
  */
 void
-SV_FatPVS(vec3_t org)
+SV_PrepareClientFrames(void)
 {
-	int leafs[64];
-	int i, j, count;
-	// DG: used to be called "longs" and long was used which isn't really correct on 64bit
-	int32_t numInt32s;
-	byte *src;
+	viscandidates_t *c;
+	edict_t *ent;
+	int e, i, numedicts;
+
+	if (!sv_candidates)
+	{
+		sv_candidates = Z_Malloc(sizeof(viscandidates_t));
+	}
+
+	c = sv_candidates;
+	c->num = 0;
+
+	sv_numvisgroups = 0;
+
+	SV_ClearDeltaMemo();
+
+	/* the protocol can't address more */
+	numedicts = min(ge->num_edicts, MAX_EDICTS);
+
+	for (e = 0; e < numedicts; e++)
+	{
+		c->index[e] = -1;
+	}
+
+	for (e = 1; e < numedicts; e++)
+	{
+		ent = EDICT_NUM(e);
+
+		/* ignore ents without visible models */
+		if (ent->svflags & SVF_NOCLIENT)
+		{
+			continue;
+		}
+
+		/* ignore ents without visible models unless they have an effect */
+		if (!ent->s.modelindex && !ent->s.effects &&
+			!ent->s.sound && !ent->s.event)
+		{
+			continue;
+		}
+
+		i = c->num++;
+
+		c->number[i] = e;
+		c->index[e] = i;
+		c->flags[i] = 0;
+
+		if (ent->s.renderfx & RF_BEAM)
+		{
+			c->flags[i] |= VIS_BEAM;
+		}
+		else if (!ent->s.modelindex)
+		{
+			c->flags[i] |= VIS_SOUND;
+		}
+
+		c->areanum[i] = ent->areanum;
+		c->areanum2[i] = ent->areanum2;
+		c->num_clusters[i] = ent->num_clusters;
+		memcpy(c->clusternums[i], ent->clusternums, sizeof(c->clusternums[i]));
+		c->headnode[i] = ent->headnode;
+		VectorCopy(ent->s.origin, c->origin[i]);
+	}
+}
+
+/*
+ * The client will interpolate the view position,
+ * so we can't use a single PVS point. Returns the
+ * clusters around org, sorted and without doubles.
+ */
+static int
+SV_FatPVSClusters(vec3_t org, int *clusters)
+{
+	int leafs[VIS_MAXCLUSTERS];
+	int i, j, count, numclusters, cluster;
 	vec3_t mins, maxs;
 
 	for (i = 0; i < 3; i++)
@@ -455,73 +783,73 @@ SV_FatPVS(vec3_t org)
 		maxs[i] = org[i] + 8;
 	}
 
-	count = CM_BoxLeafnums(mins, maxs, leafs, 64, NULL);
+	count = CM_BoxLeafnums(mins, maxs, leafs, VIS_MAXCLUSTERS, NULL);
 
 	if (count < 1)
 	{
 		Com_Error(ERR_FATAL, "SV_FatPVS: count < 1");
 	}
 
-	numInt32s = (CM_NumClusters() + 31) >> 5;
+	numclusters = 0;
 
-	/* convert leafs to clusters */
 	for (i = 0; i < count; i++)
 	{
-		leafs[i] = CM_LeafCluster(leafs[i]);
-	}
+		cluster = CM_LeafCluster(leafs[i]);
 
-	memcpy(fatpvs, CM_ClusterPVS(leafs[0]), numInt32s << 2);
+		/* sees nothing, adds nothing */
+		if (cluster == -1)
+		{
+			continue;
+		}
 
-	/* or in all the other leaf bits */
-	for (i = 1; i < count; i++)
-	{
-		for (j = 0; j < i; j++)
+		for (j = 0; j < numclusters; j++)
 		{
-			if (leafs[i] == leafs[j])
+			if (clusters[j] == cluster)
 			{
 				break;
 			}
 		}
 
-		if (j != i)
+		if (j != numclusters)
 		{
 			continue; /* already have the cluster we want */
 		}
 
-		src = CM_ClusterPVS(leafs[i]);
-
-		for (j = 0; j < numInt32s; j++)
+		for (j = numclusters; j > 0 && clusters[j - 1] > cluster; j--)
 		{
-			((int32_t *)fatpvs)[j] |= ((int32_t *)src)[j];
+			clusters[j] = clusters[j - 1];
 		}
+
+		clusters[j] = cluster;
+		numclusters++;
 	}
+
+	return numclusters;
 }
 
 /*
- * Decides which entities are going to be visible to the client, and
- * copies off the playerstat and areabits.
+ * Fills the clients frame with the playerstate and the areabits
+ * and finds the visibility group of the client. The group is
+ * created if no other client shares it. Call one client after
+ * the other, returns the number of groups.
  */
-void
-SV_BuildClientFrame(client_t *client)
+int
+SV_FindVisGroup(client_t *client, clientvis_t *vis)
 {
-	int e, i;
-	vec3_t org;
-	edict_t *ent;
+	visgroup_t *g;
 	edict_t *clent;
 	client_frame_t *frame;
-	entity_state_t *state;
-	int l;
-	int clientarea, clientcluster;
-	int leafnum;
-	int c_fullsend;
-	byte *clientphs;
-	byte *bitvector;
+	int clusters[VIS_MAXCLUSTERS];
+	int i, numclusters, leafnum, area, phscluster;
+	unsigned int hash;
+
+	vis->group = -1;
 
 	clent = client->edict;
 
 	if (!clent->client)
 	{
-		return; /* not in game yet */
+		return sv_numvisgroups; /* not in game yet */
 	}
 
 	/* this is the frame we are creating */
@@ -532,120 +860,244 @@ SV_BuildClientFrame(client_t *client)
 	/* find the client's PVS */
 	for (i = 0; i < 3; i++)
 	{
-		org[i] = clent->client->ps.pmove.origin[i] * 0.125 +
+		vis->org[i] = clent->client->ps.pmove.origin[i] * 0.125 +
 				 clent->client->ps.viewoffset[i];
 	}
 
-	leafnum = CM_PointLeafnum(org);
-	clientarea = CM_LeafArea(leafnum);
-	clientcluster = CM_LeafCluster(leafnum);
+	leafnum = CM_PointLeafnum(vis->org);
+	area = CM_LeafArea(leafnum);
+	phscluster = CM_LeafCluster(leafnum);
 
 	/* calculate the visible areas */
-	frame->areabytes = CM_WriteAreaBits(frame->areabits, clientarea);
+	frame->areabytes = CM_WriteAreaBits(frame->areabits, area);
 
 	/* grab the current player_state_t */
 	frame->ps = clent->client->ps;
 
-	SV_FatPVS(org);
-	clientphs = CM_ClusterPHS(clientcluster);
+	numclusters = SV_FatPVSClusters(vis->org, clusters);
 
-	/* build up the list of visible entities */
-	frame->num_entities = 0;
-	frame->first_entity = svs.next_client_entities;
+	hash = area * 31 + phscluster;
 
-	c_fullsend = 0;
+	for (i = 0; i < numclusters; i++)
+	{
+		hash = hash * 31 + clusters[i];
+	}
 
-	for (e = 1; e < ge->num_edicts; e++)
+	for (i = 0; i < sv_numvisgroups; i++)
 	{
-		ent = EDICT_NUM(e);
+		g = &sv_visgroups[i];
 
-		/* ignore ents without visible models */
-		if (ent->svflags & SVF_NOCLIENT)
+		if ((g->hash == hash) && (g->area == area) &&
+			(g->phscluster == phscluster) &&
+			(g->numclusters == numclusters) &&
+			!memcmp(g->clusters, clusters, numclusters * sizeof(int)))
 		{
-			continue;
+			vis->group = i;
+			return sv_numvisgroups;
 		}
+	}
 
-		/* ignore ents without visible models unless they have an effect */
-		if (!ent->s.modelindex && !ent->s.effects &&
-			!ent->s.sound && !ent->s.event)
+	g = &sv_visgroups[sv_numvisgroups];
+
+	g->hash = hash;
+	g->area = area;
+	g->phscluster = phscluster;
+	g->numclusters = numclusters;
+	memcpy(g->clusters, clusters, numclusters * sizeof(int));
+
+	vis->group = sv_numvisgroups;
+
+	return ++sv_numvisgroups;
+}
+
+/*
+ * Tests all candidates against the area, the fat PVS
+ * and the PHS of a visibility group. Only reads the
+ * world, so the groups can be built at the same time,
+ * each with its own scratch space.
+ */
+void
+SV_BuildVisGroup(int group, visscratch_t *scratch)
+{
+	viscandidates_t *c = sv_candidates;
+	visgroup_t *g = &sv_visgroups[group];
+	int32_t *fatpvs = (int32_t *)scratch->fatpvs;
+	int32_t *src;
+	byte *bitvector;
+	byte *clientphs;
+	int i, j, l;
+	// DG: used to be called "longs" and long was used which isn't really correct on 64bit
+	int32_t numInt32s;
+
+	numInt32s = (CM_NumClusters() + 31) >> 5;
+
+	/* or in all the leaf bits */
+	memset(fatpvs, 0, numInt32s << 2);
+
+	for (i = 0; i < g->numclusters; i++)
+	{
+		src = (int32_t *)CM_ClusterPVSBuffer(g->clusters[i], scratch->pvsrow);
+
+		for (j = 0; j < numInt32s; j++)
 		{
-			continue;
+			fatpvs[j] |= src[j];
 		}
+	}
 
-		/* ignore if not touching a PV leaf */
-		if (ent != clent)
+	clientphs = CM_ClusterPHSBuffer(g->phscluster, scratch->phsrow);
+	bitvector = scratch->fatpvs;
+
+	memset(g->visible, 0, sizeof(g->visible));
+
+	for (i = 0; i < c->num; i++)
+	{
+		/* check area */
+		if (!CM_AreasConnected(g->area, c->areanum[i]))
 		{
-			/* check area */
-			if (!CM_AreasConnected(clientarea, ent->areanum))
+			/* doors can legally straddle two areas,
+			   so we may need to check another one */
+			if (!c->areanum2[i] ||
+				!CM_AreasConnected(g->area, c->areanum2[i]))
 			{
-				/* doors can legally straddle two areas,
-				   so we may need to check another one */
-				if (!ent->areanum2 ||
-					!CM_AreasConnected(clientarea, ent->areanum2))
-				{
-					continue; /* blocked by a door */
-				}
+				continue; /* blocked by a door */
 			}
+		}
+
+		/* beams just check one point for PHS */
+		if (c->flags[i] & VIS_BEAM)
+		{
+			l = c->clusternums[i][0];
 
-			/* beams just check one point for PHS */
-			if (ent->s.renderfx & RF_BEAM)
+			if (!(clientphs[l >> 3] & (1 << (l & 7))))
+			{
+				continue;
+			}
+		}
+		else if (c->num_clusters[i] == -1)
+		{
+			/* too many leafs for individual check, go by headnode */
+			if (!CM_HeadnodeVisible(c->headnode[i], bitvector))
+			{
+				continue;
+			}
+		}
+		else
+		{
+			/* check individual leafs */
+			for (j = 0; j < c->num_clusters[i]; j++)
 			{
-				l = ent->clusternums[0];
+				l = c->clusternums[i][j];
 
-				if (!(clientphs[l >> 3] & (1 << (l & 7))))
+				if (bitvector[l >> 3] & (1 << (l & 7)))
 				{
-					continue;
+					break;
 				}
 			}
-			else
+
+			if (j == c->num_clusters[i])
 			{
-				bitvector = fatpvs;
+				continue; /* not visible */
+			}
+		}
 
-				if (ent->num_clusters == -1)
-				{
-					/* too many leafs for individual check, go by headnode */
-					if (!CM_HeadnodeVisible(ent->headnode, bitvector))
-					{
-						continue;
-					}
+		g->visible[i >> 5] |= 1u << (i & 31);
+	}
+}
 
-					c_fullsend++;
-				}
-				else
-				{
-					/* check individual leafs */
-					for (i = 0; i < ent->num_clusters; i++)
-					{
-						l = ent->clusternums[i];
-
-						if (bitvector[l >> 3] & (1 << (l & 7)))
-						{
-							break;
-						}
-					}
-
-					if (i == ent->num_clusters)
-					{
-						continue; /* not visible */
-					}
-				}
+/*
+ * Decides which entities are going to be visible to the client.
+ * The entity numbers are written to vis, SV_StoreClientEntities()
+ * adds them to the frame. Needs the clients visibility group,
+ * only reads it and the candidates, so it can run for several
+ * clients at once.
+ */
+void
+SV_CollectClientEntities(client_t *client, clientvis_t *vis)
+{
+	viscandidates_t *c = sv_candidates;
+	visgroup_t *g;
+	unsigned int bits;
+	vec3_t delta;
+	int w, i, self;
+
+	vis->num_entities = 0;
+
+	if (vis->group == -1)
+	{
+		return; /* not in game yet */
+	}
+
+	g = &sv_visgroups[vis->group];
+
+	/* the client always sees itself */
+	self = c->index[NUM_FOR_EDICT(client->edict)];
 
-				if (!ent->s.modelindex)
+	for (w = 0; w < (c->num + 31) >> 5; w++)
+	{
+		bits = g->visible[w];
+
+		if ((self >> 5) == w)
+		{
+			bits |= 1u << (self & 31);
+		}
+
+		for (i = w << 5; bits; i++, bits >>= 1)
+		{
+			if (!(bits & 1))
+			{
+				continue;
+			}
+
+			if ((c->flags[i] & VIS_SOUND) && (i != self))
+			{
+				/* don't send sounds if they
+				   will be attenuated away */
+				VectorSubtract(vis->org, c->origin[i], delta);
+
+				if (VectorLength(delta) > 400)
 				{
-					/* don't send sounds if they
-					   will be attenuated away */
-					vec3_t delta;
-					float len;
-
-					VectorSubtract(org, ent->s.origin, delta);
-					len = VectorLength(delta);
-
-					if (len > 400)
-					{
-						continue;
-					}
+					continue;
 				}
 			}
+
+			vis->entities[vis->num_entities++] = c->number[i];
+		}
+	}
+}
+
+/*
+ * Copies the entities found by SV_CollectClientEntities()
+ * to the circular client_entities array. Must be called
+ * for one client after the other.
+ */
+void
+SV_StoreClientEntities(client_t *client, clientvis_t *vis)
+{
+	client_frame_t *frame;
+	entity_state_t *state;
+	edict_t *ent;
+	int i, e;
+
+	if (!client->edict->client)
+	{
+		return; /* not in game yet */
+	}
+
+	frame = &client->frames[sv.framenum & UPDATE_MASK];
+
+	frame->num_entities = 0;
+	frame->first_entity = svs.next_client_entities;
+
+	for (i = 0; i < vis->num_entities; i++)
+	{
+		e = vis->entities[i];
+		ent = EDICT_NUM(e);
+
+		/* MSG_WriteDeltaEntity() would fail on
+		   these later, on the job threads */
+		if ((e <= 0) || (e >= MAX_EDICTS))
+		{
+			Com_Error(ERR_FATAL, "SV_StoreClientEntities: bad entity number %i", e);
 		}
 
 		/* add it to the circular client_entities array */
@@ -671,6 +1123,23 @@ SV_BuildClientFrame(client_t *client)
 	}
 }
 
+/*
+ * Returns MAX_JOB_THREADS scratch spaces
+ * for SV_BuildVisGroup(), one for each
+ * thread. Call it before starting the
+ * threads.
+ */
+visscratch_t *
+SV_VisScratch(void)
+{
+	if (!sv_visscratch)
+	{
+		sv_visscratch = Z_Malloc(sizeof(visscratch_t) * MAX_JOB_THREADS);
+	}
+
+	return sv_visscratch;
+}
+
 /*
  * Save everything in the world out without deltas.
  * Used for recording footage for merged or assembled demos
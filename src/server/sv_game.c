@@ -442,6 +442,11 @@ SV_InitGameProgs(void)
 	import.SetAreaPortalState = CM_SetAreaPortalState;
 	import.AreasConnected = CM_AreasConnected;
 
+	import.RunJobs = Jobs_Run;
+	import.trace_world = SV_TraceWorld;
+	import.trace_entities = SV_TraceEntities;
+	import.RadiusEdicts = SV_RadiusEdicts;
+
 	ge = (game_export_t *)Sys_GetGameAPI(&import);
 
 	if (!ge)
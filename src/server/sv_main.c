@@ -51,6 +51,34 @@ cvar_t *hostname;
 cvar_t *public_server; /* should heartbeats be sent */
 cvar_t *sv_entfile; /* External entity files. */
 cvar_t *sv_downloadserver; /* Download server. */
+cvar_t *sv_areagrid; /* loose grid instead of areanodes */
+cvar_t *sv_eventloop; /* dedicated server sleeps until the next frame */
+cvar_t *sv_parallelframes; /* build client frames on the job threads */
+cvar_t *sv_deltamemo; /* reuse entity deltas between clients */
+
+/* frame start jitter, printed by sv_jitter */
+#define JITTER_BUCKETS 6
+
+static const int jitter_limits[JITTER_BUCKETS - 1] = {50, 100, 250, 500, 1000};
+
+typedef struct
+{
+	long long deadline; /* when the next frame should start, 0 if unknown */
+	long long laststart;
+
+	int frames;
+	long long latesum;
+	long long latemax;
+	long long intervalsum;
+	long long intervalsumsq;
+	long long intervalmin;
+	long long intervalmax;
+	int intervals;
+	int buckets[JITTER_BUCKETS];
+} svjitter_t;
+
+static svjitter_t sv_jitter;
+static int sv_usecresidual;
 
 void Master_Shutdown(void);
 void SV_ConnectionlessPacket(void);
@@ -373,6 +401,104 @@ SV_RunGameFrame(void)
 #endif
 }
 
+static void
+SV_RecordFrameStart(void)
+{
+	long long now, late, interval;
+	int i;
+
+	now = Sys_Microseconds();
+
+	if (sv_jitter.deadline)
+	{
+		late = max(now - sv_jitter.deadline, 0);
+
+		for (i = 0; i < JITTER_BUCKETS - 1; i++)
+		{
+			if (late < jitter_limits[i])
+			{
+				break;
+			}
+		}
+
+		sv_jitter.buckets[i]++;
+		sv_jitter.latesum += late;
+		sv_jitter.latemax = max(sv_jitter.latemax, late);
+		sv_jitter.frames++;
+	}
+
+	if (sv_jitter.laststart)
+	{
+		interval = now - sv_jitter.laststart;
+
+		if (!sv_jitter.intervals)
+		{
+			sv_jitter.intervalmin = sv_jitter.intervalmax = interval;
+		}
+
+		sv_jitter.intervalmin = min(sv_jitter.intervalmin, interval);
+		sv_jitter.intervalmax = max(sv_jitter.intervalmax, interval);
+		sv_jitter.intervalsum += interval;
+		sv_jitter.intervalsumsq += interval * interval;
+		sv_jitter.intervals++;
+	}
+
+	sv_jitter.deadline = 0;
+	sv_jitter.laststart = now;
+}
+
+/*
+ * Prints how late the server frames started,
+ * "sv_jitter reset" clears the statistics.
+ */
+void
+SV_Jitter_f(void)
+{
+	static const char *names[JITTER_BUCKETS] = {
+		"< 50us", "< 100us", "< 250us", "< 500us", "< 1ms", ">= 1ms"
+	};
+	double mean, stddev;
+	int i;
+
+	if ((Cmd_Argc() > 1) && !Q_stricmp(Cmd_Argv(1), "reset"))
+	{
+		memset(&sv_jitter, 0, sizeof(sv_jitter));
+		Com_Printf("Jitter statistics cleared.\n");
+		return;
+	}
+
+	Com_Printf("Server frame start, event loop %s:\n",
+			sv_eventloop->value ? "on" : "off");
+
+	if (sv_jitter.frames)
+	{
+		Com_Printf("  %i frames after sleeping, late by %.1fus avg, %ius max\n",
+				sv_jitter.frames, (double)sv_jitter.latesum / sv_jitter.frames,
+				(int)sv_jitter.latemax);
+
+		for (i = 0; i < JITTER_BUCKETS; i++)
+		{
+			Com_Printf("  %-8s %6i (%5.1f%%)\n", names[i], sv_jitter.buckets[i],
+					100.0 * sv_jitter.buckets[i] / sv_jitter.frames);
+		}
+	}
+
+	if (sv_jitter.intervals)
+	{
+		mean = (double)sv_jitter.intervalsum / sv_jitter.intervals;
+		stddev = (double)sv_jitter.intervalsumsq / sv_jitter.intervals - mean * mean;
+		stddev = (stddev > 0) ? sqrt(stddev) : 0;
+
+		Com_Printf("  interval %.3fms avg, %.3fms min, %.3fms max, %.1fus stddev\n",
+				mean / 1000.0, sv_jitter.intervalmin / 1000.0,
+				sv_jitter.intervalmax / 1000.0, stddev);
+	}
+	else
+	{
+		Com_Printf("  no frames yet\n");
+	}
+}
+
 void
 SV_Frame(int usec)
 {
@@ -383,10 +509,21 @@ SV_Frame(int usec)
 	/* if server is not active, do nothing */
 	if (!svs.initialized)
 	{
+		if (sv_eventloop->value)
+		{
+			/* an idle dedicated server still
+			   needs to read the console */
+			NET_SleepUntil(Sys_Microseconds() + 10000);
+		}
+
 		return;
 	}
 
+	/* keep the fraction of a millisecond, with
+	   many short frames the clock falls behind */
+	usec += sv_usecresidual;
 	svs.realtime += usec / 1000;
+	sv_usecresidual = usec % 1000;
 
 	/* keep the random time dependent */
 	randk();
@@ -411,10 +548,23 @@ SV_Frame(int usec)
 			svs.realtime = sv.time - 100;
 		}
 
-		NET_Sleep(sv.time - svs.realtime);
+		if (sv_eventloop->value)
+		{
+			sv_jitter.deadline = Sys_Microseconds() +
+				(sv.time - svs.realtime) * 1000ll - sv_usecresidual;
+			NET_SleepUntil(sv_jitter.deadline);
+		}
+		else
+		{
+			sv_jitter.deadline = 0;
+			NET_Sleep(sv.time - svs.realtime);
+		}
+
 		return;
 	}
 
+	SV_RecordFrameStart();
+
 	/* update ping based on the last known frame from all clients */
 	SV_CalcPings();
 
@@ -615,6 +765,14 @@ SV_Init(void)
 
 	sv_entfile = Cvar_Get("sv_entfile", "1", CVAR_ARCHIVE);
 
+	sv_areagrid = Cvar_Get("sv_areagrid", "0", CVAR_LATCH);
+
+	sv_eventloop = Cvar_Get("sv_eventloop", "1", CVAR_ARCHIVE);
+
+	sv_parallelframes = Cvar_Get("sv_parallelframes", "1", CVAR_ARCHIVE);
+
+	sv_deltamemo = Cvar_Get("sv_deltamemo", "1", CVAR_ARCHIVE);
+
 	SZ_Init(&net_message, net_message_buffer, sizeof(net_message_buffer));
 }
 
@@ -681,6 +839,10 @@ SV_FinalMessage(char *message, qboolean reconnect)
 void
 SV_Shutdown(char *finalmsg, qboolean reconnect)
 {
+	/* Com_Error() may have left SV_SendClientMessages()
+	   with a send batch open, send it and end it */
+	NET_EndSendBatch();
+
 	if (svs.clients)
 	{
 		SV_FinalMessage(finalmsg, reconnect);
@@ -527,3 +527,100 @@ SV_Savegame_f(void)
 	Com_Printf("Done.\n");
 }
 
+
+/*
+ * Writes and reads the current level the given number
+ * of times and prints how long the game needs for it.
+ * Reading the level replaces the running game, so this
+ * refuses to run while clients are connected. Only the
+ * scratch directory save/bench is written to.
+ */
+void
+SV_SaveBench_f(void)
+{
+	char name[MAX_OSPATH];
+	char workdir[MAX_OSPATH];
+	long long start, writetime, readtime;
+	int i, rounds, size;
+	FILE *f;
+	client_t *cl;
+
+	if (sv.state != ss_game)
+	{
+		Com_Printf("You must be in a game to benchmark saving.\n");
+		return;
+	}
+
+	if (Cvar_VariableValue("deathmatch"))
+	{
+		Com_Printf("Can't savegame in a deathmatch\n");
+		return;
+	}
+
+	rounds = 10;
+
+	if (Cmd_Argc() > 1)
+	{
+		rounds = (int)strtol(Cmd_Argv(1), NULL, 10);
+	}
+
+	rounds = rounds < 1 ? 1 : (rounds > 1000 ? 1000 : rounds);
+
+	for (i = 0, cl = svs.clients; i < maxclients->value; i++, cl++)
+	{
+		if (cl->state != cs_free)
+		{
+			Com_Printf("Can't benchmark saving while clients are connected.\n");
+			return;
+		}
+	}
+
+	Com_sprintf(name, sizeof(name), "%s/save/bench", FS_Gamedir());
+	Sys_GetWorkDir(workdir, sizeof(workdir));
+	Sys_Mkdir(name);
+
+	if (!Sys_SetWorkDir(name))
+	{
+		Com_Printf("Couldn't change to %s\n", name);
+		Sys_SetWorkDir(workdir);
+		return;
+	}
+
+	Com_sprintf(name, sizeof(name), "%s.sav", sv.name);
+
+	start = Sys_Microseconds();
+
+	for (i = 0; i < rounds; i++)
+	{
+		ge->WriteLevel(name);
+	}
+
+	writetime = Sys_Microseconds() - start;
+
+	size = 0;
+
+	if ((f = Q_fopen(name, "rb")) != NULL)
+	{
+		fseek(f, 0, SEEK_END);
+		size = (int)ftell(f);
+		fclose(f);
+	}
+
+	start = Sys_Microseconds();
+
+	for (i = 0; i < rounds; i++)
+	{
+		/* like SV_SpawnServer(), ReadLevel() links all entities again */
+		SV_ClearWorld();
+		ge->ReadLevel(name);
+	}
+
+	readtime = Sys_Microseconds() - start;
+
+	Sys_Remove(name);
+	Sys_SetWorkDir(workdir);
+
+	Com_Printf("%i rounds, %i bytes: WriteLevel %.3f ms, ReadLevel %.3f ms\n",
+			rounds, size, writetime / (rounds * 1000.0),
+			readtime / (rounds * 1000.0));
+}
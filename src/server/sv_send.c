@@ -415,50 +415,180 @@ SV_StartSound(vec3_t origin, edict_t *entity, int channel, int soundindex,
 	}
 }
 
-qboolean
-SV_SendClientDatagram(client_t *client)
+/*
+ * Writes the frame stored by SV_StoreClientEntities()
+ * and the clients multicast datagram to msg. Only
+ * touches the client, so it can run for several
+ * clients at once. Returns true if the datagram
+ * overflowed, msg->overflowed is set if the
+ * message overflowed.
+ */
+static qboolean
+SV_WriteClientDatagram(client_t *client, sizebuf_t *msg)
 {
-	byte msg_buf[MAX_MSGLEN];
-	sizebuf_t msg;
-
-	SV_BuildClientFrame(client);
-
-	SZ_Init(&msg, msg_buf, sizeof(msg_buf));
-	msg.allowoverflow = true;
+	qboolean overflowed;
 
 	/* send over all the relevant entity_state_t
 	   and the player_state_t */
-	SV_WriteFrameToClient(client, &msg);
+	SV_WriteFrameToClient(client, msg);
 
 	/* copy the accumulated multicast datagram
 	   for this client out to the message
 	   it is necessary for this to be after the WriteEntities
 	   so that entity references will be current */
-	if (client->datagram.overflowed)
-	{
-		Com_Printf("WARNING: datagram overflowed for %s\n", client->name);
-	}
-	else
+	overflowed = client->datagram.overflowed;
+
+	if (!overflowed)
 	{
-		SZ_Write(&msg, client->datagram.data, client->datagram.cursize);
+		SZ_Write(msg, client->datagram.data, client->datagram.cursize);
 	}
 
 	SZ_Clear(&client->datagram);
 
-	if (msg.overflowed)
+	return overflowed;
+}
+
+static void
+SV_TransmitClientDatagram(client_t *client, sizebuf_t *msg,
+		qboolean datagramoverflowed)
+{
+	if (datagramoverflowed)
+	{
+		Com_Printf("WARNING: datagram overflowed for %s\n", client->name);
+	}
+
+	if (msg->overflowed)
 	{
 		/* must have room left for the packet header */
 		Com_Printf("WARNING: msg overflowed for %s\n", client->name);
-		SZ_Clear(&msg);
+		SZ_Clear(msg);
 	}
 
 	/* send the datagram */
-	Netchan_Transmit(&client->netchan, msg.cursize, msg.data);
+	Netchan_Transmit(&client->netchan, msg->cursize, msg->data);
 
 	/* record the size for rate estimation */
-	client->message_size[sv.framenum % RATE_MESSAGES] = msg.cursize;
+	client->message_size[sv.framenum % RATE_MESSAGES] = msg->cursize;
+}
+
+/*
+ * Per client state of SV_SendClientMessages(). Building
+ * the frames, mostly finding the visible entities, is
+ * done for all clients at once on the job threads. The
+ * entities are stored and the packets are send one
+ * client after the other, in the same order as before.
+ */
+typedef enum
+{
+	SEND_NOTHING,
+	SEND_MESSAGE, /* cinematic, demo or picture */
+	SEND_DATAGRAM, /* a new frame */
+	SEND_RELIABLE /* just the reliable message */
+} sendtype_t;
+
+typedef struct
+{
+	sendtype_t type;
+	client_t *client;
+	clientvis_t vis;
+	sizebuf_t msg;
+	byte msgbuf[MAX_MSGLEN];
+	qboolean datagramoverflowed;
+} clientsend_t;
+
+static clientsend_t *sv_sends;
+static int sv_numsends;
+
+/* indices into sv_sends of clients getting a frame */
+static int sv_framesends[MAX_CLIENTS];
+static visscratch_t *sv_sendscratch;
+
+static void
+SV_VisGroupJob(void *data, int index, int thread)
+{
+	SV_BuildVisGroup(index, &sv_sendscratch[thread]);
+}
+
+static void
+SV_CollectClientJob(void *data, int index, int thread)
+{
+	clientsend_t *send = &sv_sends[sv_framesends[index]];
+
+	SV_CollectClientEntities(send->client, &send->vis);
+}
+
+static void
+SV_WriteClientJob(void *data, int index, int thread)
+{
+	clientsend_t *send = &sv_sends[sv_framesends[index]];
+
+	/* runs on the job threads, so nothing may print or
+	   call Com_Error(). An overflow only sets the flag,
+	   it's reported by SV_TransmitClientDatagram(). The
+	   entity numbers MSG_WriteDeltaEntity() checks were
+	   checked by SV_StoreClientEntities() already. */
+	SZ_Init(&send->msg, send->msgbuf, sizeof(send->msgbuf));
+	send->msg.allowoverflow = true;
+	send->msg.quietoverflow = true;
+
+	send->datagramoverflowed = SV_WriteClientDatagram(send->client,
+			&send->msg);
+}
+
+static void
+SV_RunClientJobs(jobfunc_t func, int count)
+{
+	int i;
+
+	if (sv_parallelframes->value)
+	{
+		Jobs_Run(func, NULL, count);
+	}
+	else
+	{
+		for (i = 0; i < count; i++)
+		{
+			func(NULL, i, 0);
+		}
+	}
+}
+
+static void
+SV_BuildClientDatagrams(int count)
+{
+	int i, numgroups;
+
+	if (!count)
+	{
+		return;
+	}
+
+	sv_sendscratch = SV_VisScratch();
+
+	/* clients in the same place share the
+	   visibility tests against the world */
+	SV_PrepareClientFrames();
+
+	numgroups = 0;
+
+	for (i = 0; i < count; i++)
+	{
+		numgroups = SV_FindVisGroup(sv_sends[sv_framesends[i]].client,
+				&sv_sends[sv_framesends[i]].vis);
+	}
+
+	SV_RunClientJobs(SV_VisGroupJob, numgroups);
+	SV_RunClientJobs(SV_CollectClientJob, count);
+
+	/* the circular client_entities array
+	   is filled in client order */
+	for (i = 0; i < count; i++)
+	{
+		SV_StoreClientEntities(sv_sends[sv_framesends[i]].client,
+				&sv_sends[sv_framesends[i]].vis);
+	}
 
-	return true;
+	SV_RunClientJobs(SV_WriteClientJob, count);
 }
 
 void
@@ -511,6 +641,8 @@ SV_SendClientMessages(void)
 {
 	int i;
 	client_t *c;
+	clientsend_t *send;
+	int numframes;
 	int msglen;
 	byte msgbuf[MAX_MSGLEN];
 	size_t r;
@@ -559,9 +691,26 @@ SV_SendClientMessages(void)
 		}
 	}
 
-	/* send a message to each connected client */
+	if (sv_numsends < maxclients->value)
+	{
+		if (sv_sends)
+		{
+			Z_Free(sv_sends);
+		}
+
+		sv_numsends = (int)maxclients->value;
+		sv_sends = Z_Malloc(sizeof(clientsend_t) * sv_numsends);
+	}
+
+	/* decide what to send to each connected client */
+	numframes = 0;
+
 	for (i = 0, c = svs.clients; i < maxclients->value; i++, c++)
 	{
+		send = &sv_sends[i];
+		send->type = SEND_NOTHING;
+		send->client = c;
+
 		if (!c->state)
 		{
 			continue;
@@ -582,7 +731,7 @@ SV_SendClientMessages(void)
 			(sv.state == ss_demo) ||
 			(sv.state == ss_pic))
 		{
-			Netchan_Transmit(&c->netchan, msglen, msgbuf);
+			send->type = SEND_MESSAGE;
 		}
 		else if (c->state == cs_spawned)
 		{
@@ -592,7 +741,8 @@ SV_SendClientMessages(void)
 				continue;
 			}
 
-			SV_SendClientDatagram(c);
+			send->type = SEND_DATAGRAM;
+			sv_framesends[numframes++] = i;
 		}
 		else
 		{
@@ -600,9 +750,40 @@ SV_SendClientMessages(void)
 			if (c->netchan.message.cursize ||
 				(curtime - c->netchan.last_sent > 1000))
 			{
-				Netchan_Transmit(&c->netchan, 0, NULL);
+				send->type = SEND_RELIABLE;
 			}
 		}
 	}
+
+	SV_BuildClientDatagrams(numframes);
+
+	/* the packets are send together after the loop */
+	NET_BeginSendBatch();
+
+	for (i = 0; i < maxclients->value; i++)
+	{
+		send = &sv_sends[i];
+
+		switch (send->type)
+		{
+			case SEND_MESSAGE:
+				Netchan_Transmit(&send->client->netchan, msglen, msgbuf);
+				break;
+
+			case SEND_DATAGRAM:
+				SV_TransmitClientDatagram(send->client, &send->msg,
+						send->datagramoverflowed);
+				break;
+
+			case SEND_RELIABLE:
+				Netchan_Transmit(&send->client->netchan, 0, NULL);
+				break;
+
+			default:
+				break;
+		}
+	}
+
+	NET_EndSendBatch();
 }
 
@@ -30,6 +30,10 @@
 #define AREA_NODES 32
 #define MAX_TOTAL_ENT_LEAFS 128
 
+/* loose grid, used instead of the areanodes if sv_areagrid is set */
+#define AREA_GRID_CELLS 64 /* per axis, at most */
+#define AREA_GRID_MINCELL 128
+
 #define STRUCT_FROM_LINK(l, t, m) ((t *)((byte *)l - (byte *)&(((t *)NULL)->m)))
 #define EDICT_FROM_AREA(l) STRUCT_FROM_LINK(l, edict_t, area)
 
@@ -50,6 +54,43 @@ edict_t **area_list;
 int area_count, area_maxcount;
 int area_type;
 
+/*
+ * A cell of the loose grid. The bounding boxes are stored as
+ * structure of arrays: maxents absmin x, then maxents absmin y
+ * and so on, so the overlap test runs over contiguous memory.
+ */
+typedef struct
+{
+	int numents;
+	int maxents;
+	edict_t **ents;
+	float *bounds;
+} areacell_t;
+
+/*
+ * Entities are sorted into the cell containing the center of
+ * their box. An entity extents at most half a cell into the
+ * neighbouring cells, larger ones go into an extra cell that's
+ * always checked. The solid cells are followed by the trigger
+ * cells.
+ */
+typedef struct
+{
+	qboolean active;
+	vec3_t mins;
+	float cellsize;
+	int width, height;
+	int numcells; /* per type, including the oversized cell */
+	areacell_t *cells;
+
+	/* cell and index in that cell of every linked edict */
+	int maxedicts;
+	int *entcell;
+	int *entindex;
+} areagrid_t;
+
+static areagrid_t sv_grid;
+
 int SV_HullForEntity(edict_t *ent);
 
 /* ClearLink is used for new headnodes */
@@ -123,12 +164,232 @@ SV_CreateAreaNode(int depth, vec3_t mins, vec3_t maxs)
 	return anode;
 }
 
-void
-SV_ClearWorld(void)
+static void
+SV_GridFree(void)
+{
+	int i;
+
+	if (sv_grid.cells)
+	{
+		for (i = 0; i < sv_grid.numcells * 2; i++)
+		{
+			free(sv_grid.cells[i].ents);
+			free(sv_grid.cells[i].bounds);
+		}
+
+		free(sv_grid.cells);
+	}
+
+	free(sv_grid.entcell);
+	free(sv_grid.entindex);
+
+	memset(&sv_grid, 0, sizeof(sv_grid));
+}
+
+static void
+SV_GridCreate(vec3_t mins, vec3_t maxs)
+{
+	vec3_t size;
+	int i;
+
+	SV_GridFree();
+
+	VectorSubtract(maxs, mins, size);
+	VectorCopy(mins, sv_grid.mins);
+
+	sv_grid.cellsize = (size[0] > size[1] ? size[0] : size[1]) / AREA_GRID_CELLS;
+
+	if (sv_grid.cellsize < AREA_GRID_MINCELL)
+	{
+		sv_grid.cellsize = AREA_GRID_MINCELL;
+	}
+
+	sv_grid.width = (int)(size[0] / sv_grid.cellsize) + 1;
+	sv_grid.height = (int)(size[1] / sv_grid.cellsize) + 1;
+	sv_grid.numcells = sv_grid.width * sv_grid.height + 1;
+
+	sv_grid.cells = calloc(sv_grid.numcells * 2, sizeof(areacell_t));
+	YQ2_COM_CHECK_OOM(sv_grid.cells, "calloc()",
+			sv_grid.numcells * 2 * sizeof(areacell_t))
+
+	sv_grid.maxedicts = ge->max_edicts;
+	sv_grid.entcell = malloc(sv_grid.maxedicts * sizeof(int));
+	YQ2_COM_CHECK_OOM(sv_grid.entcell, "malloc()", sv_grid.maxedicts * sizeof(int))
+	sv_grid.entindex = malloc(sv_grid.maxedicts * sizeof(int));
+	YQ2_COM_CHECK_OOM(sv_grid.entindex, "malloc()", sv_grid.maxedicts * sizeof(int))
+
+	for (i = 0; i < sv_grid.maxedicts; i++)
+	{
+		sv_grid.entcell[i] = -1;
+	}
+
+	sv_grid.active = true;
+}
+
+static int
+SV_GridCoord(float v, float min, int size)
+{
+	int c;
+
+	c = (int)floorf((v - min) / sv_grid.cellsize);
+
+	if (c < 0)
+	{
+		return 0;
+	}
+
+	if (c >= size)
+	{
+		return size - 1;
+	}
+
+	return c;
+}
+
+static void
+SV_GridLink(edict_t *ent)
+{
+	areacell_t *cell;
+	float cx, cy;
+	int c, i, num, maxents;
+	edict_t **ents;
+	float *bounds;
+
+	num = NUM_FOR_EDICT(ent);
+
+	if ((num < 0) || (num >= sv_grid.maxedicts))
+	{
+		return;
+	}
+
+	if (((ent->absmax[0] - ent->absmin[0]) > sv_grid.cellsize) ||
+		((ent->absmax[1] - ent->absmin[1]) > sv_grid.cellsize))
+	{
+		c = sv_grid.numcells - 1;
+	}
+	else
+	{
+		cx = 0.5f * (ent->absmin[0] + ent->absmax[0]);
+		cy = 0.5f * (ent->absmin[1] + ent->absmax[1]);
+
+		c = SV_GridCoord(cy, sv_grid.mins[1], sv_grid.height) * sv_grid.width +
+			SV_GridCoord(cx, sv_grid.mins[0], sv_grid.width);
+	}
+
+	if (ent->solid == SOLID_TRIGGER)
+	{
+		c += sv_grid.numcells;
+	}
+
+	cell = &sv_grid.cells[c];
+
+	if (cell->numents == cell->maxents)
+	{
+		maxents = cell->maxents ? cell->maxents * 2 : 16;
+
+		ents = realloc(cell->ents, maxents * sizeof(edict_t *));
+		YQ2_COM_CHECK_OOM(ents, "realloc()", maxents * sizeof(edict_t *))
+		bounds = malloc(maxents * 6 * sizeof(float));
+		YQ2_COM_CHECK_OOM(bounds, "malloc()", maxents * 6 * sizeof(float))
+
+		for (i = 0; i < 6; i++)
+		{
+			memcpy(bounds + i * maxents, cell->bounds + i * cell->maxents,
+					cell->numents * sizeof(float));
+		}
+
+		free(cell->bounds);
+
+		cell->ents = ents;
+		cell->bounds = bounds;
+		cell->maxents = maxents;
+	}
+
+	i = cell->numents++;
+	cell->ents[i] = ent;
+
+	bounds = cell->bounds;
+	maxents = cell->maxents;
+	bounds[i] = ent->absmin[0];
+	bounds[i + maxents] = ent->absmin[1];
+	bounds[i + maxents * 2] = ent->absmin[2];
+	bounds[i + maxents * 3] = ent->absmax[0];
+	bounds[i + maxents * 4] = ent->absmax[1];
+	bounds[i + maxents * 5] = ent->absmax[2];
+
+	sv_grid.entcell[num] = c;
+	sv_grid.entindex[num] = i;
+
+	/* only marks the edict as linked */
+	ent->area.prev = ent->area.next = &ent->area;
+}
+
+static void
+SV_GridUnlink(edict_t *ent)
+{
+	areacell_t *cell;
+	int c, i, j, last, num;
+
+	num = NUM_FOR_EDICT(ent);
+
+	if ((num < 0) || (num >= sv_grid.maxedicts))
+	{
+		return;
+	}
+
+	c = sv_grid.entcell[num];
+	i = sv_grid.entindex[num];
+
+	/* stale link from before the last SV_ClearWorld() */
+	if ((c < 0) || (i >= sv_grid.cells[c].numents) ||
+		(sv_grid.cells[c].ents[i] != ent))
+	{
+		return;
+	}
+
+	cell = &sv_grid.cells[c];
+	last = --cell->numents;
+
+	/* move the last entry into the hole */
+	if (i != last)
+	{
+		cell->ents[i] = cell->ents[last];
+
+		for (j = 0; j < 6; j++)
+		{
+			cell->bounds[i + cell->maxents * j] =
+				cell->bounds[last + cell->maxents * j];
+		}
+
+		sv_grid.entindex[NUM_FOR_EDICT(cell->ents[i])] = i;
+	}
+
+	sv_grid.entcell[num] = -1;
+}
+
+/*
+ * (Re)creates the spatial index. grid selects the loose grid,
+ * otherwise the areanode tree is used.
+ */
+static void
+SV_CreateAreaIndex(qboolean grid)
 {
 	memset(sv_areanodes, 0, sizeof(sv_areanodes));
 	sv_numareanodes = 0;
 	SV_CreateAreaNode(0, sv.models[1]->mins, sv.models[1]->maxs);
+
+	SV_GridFree();
+
+	if (grid)
+	{
+		SV_GridCreate(sv.models[1]->mins, sv.models[1]->maxs);
+	}
+}
+
+void
+SV_ClearWorld(void)
+{
+	SV_CreateAreaIndex(sv_areagrid->value != 0);
 }
 
 void
@@ -139,14 +400,71 @@ SV_UnlinkEdict(edict_t *ent)
 		return; /* not linked in anywhere */
 	}
 
-	RemoveLink(&ent->area);
+	if (sv_grid.active)
+	{
+		SV_GridUnlink(ent);
+	}
+	else
+	{
+		RemoveLink(&ent->area);
+	}
+
 	ent->area.prev = ent->area.next = NULL;
 }
 
+/*
+ * Inserts the edict into the spatial index,
+ * its absmin and absmax must be valid.
+ */
+static void
+SV_AreaLink(edict_t *ent)
+{
+	areanode_t *node;
+
+	if (sv_grid.active)
+	{
+		SV_GridLink(ent);
+		return;
+	}
+
+	/* find the first node that the ent's box crosses */
+	node = sv_areanodes;
+
+	while (1)
+	{
+		if (node->axis == -1)
+		{
+			break;
+		}
+
+		if (ent->absmin[node->axis] > node->dist)
+		{
+			node = node->children[0];
+		}
+		else if (ent->absmax[node->axis] < node->dist)
+		{
+			node = node->children[1];
+		}
+		else
+		{
+			break; /* crosses the node */
+		}
+	}
+
+	/* link it in */
+	if (ent->solid == SOLID_TRIGGER)
+	{
+		InsertLinkBefore(&ent->area, &node->trigger_edicts);
+	}
+	else
+	{
+		InsertLinkBefore(&ent->area, &node->solid_edicts);
+	}
+}
+
 void
 SV_LinkEdict(edict_t *ent)
 {
-	areanode_t *node;
 	int leafs[MAX_TOTAL_ENT_LEAFS];
 	int clusters[MAX_TOTAL_ENT_LEAFS];
 	int num_leafs;
@@ -365,39 +683,7 @@ SV_LinkEdict(edict_t *ent)
 		return;
 	}
 
-	/* find the first node that the ent's box crosses */
-	node = sv_areanodes;
-
-	while (1)
-	{
-		if (node->axis == -1)
-		{
-			break;
-		}
-
-		if (ent->absmin[node->axis] > node->dist)
-		{
-			node = node->children[0];
-		}
-		else if (ent->absmax[node->axis] < node->dist)
-		{
-			node = node->children[1];
-		}
-		else
-		{
-			break; /* crosses the node */
-		}
-	}
-
-	/* link it in */
-	if (ent->solid == SOLID_TRIGGER)
-	{
-		InsertLinkBefore(&ent->area, &node->trigger_edicts);
-	}
-	else
-	{
-		InsertLinkBefore(&ent->area, &node->solid_edicts);
-	}
+	SV_AreaLink(ent);
 }
 
 void
@@ -463,10 +749,97 @@ SV_AreaEdicts_r(areanode_t *node)
 	}
 }
 
+static int
+SV_GridCellEdicts(areacell_t *cell, vec3_t mins, vec3_t maxs,
+		edict_t **list, int count, int maxcount)
+{
+	const float *minx, *miny, *minz, *maxx, *maxy, *maxz;
+	edict_t *check;
+	int i;
+
+	minx = cell->bounds;
+	miny = minx + cell->maxents;
+	minz = miny + cell->maxents;
+	maxx = minz + cell->maxents;
+	maxy = maxx + cell->maxents;
+	maxz = maxy + cell->maxents;
+
+	for (i = 0; i < cell->numents; i++)
+	{
+		/* no short circuit, lets the compiler vectorize this */
+		if ((minx[i] > maxs[0]) | (miny[i] > maxs[1]) |
+			(minz[i] > maxs[2]) | (maxx[i] < mins[0]) |
+			(maxy[i] < mins[1]) | (maxz[i] < mins[2]))
+		{
+			continue; /* not touching */
+		}
+
+		check = cell->ents[i];
+
+		if (check->solid == SOLID_NOT)
+		{
+			continue; /* deactivated */
+		}
+
+		if (count == maxcount)
+		{
+			Com_Printf("SV_AreaEdicts: MAXCOUNT\n");
+			return -1;
+		}
+
+		list[count++] = check;
+	}
+
+	return count;
+}
+
+static int
+SV_GridAreaEdicts(vec3_t mins, vec3_t maxs, edict_t **list,
+		int maxcount, int areatype)
+{
+	areacell_t *cells;
+	float half;
+	int x, y, x0, x1, y0, y1;
+	int count;
+
+	cells = sv_grid.cells;
+
+	if (areatype != AREA_SOLID)
+	{
+		cells += sv_grid.numcells;
+	}
+
+	/* entities may stick out half a cell */
+	half = 0.5f * sv_grid.cellsize;
+	x0 = SV_GridCoord(mins[0] - half, sv_grid.mins[0], sv_grid.width);
+	x1 = SV_GridCoord(maxs[0] + half, sv_grid.mins[0], sv_grid.width);
+	y0 = SV_GridCoord(mins[1] - half, sv_grid.mins[1], sv_grid.height);
+	y1 = SV_GridCoord(maxs[1] + half, sv_grid.mins[1], sv_grid.height);
+
+	count = SV_GridCellEdicts(&cells[sv_grid.numcells - 1], mins, maxs,
+			list, 0, maxcount);
+
+	for (y = y0; (y <= y1) && (count >= 0); y++)
+	{
+		for (x = x0; (x <= x1) && (count >= 0); x++)
+		{
+			count = SV_GridCellEdicts(&cells[y * sv_grid.width + x],
+					mins, maxs, list, count, maxcount);
+		}
+	}
+
+	return count < 0 ? maxcount : count;
+}
+
 int
 SV_AreaEdicts(vec3_t mins, vec3_t maxs, edict_t **list,
 		int maxcount, int areatype)
 {
+	if (sv_grid.active)
+	{
+		return SV_GridAreaEdicts(mins, maxs, list, maxcount, areatype);
+	}
+
 	area_mins = mins;
 	area_maxs = maxs;
 	area_list = list;
@@ -485,6 +858,73 @@ SV_AreaEdicts(vec3_t mins, vec3_t maxs, edict_t **list,
 	return area_count;
 }
 
+static int
+SV_EdictCompare(const void *a, const void *b)
+{
+	const edict_t *e1 = *(const edict_t **)a;
+	const edict_t *e2 = *(const edict_t **)b;
+
+	return (e1 > e2) - (e1 < e2);
+}
+
+/*
+ * Fills list with the solid and trigger edicts whose bounding box
+ * center is within radius of org, sorted by edict number. This is
+ * the same test findradius() does, but only edicts in the spatial
+ * index near org are checked.
+ */
+int
+SV_RadiusEdicts(vec3_t org, float radius, edict_t **list, int maxcount)
+{
+	vec3_t mins, maxs, eorg;
+	edict_t *touch[MAX_EDICTS], *check;
+	int i, j, num, count;
+
+	for (i = 0; i < 3; i++)
+	{
+		mins[i] = org[i] - radius;
+		maxs[i] = org[i] + radius;
+	}
+
+	num = SV_AreaEdicts(mins, maxs, touch, MAX_EDICTS, AREA_SOLID);
+	num += SV_AreaEdicts(mins, maxs, touch + num, MAX_EDICTS - num,
+			AREA_TRIGGERS);
+
+	count = 0;
+
+	for (i = 0; i < num; i++)
+	{
+		check = touch[i];
+
+		if (!check->inuse)
+		{
+			continue;
+		}
+
+		for (j = 0; j < 3; j++)
+		{
+			eorg[j] = org[j] - (check->s.origin[j] +
+					(check->mins[j] + check->maxs[j]) * 0.5);
+		}
+
+		if (VectorLength(eorg) > radius)
+		{
+			continue;
+		}
+
+		if (count == maxcount)
+		{
+			break;
+		}
+
+		list[count++] = check;
+	}
+
+	qsort(list, count, sizeof(list[0]), SV_EdictCompare);
+
+	return count;
+}
+
 int
 SV_PointContents(vec3_t p)
 {
@@ -668,12 +1108,51 @@ SV_TraceBounds(vec3_t start, vec3_t mins, vec3_t maxs,
 }
 
 /*
- * Moves the given mins/maxs volume through the world from start to end.
- * Passedict and edicts owned by passedict are explicitly not checked.
+ * Trace contexts for SV_TraceWorld(), one per job thread.
+ */
+static cmtrace_t sv_tracecontexts[MAX_JOB_THREADS];
+
+/*
+ * Clips the move against the world only. Other than SV_Trace()
+ * this may be called concurrently from job threads, thread must
+ * be the thread index passed to the job function.
  */
 trace_t
-SV_Trace(vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end,
-		edict_t *passedict, int contentmask)
+SV_TraceWorld(vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end,
+		int contentmask, int thread)
+{
+	trace_t trace;
+
+	if (!mins)
+	{
+		mins = vec3_origin;
+	}
+
+	if (!maxs)
+	{
+		maxs = vec3_origin;
+	}
+
+	if ((thread < 0) || (thread >= MAX_JOB_THREADS))
+	{
+		thread = 0;
+	}
+
+	trace = CM_BoxTraceContext(&sv_tracecontexts[thread], start, end,
+			mins, maxs, 0, contentmask);
+	trace.ent = ge->edicts;
+
+	return trace;
+}
+
+/*
+ * Finishes a trace started with SV_TraceWorld() by clipping it
+ * against all solid entities. The result is the same SV_Trace()
+ * would have returned for the same arguments.
+ */
+trace_t
+SV_TraceEntities(trace_t *world, vec3_t start, vec3_t mins, vec3_t maxs,
+		vec3_t end, edict_t *passedict, int contentmask)
 {
 	moveclip_t clip;
 
@@ -689,9 +1168,7 @@ SV_Trace(vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end,
 
 	memset(&clip, 0, sizeof(moveclip_t));
 
-	/* clip to world */
-	clip.trace = CM_BoxTrace(start, end, mins, maxs, 0, contentmask);
-	clip.trace.ent = ge->edicts;
+	clip.trace = *world;
 
 	if (clip.trace.fraction == 0)
 	{
@@ -718,3 +1195,170 @@ SV_Trace(vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end,
 	return clip.trace;
 }
 
+/*
+ * Moves the given mins/maxs volume through the world from start to end.
+ * Passedict and edicts owned by passedict are explicitly not checked.
+ */
+trace_t
+SV_Trace(vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end,
+		edict_t *passedict, int contentmask)
+{
+	trace_t world;
+
+	if (!mins)
+	{
+		mins = vec3_origin;
+	}
+
+	if (!maxs)
+	{
+		maxs = vec3_origin;
+	}
+
+	/* clip to world */
+	world = CM_BoxTrace(start, end, mins, maxs, 0, contentmask);
+	world.ent = ge->edicts;
+
+	return SV_TraceEntities(&world, start, mins, maxs, end,
+			passedict, contentmask);
+}
+
+
+/*
+ * Rebuilds the spatial index and relinks the given edicts.
+ */
+static void
+SV_RelinkAreaEdicts(edict_t **ents, int num, qboolean grid)
+{
+	int i;
+
+	SV_CreateAreaIndex(grid);
+
+	for (i = 0; i < num; i++)
+	{
+		ents[i]->area.prev = ents[i]->area.next = NULL;
+		SV_AreaLink(ents[i]);
+	}
+}
+
+/*
+ * Collects the linked edicts in the order the spatial index
+ * holds them. Relinking them in this order restores the
+ * order of every areanode list and grid cell, so traces and
+ * touches see the edicts in the same order as before.
+ */
+static int
+SV_CollectAreaEdicts(edict_t **ents, int maxcount)
+{
+	link_t *l, *start;
+	areacell_t *cell;
+	int i, j, num;
+
+	num = 0;
+
+	if (sv_grid.active)
+	{
+		for (i = 0; i < sv_grid.numcells * 2; i++)
+		{
+			cell = &sv_grid.cells[i];
+
+			for (j = 0; (j < cell->numents) && (num < maxcount); j++)
+			{
+				ents[num++] = cell->ents[j];
+			}
+		}
+
+		return num;
+	}
+
+	for (i = 0; i < sv_numareanodes; i++)
+	{
+		for (j = 0; j < 2; j++)
+		{
+			start = j ? &sv_areanodes[i].trigger_edicts :
+				&sv_areanodes[i].solid_edicts;
+
+			for (l = start->next; (l != start) && (num < maxcount); l = l->next)
+			{
+				ents[num++] = EDICT_FROM_AREA(l);
+			}
+		}
+	}
+
+	return num;
+}
+
+/*
+ * Compares the areanode tree and the loose grid on the
+ * edicts of the running map. Every linked edict is used
+ * as a query box, slightly enlarged like a trace would.
+ */
+void
+SV_AreaBench_f(void)
+{
+	edict_t **linked, *touch[MAX_EDICTS];
+	vec3_t mins, maxs;
+	int i, j, mode, rounds, numlinked;
+	long long start, time;
+	qboolean grid;
+	int found;
+
+	if (sv.state != ss_game)
+	{
+		Com_Printf("No map loaded.\n");
+		return;
+	}
+
+	rounds = 100;
+
+	if (Cmd_Argc() > 1)
+	{
+		rounds = (int)strtol(Cmd_Argv(1), (char **)NULL, 10);
+
+		if (rounds < 1)
+		{
+			rounds = 1;
+		}
+	}
+
+	linked = malloc(ge->max_edicts * sizeof(edict_t *));
+	YQ2_COM_CHECK_OOM(linked, "malloc()", ge->max_edicts * sizeof(edict_t *))
+
+	/* in index order, so it's restored afterwards */
+	numlinked = SV_CollectAreaEdicts(linked, ge->max_edicts);
+
+	grid = sv_grid.active;
+
+	for (mode = 0; mode < 2; mode++)
+	{
+		SV_RelinkAreaEdicts(linked, numlinked, mode == 1);
+
+		found = 0;
+		start = Sys_Microseconds();
+
+		for (j = 0; j < rounds; j++)
+		{
+			for (i = 0; i < numlinked; i++)
+			{
+				VectorSet(mins, -32, -32, -32);
+				VectorSet(maxs, 32, 32, 32);
+				VectorAdd(linked[i]->absmin, mins, mins);
+				VectorAdd(linked[i]->absmax, maxs, maxs);
+
+				found += SV_AreaEdicts(mins, maxs, touch, MAX_EDICTS, AREA_SOLID);
+				found += SV_AreaEdicts(mins, maxs, touch, MAX_EDICTS, AREA_TRIGGERS);
+			}
+		}
+
+		time = Sys_Microseconds() - start;
+
+		Com_Printf("%-9s %i edicts, %i queries: %lld usec, %.1f nsec/query, %i found\n",
+				mode ? "grid:" : "areanode:", numlinked, rounds * numlinked * 2, time,
+				numlinked ? (float)time * 1000.0f / (rounds * numlinked * 2) : 0.0f,
+				found);
+	}
+
+	SV_RelinkAreaEdicts(linked, numlinked, grid);
+
+	free(linked);
+}